@@ -3,17 +3,88 @@ is talking about
 
 Things needed
 -Function the returns a string once you read inside the file'
--Takes in the file path of the path we are looking at and read the contentss\*/
+-Takes in the file path of the path we are looking at and read the contentss
+-Only as much text as the embedder can use is read: every extractor stops at the
+ budget (a prefix of a text file, the first pages of a pdf, capped OCR output), so
+ memory stays bounded however big the input is
+-Images go through a cheap triage first: a downscaled grayscale copy is checked for
+ rows of glyph-sized shapes, text-free photos/screenshots never reach tesseract and the
+ rest are OCR'd at a resolution matched to their text size\*/
 
 #pragma once
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
 #include <string>
+#include <vector>
+#include "TaskScheduler.hpp"
+
+//how much of one file is extracted; the embedder only looks at the first few hundred tokens
+struct ExtractionBudget{
+    size_t maxBytes = 64 * 1024;   //text kept per file, any format
+    int maxPages = 10;             //pdf pages handed to pdftotext
+
+    //"64k", "2m", "4096b" (bytes), "5p" / "5pages", "512t" / "512tokens"; false (and the
+    //budget left as it was) if unparsable, zero or too large.
+    //A token budget becomes a byte budget at kBytesPerToken.
+    bool parse(const std::string& spec);
+    static constexpr size_t kBytesPerToken = 8;   //generous for WordPiece on English text
+};
+
+//what the triage found in one (downscaled, grayscale) image
+struct TextLikelihood{
+    int candidates = 0;        //glyph-sized connected components
+    int aligned = 0;           //of those, ones in a row of 3+ on a shared baseline/top line
+    int runs = 0;              //chains of 8+ aligned glyphs (lines of text)
+    float glyphHeight = 0.0f;  //median height of the aligned ones, in analysed pixels
+
+    //mostly aligned glyphs (a textured photo has chance neighbours, not rows of them),
+    //or a few long runs next to clutter like photos and icons
+    bool likely() const { return (aligned >= 8 && aligned * 2 >= candidates) || runs >= 3; }
+};
+
+//image stage totals, for the end of run summary
+struct OcrStats{
+    uint64_t ocred = 0;          //images handed to tesseract
+    uint64_t skipped = 0;        //judged text-free, never OCR'd
+    double ocrSeconds = 0;
+    double triageSeconds = 0;
+    double savedSeconds = 0;     //skipped pixels at the measured OCR cost per pixel; 0 until an image was OCR'd
+};
 
 class ContextExtractor{
     public:
+        explicit ContextExtractor(const ExtractionBudget& budget = ExtractionBudget());
+
         std::string extractText(const std::string& filePath);
 
+        const ExtractionBudget& budget() const { return budget_; }
+
+        //false sends every image straight to tesseract at full size
+        bool ocrTriage = true;
+        //put in front of every extractor command (e.g. "taskpolicy -b " to run them in the background)
+        std::string commandPrefix;
+        //images triaged/OCR'd at the same time (tesseract already runs several threads per image)
+        void setOcrConcurrency(int jobs);
+        OcrStats ocrStats() const;
+
+        //scores a grayscale image (row-major, width x height) for printed text
+        static TextLikelihood measureText(const unsigned char* gray, int width, int height);
+
     private:
+        ExtractionBudget budget_;
+
+        std::unique_ptr<TaskScheduler> ocrSlots_;
+        mutable std::mutex statsMutex_;
+        OcrStats stats_;
+        double ocrPixels_ = 0;       //pixels tesseract was given
+        double ratedOcrSeconds_ = 0; //tesseract time on those pixels
+        double skippedPixels_ = 0;   //pixels it would have been given without the triage
+
         std::string extractTxtFile(const std::string& filePath);
         std::string extractPDFFile(const std::string& filePath);
         std::string extractImageFile(const std::string& filePath);
-};
\ No newline at end of file
+        //stdout of command, at most limit bytes of it (+1 to flag a cut); the child is closed early past that
+        std::string readCommand(const std::string& command, size_t limit);
+};
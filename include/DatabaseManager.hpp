@@ -3,14 +3,23 @@
 --Dealing with adding to the db
 --Dealing with removing 
 --Dealing with deleting the whole db 
---initializing the db(so we are using sqlite which exists on the local server so just getting the path)*/
+--initializing the db(so we are using sqlite which exists on the local server so just getting the path)
+--Safe to share between threads: one writer connection (writes are serialized, a batch
+  holds it until commit) and a pool of read-only connections; in WAL mode a read sees the
+  last committed snapshot and never waits for a batch being written*/
 
 #pragma once
 #include <string>
 #include <vector>
 #include <cstdlib>
+#include <cstdint>
 #include <sqlite3.h>
 #include <tuple>
+#include <functional>
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
 
 struct FileRow{
     long long id;
@@ -18,6 +27,44 @@ struct FileRow{
     std::string name;
     std::string extension;
     long long last_modified;
+    long long group = 0;   //near-duplicate group: the representative's id, or the file's own id
+    uint64_t simhash = 0;  //text signature, 0 when none was stored
+};
+
+//a representative whose signature shares an LSH bucket with the one looked up
+struct SignatureMatch{
+    long long id;
+    std::string path;
+    uint64_t simhash;
+};
+
+//structured filter evaluated by sqlite before any vector is read, so excluded
+//files never get their embedding blob loaded or scored
+struct SearchFilter{
+    std::vector<std::string> extensions; //".pdf", ".txt" ... (case-insensitive), empty = any
+    std::string underPath;               //only files below this directory, empty = anywhere
+    long long modifiedSince = 0;         //unix seconds inclusive, 0 = no lower bound
+    long long modifiedBefore = 0;        //unix seconds exclusive, 0 = no upper bound
+
+    bool empty() const {
+        return extensions.empty() && underPath.empty() && modifiedSince == 0 && modifiedBefore == 0;
+    }
+};
+
+//one file of an index run's plan
+struct JournalEntry{
+    std::string path;
+    std::string name;
+    std::string extension;
+    int attempts = 0;   //times it was started; > 0 on resume means a run died while it was in flight
+};
+
+//a file indexing skips until it changes on disk
+struct QuarantineEntry{
+    std::string path;
+    long long last_modified = 0;
+    int strikes = 0;
+    std::string reason;
 };
 
 class DatabaseManager{
@@ -26,6 +73,18 @@ class DatabaseManager{
         ~DatabaseManager();
 
 
+        //key/value pairs of the metadata table (model_name, model_variant, embedding_dim, ...)
+        std::string getMetadata(const std::string& key, const std::string& fallback = "");
+        bool setMetadata(const std::string& key, const std::string& value);
+
+        //records the embedding model variant (fp32/int8/fp16/static) this index uses, and with
+        //it the model's name and vector size when given. False when the index already holds
+        //vectors from a different variant: they are not comparable.
+        bool useModelVariant(const std::string& variant, const std::string& modelName = "", size_t dimension = 0);
+
+        //true when the file is stored with this (or a newer) last_modified, so it needs no re-extraction
+        bool isUpToDate(const std::string& path, long lastModified);
+
         //dealing with insertion, have to see what information about the file we are inserting
         bool insertFile(const std::string& path, const std::string& name, 
             const std::string& extension, const std::vector<float>& embedding, long lastModified);
@@ -36,11 +95,107 @@ class DatabaseManager{
         //getting all files from db
         std::vector<std::tuple<std::string, std::string, std::string, std::vector<float> >> getAllFiles();
 
+        //same rows as getAllFiles but only for files that pass the filter
+        std::vector<std::tuple<std::string, std::string, std::string, std::vector<float> >> getFilteredFiles(const SearchFilter& filter);
+
         std::vector<FileRow> listFiles(int limit=200);
 
+        //stored vector of one file; empty when it isn't indexed
+        std::vector<float> getEmbedding(const std::string& path);
+
+        //deletes the files' rows, vectors and buckets (a removed representative hands its
+        //group on as setSignature does); returns how many rows were removed
+        int removeFiles(const std::vector<std::string>& paths);
+
+        //near-duplicates (see NearDuplicate.hpp): group representatives sharing at least one
+        //LSH bucket with simhash. Candidates only, the caller checks the distance
+        std::vector<SignatureMatch> findSignatureMatches(uint64_t simhash);
+        //stores an indexed file's text signature and the representative whose embedding it
+        //reuses (0 = it represents its own group and is put in the buckets). A file whose
+        //signature changed stops representing the files that pointed at it: the oldest of
+        //them becomes their representative (bucketed from its stored signature)
+        bool setSignature(const std::string& path, uint64_t simhash, long long representative);
+
+        //file browser paging, ordered by path. `match` is a substring of name or path
+        //(empty = all). Pages are keyset based: pass the last path of the previous page.
+        long long countFiles(const std::string& match = "");
+        std::vector<FileRow> listFilesAfter(const std::string& afterPath, int limit, const std::string& match = "");
+        //path of the row at that position, to start paging from a scrollbar jump
+        std::string pathAtOffset(long long offset, const std::string& match = "");
+
+        //streams every file that has a vector, ordered by path, without building
+        //an intermediate copy (used to warm an in-memory VectorIndex)
+        void forEachEmbedding(const std::function<void(const FileRow&, const float*, size_t)>& visit);
+
+        //index journal: the plan of a run and what is done, committed together with the
+        //files it indexed so a crashed run can resume where it stopped.
+        //openIndexRun continues the unfinished run for root when resume is set (resumed=true),
+        //otherwise drops it and starts a new one; 0 on failure
+        long long openIndexRun(const std::string& root, bool resume, bool& resumed);
+        bool planIndexRun(long long run, const std::vector<JournalEntry>& files);
+        //files of the run not marked done yet, in plan order
+        std::vector<JournalEntry> pendingIndexFiles(long long run);
+        //bumps attempts and commits it before the files are worked on
+        bool markIndexAttempt(long long run, const std::vector<std::string>& paths);
+        bool markIndexDone(long long run, const std::string& path);
+        bool finishIndexRun(long long run);
+
+        //explicit transaction so a batch of inserts and its journal rows land atomically.
+        //The calling thread holds the writer until commitBatch/rollbackBatch: other threads'
+        //writes wait, their reads see the state before the batch
+        bool beginBatch();
+        bool commitBatch();
+        void rollbackBatch();
+
+        //quarantine: strikes accumulate per (path, last_modified); a changed file starts over
+        bool strikeFile(const std::string& path, long long lastModified, int strikes, const std::string& reason);
+        bool isQuarantined(const std::string& path, long long lastModified, int maxStrikes);
+        std::vector<QuarantineEntry> listQuarantine();
+        bool releaseQuarantine(const std::string& path);
+
 
     private:
-        sqlite3* db;
+        sqlite3* writer_;
+        std::string dbPath_;
+        bool hasFts_ = false; //files_fts trigram table is available
+        bool wal_ = false;    //read connections only make sense on a WAL database
+
+        //writes, and batches from begin to commit/rollback, hold writeMutex_
+        std::recursive_mutex writeMutex_;
+        std::atomic<std::thread::id> writerThread_{};
+        int writeDepth_ = 0;                 //only touched by the holding thread
+        int openBatches_ = 0;
+
+        //idle read-only connections; up to kMaxReaders are opened, then reads wait for one
+        static constexpr int kMaxReaders = 8;
+        std::mutex readersMutex_;
+        std::condition_variable readerFreed_;
+        std::vector<sqlite3*> idleReaders_;
+        int openReaders_ = 0;
+
+        //the connection one method uses for its statements: the writer (locked) for
+        //writes, a leased reader for reads
+        class Connection{
+            public:
+                enum Access { Read, Write };
+                Connection(DatabaseManager& owner, Access access);
+                ~Connection();
+                Connection(const Connection&) = delete;
+                Connection& operator=(const Connection&) = delete;
+                operator sqlite3*() const { return handle_; }
+
+            private:
+                DatabaseManager& owner_;
+                sqlite3* handle_ = nullptr;
+                bool reader_ = false;
+        };
+
+        void lockWriter();
+        void unlockWriter();
+        bool holdsWriter() const;
+        sqlite3* acquireReader();   //nullptr if a read connection can't be opened
+        void releaseReader(sqlite3* reader);
+
         //basically changing the information into something that can be stored in the db
         //so the vectors that I have being a string of vectors has to be serialized for the db
         void initializeDatabase();
@@ -51,4 +206,7 @@ class DatabaseManager{
 
         //checking last modified date
         bool fileNeedUpdate(const std::string& filePath, long currentModified);
+
+        std::string matchClause(const std::string& match) const;
+        int bindMatch(sqlite3_stmt* st, const std::string& match) const;
 };
\ No newline at end of file
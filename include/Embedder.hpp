@@ -0,0 +1,33 @@
+/*Anything that can turn text into a vector.
+EmbeddingEngine (ONNX MiniLM) is the real one; other backends (a fake for benchmarks,
+cheaper models) plug in here so search and indexing don't care which one runs*/
+
+#pragma once
+
+#include <cstddef>
+#include <string>
+#include <vector>
+
+class Embedder{
+    public:
+        virtual ~Embedder() = default;
+
+        //empty vector on failure
+        virtual std::vector<float> createEmbedding(const std::string& text) = 0;
+
+        //one vector per text, in order (empty where that text failed). Backends that
+        //can run several inputs in one pass override this; the default loops
+        virtual std::vector<std::vector<float>> createEmbeddings(const std::vector<std::string>& texts) {
+            std::vector<std::vector<float>> out;
+            out.reserve(texts.size());
+            for (const auto& t : texts) out.push_back(createEmbedding(t));
+            return out;
+        }
+
+        //loads whatever the backend needs up front; false if it can't be used
+        virtual bool warmUp() { return true; }
+
+        //createEmbeddings will be called with up to this many texts (EmbeddingBatcher's
+        //maxBatch); backends that keep per-batch buffers size them to it
+        virtual void reserveBatch(size_t maxBatch) { (void)maxBatch; }
+};
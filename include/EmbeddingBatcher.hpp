@@ -0,0 +1,80 @@
+/*Coalesces concurrent embedding requests into batches.
+-Callers submit text and get a future; a few runner threads take whatever is queued
+ (up to maxBatch) and embed it with one createEmbeddings call on the wrapped backend
+-The window a runner waits for more requests adapts to the arrival rate: when requests
+ arrive further apart than the window, a lone request goes straight through; under load
+ a runner waits at most maxWindow, and less when the batch is expected to fill sooner
+-Requests that arrive while a batch is running queue up and form the next one, so even
+ with a zero window a busy server batches
+Meant for query embedding in the daemon; indexing calls the backend directly*/
+
+#pragma once
+
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <future>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include "Embedder.hpp"
+
+struct BatcherConfig{
+    size_t maxBatch = 16;
+    std::chrono::microseconds maxWindow{2000};   //longest a request waits for company
+    int runners = 2;                             //batches in flight at once
+};
+
+struct BatcherStats{
+    uint64_t requests = 0;
+    uint64_t batches = 0;
+    size_t largestBatch = 0;
+    double meanBatch() const { return batches ? static_cast<double>(requests) / static_cast<double>(batches) : 0.0; }
+};
+
+class EmbeddingBatcher : public Embedder{
+    public:
+        EmbeddingBatcher(Embedder& backend, const BatcherConfig& config = BatcherConfig());
+        //finishes what is queued, then joins the runners
+        ~EmbeddingBatcher() override;
+
+        //the future holds an empty vector when the backend failed on this text
+        std::future<std::vector<float>> submit(std::string text);
+
+        //submit + wait, so the batcher can stand in wherever an Embedder is used
+        std::vector<float> createEmbedding(const std::string& text) override { return submit(text).get(); }
+        bool warmUp() override { return backend_.warmUp(); }
+
+        BatcherStats stats() const;
+
+    private:
+        using Clock = std::chrono::steady_clock;
+        struct Request{
+            std::string text;
+            std::promise<std::vector<float>> result;
+            Clock::time_point arrived;
+        };
+
+        Embedder& backend_;
+        const BatcherConfig config_;
+
+        mutable std::mutex mutex_;
+        std::condition_variable queued_;
+        std::deque<Request> queue_;
+        bool stopping_ = false;
+
+        //smoothed gap between arrivals, what the window is derived from; the last raw gap
+        //lets the first request after a quiet spell through before the average catches up
+        double gapMicros_ = 1e9;
+        double lastGapMicros_ = 1e9;
+        Clock::time_point lastArrival_;
+        BatcherStats stats_;
+
+        std::vector<std::thread> runners_;
+
+        void runLoop();
+        //how long the oldest queued request may wait for the batch to fill; caller holds mutex_
+        std::chrono::microseconds window() const;
+};
@@ -8,29 +8,109 @@ Now because these are vectors it has to have multiple numbers to choose from in
 #include <vector>
 #include <cstdlib>
 #include "TokenizerClient.hpp"
+#include "Embedder.hpp"
+#include "StaticEmbedding.hpp"
 #include <memory>
+#include <mutex>
 #include <onnxruntime/onnxruntime_cxx_api.h>
 
-class EmbeddingEngine{
+class EmbeddingEngine : public Embedder{
     public:
        EmbeddingEngine(const std::string& onnxModelPath,
                     const std::string& pythonExe,          // ./.venv/bin/python
                     const std::string& tokenizerScript,    // tools/tokenize.py
                     const std::string& tokenizerJson,      // models/tokenizer.json
-                    size_t maxSeqLen = 256);
+                    size_t maxSeqLen = 256,
+                    const std::string& variant = "fp32"); // fp32 | int8 | fp16 | static, see variantModelPath
 
-        std::vector<float> createEmbedding(const std::string& text);
+        ~EmbeddingEngine() override;
+
+        //the ONNX session and tokenizer are only built on the first call
+        std::vector<float> createEmbedding(const std::string& text) override;
+
+        //runs the model on already tokenized input and writes the pooled, normalized
+        //vector to out (dimension() floats). seq <= max length, shorter input is padded.
+        //Reuses a preallocated inference context, so steady state calls don't allocate.
+        //ONNX variants only: the static table has its own vocabulary (false there)
+        bool embedTokens(const int64_t* inputIds, const int64_t* attentionMask, size_t seq, float* out);
+
+        //several texts in one forward pass: tokenized in one helper run, cut to the longest
+        //text's length and run as a single [batch, len] input
+        std::vector<std::vector<float>> createEmbeddings(const std::vector<std::string>& texts) override;
+
+        //rows of the batch are maxLen tokens apart in inputIds/attentionMask; only the first
+        //seq of each are fed to the model. Writes batch * dimension() floats to out.
+        //Runs in buffers preallocated for reserveBatch() rows (16 by default), a larger
+        //batch in several passes
+        bool embedTokensBatch(const int64_t* inputIds, const int64_t* attentionMask,
+                              size_t batch, size_t maxLen, size_t seq, float* out);
+
+        //hidden size of the model, 0 until the session is built
+        size_t dimension() const { return hiddenDim_; }
+
+        //which export is loaded; vectors from different variants are not interchangeable
+        const std::string& variant() const { return variant_; }
+
+        //what an index embedded by this engine records as model_name / embedding_dim.
+        //The dimension doesn't need the model loaded (a static table's header is read);
+        //0 when the table can't be read
+        std::string modelName() const;
+        size_t modelDimension() const;
+
+        //models/model.onnx + "int8" -> models/model.int8.onnx (fp32 is the path itself),
+        //the names tools/quantize.py writes; "static" -> models/model.static.bin, the token
+        //table tools/export_static.py writes (no ONNX session, no python tokenizer)
+        static std::string variantModelPath(const std::string& fp32ModelPath, const std::string& variant);
+        static bool isKnownVariant(const std::string& variant);
+
+        //builds the session now instead of on first use; false if the model can't be loaded
+        bool warmUp() override;
+        void reserveBatch(size_t maxBatch) override;
 
     private:
         Ort::Env env;
         Ort::Session session{nullptr};
         Ort::SessionOptions sessionOptions;
 
+        std::string modelPath_;
+        std::string variant_;
+        std::string pythonExe_;
+        std::string tokenizerScript_;
+        std::string tokenizerJson_;
+
+        std::once_flag initOnce_;
+        bool ready_ = false;
+
+        void initialize();
+        //where the optimized graph for this model + ORT version is cached
+        std::string optimizedModelPath() const;
+
         std::vector<std::string> inputNamesOwned_;
         std::vector<std::string> outputNamesOwned_;
 
         std::unique_ptr<TokenizerClient> tok_;
+        //set instead of the session and tokenizer for the static variant
+        std::unique_ptr<StaticEmbedding> static_;
 
         size_t maxSeqLen_;
+        size_t hiddenDim_ = 0;
+
+        //input/output tensors bound once to the session; one per concurrently
+        //embedding thread, handed out from an idle list and returned after the run
+        struct InferenceContext;
+        std::mutex contextMutex_;
+        std::vector<std::unique_ptr<InferenceContext>> idleContexts_;
+
+        std::unique_ptr<InferenceContext> makeContext();
+        std::unique_ptr<InferenceContext> acquireContext();
+        void releaseContext(std::unique_ptr<InferenceContext> ctx);
+
+        //the same for batched runs: buffers for maxBatch_ rows, one per concurrent batch
+        struct BatchContext;
+        size_t maxBatch_ = 16;   //guarded by contextMutex_
+        std::vector<std::unique_ptr<BatchContext>> idleBatches_;
+
+        std::unique_ptr<BatchContext> acquireBatch();
+        void releaseBatch(std::unique_ptr<BatchContext> ctx);
 
 };
\ No newline at end of file
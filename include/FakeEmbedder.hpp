@@ -0,0 +1,18 @@
+/*Deterministic stand-in for the ONNX model.
+Hashes every word into a few signed buckets (feature hashing) and normalizes,
+so texts that share words land close together. Needs no model files, which lets
+benchmarks and load tests run anywhere and give the same vectors every run*/
+
+#pragma once
+
+#include "Embedder.hpp"
+
+class FakeEmbedder : public Embedder{
+    public:
+        explicit FakeEmbedder(size_t dimension = 384);
+
+        std::vector<float> createEmbedding(const std::string& text) override;
+
+    private:
+        size_t dim_;
+};
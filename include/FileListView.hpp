@@ -0,0 +1,38 @@
+/*Row source for the "Indexed Files" table.
+-Knows how many rows match the current filter and hands out row i on demand
+-Rows are fetched from sqlite a page at a time (keyset pagination) and cached, so the
+ table only ever touches the pages that are on screen
+-Only the pages near the last one requested are kept, memory stays flat at any index size*/
+
+#pragma once
+
+#include <map>
+#include <string>
+#include <vector>
+#include "DatabaseManager.hpp"
+
+class FileListView{
+    public:
+        explicit FileListView(DatabaseManager& manager, int pageSize = 256, size_t maxPages = 32);
+
+        //substring of name or path; re-counts and drops cached pages when it changes
+        void setFilter(const std::string& match);
+        //re-count and drop cached pages (after indexing)
+        void refresh();
+
+        long long size() const { return total_; }
+        //nullptr past the end (rows can disappear between refreshes)
+        const FileRow* row(long long i);
+
+    private:
+        DatabaseManager& manager;
+        const int pageSize;
+        const size_t maxPages;
+
+        std::string match_;
+        long long total_ = 0;
+        std::map<long long, std::vector<FileRow>> pages_;
+
+        const std::vector<FileRow>& page(long long p);
+        void evictAround(long long p);
+};
@@ -0,0 +1,118 @@
+/*Keeps background indexing from taking over the machine.
+-Text extraction (pdftotext, OCR) runs on up to maxWorkers threads; the governor decides
+ how many of them may be busy and adjusts that every sample instead of killing work:
+ fewer while the process is over its CPU share or memory ceiling, more again once it
+ is back under (one worker at a time, like a congestion window)
+-At one worker and still over the CPU share, a gap is left between files
+-File bytes handed to the extractors are metered against the I/O budget
+-While other processes keep the cores busy (load average minus our own use), new files
+ wait; work already started finishes, and admission resumes once the load drops
+-Worker threads lower their own nice and I/O priority, which the extractor processes
+ they start inherit (on macOS they are started under taskpolicy -b instead)*/
+
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <thread>
+
+struct GovernorLimits{
+    int maxWorkers = 0;         //extraction threads; 0 = half the cores
+    double cpuShare = 0.0;      //of all cores, 0.5 = half the machine; 0 = no limit
+    double ioMBps = 0.0;        //file bytes fed to the extractors per second; 0 = no limit
+    size_t maxRssMb = 0;        //resident memory of this process; 0 = no limit
+    double pauseLoad = 1.0;     //pause while other processes' load per core is above; 0 = never
+    bool lowPriority = true;    //nice/ioprio for the workers and their child extractors
+};
+
+struct GovernorStats{
+    int workers = 0;            //maxWorkers after defaults
+    int allowed = 0;            //currently allowed to be busy
+    bool paused = false;
+    double pausedSeconds = 0;   //admission held back by system load
+    double throttledSeconds = 0;//gaps left for the CPU share and waits for the I/O budget
+    double cpuShare = 0;        //last sample, of all cores
+    double otherLoad = 0;       //last sample, per core
+    size_t rssMb = 0;
+    int adjustments = 0;        //changes of allowed
+};
+
+class IndexGovernor{
+    public:
+        explicit IndexGovernor(const GovernorLimits& limits = GovernorLimits());
+        //stops the sampler
+        ~IndexGovernor();
+
+        //held while a worker extracts one file; an empty Ticket (stop was set) holds nothing
+        class Ticket{
+            public:
+                Ticket() = default;
+                Ticket(Ticket&& other) noexcept : owner_(other.owner_) { other.owner_ = nullptr; }
+                Ticket& operator=(Ticket&& other) noexcept;
+                Ticket(const Ticket&) = delete;
+                Ticket& operator=(const Ticket&) = delete;
+                ~Ticket() { release(); }
+
+                void release();
+                bool held() const { return owner_ != nullptr; }
+
+            private:
+                friend class IndexGovernor;
+                explicit Ticket(IndexGovernor* owner) : owner_(owner) {}
+                IndexGovernor* owner_ = nullptr;
+        };
+
+        //blocks until a worker may start on a file of `bytes` bytes: not paused, fewer than
+        //allowed() busy and room in the I/O budget. Returns an empty Ticket once stop is set
+        Ticket admit(uint64_t bytes, const std::atomic<bool>& stop);
+
+        //called once by each worker thread before its first file
+        void enterWorker() const;
+        //ContextExtractor::commandPrefix that runs the extractors at low priority where the
+        //worker threads can't pass theirs on
+        static std::string commandPrefix(const GovernorLimits& limits);
+
+        int maxWorkers() const { return maxWorkers_; }
+        int allowed() const;
+        GovernorStats stats() const;
+
+        //one control step: measure, then adjust allowed / pause. The sampler calls it every
+        //interval; public so a caller can force one
+        void sample();
+
+        static constexpr std::chrono::milliseconds kInterval{500};
+
+    private:
+        using Clock = std::chrono::steady_clock;
+
+        const GovernorLimits limits_;
+        const int maxWorkers_;
+        const unsigned cores_;
+
+        mutable std::mutex mutex_;
+        std::condition_variable changed_;
+        int busy_ = 0;
+        int allowed_;
+        bool paused_ = false;
+        std::chrono::microseconds gap_{0};   //between files at one worker, for the CPU share
+        Clock::time_point nextStart_;        //earliest the next file may start (gap)
+        double ioCredit_ = 0;                //bytes; negative is debt
+        Clock::time_point ioRefilled_;
+
+        //previous sample
+        Clock::time_point sampledAt_;
+        double cpuSeconds_ = 0;
+        double ownCores_ = 0;                //smoothed, so it is comparable to the load average
+        GovernorStats stats_;
+        Clock::time_point pausedSince_;
+
+        std::atomic<bool> stopping_{false};
+        std::thread sampler_;
+
+        void releaseTicket();
+        void setAllowed(int allowed);   //caller holds mutex_
+};
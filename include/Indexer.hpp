@@ -0,0 +1,101 @@
+/*Indexing pipeline shared by the CLI, the GUI and the search daemon
+-Scan the directory
+-Extract the text of every supported file
+-Embed it and store it in the database; a near-duplicate of a stored file (SimHash of
+ the text, see NearDuplicate.hpp) reuses that file's embedding instead
+Callers hook the callbacks for progress/logging instead of each keeping a copy of the loop
+With a journal database the run is crash safe: the file plan and per-file progress are
+stored, files are committed in batches, a later run can resume, and files that keep
+crashing or stalling the run are quarantined*/
+
+#pragma once
+
+#include <ctime>
+#include <functional>
+#include <string>
+#include <vector>
+#include "FileScanner.hpp"
+#include "ContextExtractor.hpp"
+#include "Embedder.hpp"
+#include "DatabaseManager.hpp"
+#include "IndexGovernor.hpp"
+#include "NearDuplicate.hpp"
+#include "TaskScheduler.hpp"
+
+enum class IndexOutcome{
+    Indexed,        //inserted or updated
+    Unchanged,      //already in the db with the same last_modified
+    NoText,         //extractor returned nothing
+    EmbeddingFailed,
+    Quarantined     //skipped: crashed or stalled earlier runs and hasn't changed since
+};
+
+class Indexer{
+    public:
+        //picks the database a file is stored in; nullptr skips the file
+        using Router = std::function<DatabaseManager*(const FileInfo& file)>;
+
+        Indexer(DatabaseManager& manager, ContextExtractor& extractor, Embedder& embedder);
+        Indexer(Router route, ContextExtractor& extractor, Embedder& embedder);
+
+        //returns the number of files inserted/updated
+        int indexDirectory(const std::string& directoryPath);
+
+        //called once the scan is done with the number of files found
+        std::function<void(int discovered)> onDiscovered;
+        //called after each supported file
+        std::function<void(const FileInfo& file, IndexOutcome outcome)> onFile;
+        //when set, embedding and inserts run in Background slots so queries go first;
+        //extraction (OCR included) never holds a slot
+        TaskScheduler* scheduler = nullptr;
+        //when set, text extraction runs on the governor's worker threads under its CPU, I/O,
+        //memory and load limits, ahead of the embedding; nullptr extracts one file at a time
+        //on the calling thread. Embedding, inserts and the journal stay on the calling thread
+        IndexGovernor* governor = nullptr;
+
+        //plan/progress journal and batch transactions; the single-database constructor
+        //points it at that database, nullptr indexes file by file without one
+        DatabaseManager* journal = nullptr;
+        bool resume = false;            //continue the directory's unfinished run instead of rescanning
+        int batchSize = 64;             //files committed per transaction
+        int maxStrikes = 2;             //crashes/slow extractions before a file is quarantined
+        double slowFileSeconds = 120.0; //an extraction slower than this is a strike
+        //texts within this many SimHash bits of a stored representative reuse its embedding
+        //and join its group; -1 embeds every file (signatures are still stored)
+        int duplicateDistance = NearDuplicate::kMaxDistance;
+
+        static bool isCorrectFileType(const std::string& extension);
+        static std::time_t getLastModified(const std::string& filePath);
+
+    private:
+        Router route;
+
+        //extracted text of one file and how long it took
+        struct Extraction{
+            std::string text;
+            double seconds = 0;
+        };
+        class ParallelExtraction;
+
+        //one file of a batch, from the plan to its insert
+        struct Pending{
+            FileInfo file;
+            DatabaseManager* manager = nullptr;
+            std::time_t lastModified = 0;
+            IndexOutcome outcome = IndexOutcome::Unchanged;
+            int extraction = -1;              //index into the batch's extraction list, -1 = not needed
+            std::vector<float> embedding;     //computed or reused, empty = nothing to store
+            uint64_t signature = 0;
+            long long representative = 0;     //stored file whose embedding is reused
+            int sameBatch = -1;               //earlier file of the batch whose embedding is reused
+        };
+
+        Extraction extract(const FileInfo& file);
+        //everything slow (signature, duplicate lookup, embedding) without writing; batch[0..at)
+        //are the files before it in the batch, a near-duplicate of one of them reuses its vector
+        void prepare(std::vector<Pending>& batch, size_t at, const Extraction& extracted);
+        //the insert and signature of a prepared file, inside the batch transaction
+        IndexOutcome store(std::vector<Pending>& batch, size_t at);
+        ContextExtractor& extractor;
+        Embedder& embedder;
+};
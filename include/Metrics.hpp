@@ -0,0 +1,112 @@
+/*Process wide metrics so a slow run can be broken down by stage.
+-Counter / Gauge are single atomics
+-Histogram keeps log-bucketed latencies (4 buckets per power of two) in atomics, so
+ recording never takes a lock and percentiles are accurate to ~20%
+-Metrics::instance() hands out named instruments; look them up once (a function local
+ static) and keep the reference, the lookup itself takes a mutex
+-Optionally records every ScopedTimer as a Chrome trace event (chrome://tracing)*/
+
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+#include <nlohmann/json.hpp>
+
+class Counter{
+    public:
+        void add(uint64_t n = 1) { value_.fetch_add(n, std::memory_order_relaxed); }
+        uint64_t value() const { return value_.load(std::memory_order_relaxed); }
+    private:
+        std::atomic<uint64_t> value_{0};
+};
+
+class Gauge{
+    public:
+        void set(int64_t v) { value_.store(v, std::memory_order_relaxed); }
+        void add(int64_t d) { value_.fetch_add(d, std::memory_order_relaxed); }
+        int64_t value() const { return value_.load(std::memory_order_relaxed); }
+    private:
+        std::atomic<int64_t> value_{0};
+};
+
+class Histogram{
+    public:
+        static constexpr int kSubBuckets = 4;
+        static constexpr int kBuckets = 64 * kSubBuckets;
+
+        void record(uint64_t nanos);
+        uint64_t count() const { return count_.load(std::memory_order_relaxed); }
+        uint64_t sumNanos() const { return sum_.load(std::memory_order_relaxed); }
+        //p in [0,1], nanoseconds
+        double percentile(double p) const;
+
+    private:
+        std::atomic<uint64_t> buckets_[kBuckets] = {};
+        std::atomic<uint64_t> count_{0};
+        std::atomic<uint64_t> sum_{0};
+
+        static int bucketFor(uint64_t nanos);
+        static double bucketMid(int bucket);
+};
+
+class Metrics{
+    public:
+        static Metrics& instance();
+
+        Counter&   counter(const std::string& name);
+        Gauge&     gauge(const std::string& name);
+        Histogram& histogram(const std::string& name);
+
+        //{"counters":{}, "gauges":{}, "stages":{name:{count,p50_ms,p95_ms,p99_ms,mean_ms,total_ms}}}
+        nlohmann::json toJson() const;
+        bool writeJson(const std::string& path) const;
+
+        //chrome trace events; off unless enabled, meant for a single run
+        void enableTrace(bool on) { tracing_.store(on, std::memory_order_relaxed); }
+        bool tracing() const { return tracing_.load(std::memory_order_relaxed); }
+        void traceEvent(const char* name, std::chrono::steady_clock::time_point start,
+                        std::chrono::steady_clock::time_point end);
+        bool writeTrace(const std::string& path) const;
+
+    private:
+        Metrics();
+
+        mutable std::mutex mutex_;
+        std::map<std::string, std::unique_ptr<Counter>>   counters_;
+        std::map<std::string, std::unique_ptr<Gauge>>     gauges_;
+        std::map<std::string, std::unique_ptr<Histogram>> histograms_;
+
+        std::atomic<bool> tracing_{false};
+        std::chrono::steady_clock::time_point origin_;
+        mutable std::mutex traceMutex_;
+        nlohmann::json traceEvents_ = nlohmann::json::array();
+};
+
+//times the enclosing scope into a histogram (and the trace when enabled)
+class ScopedTimer{
+    public:
+        ScopedTimer(Histogram& histogram, const char* traceName)
+            : histogram_(histogram), name_(traceName), start_(std::chrono::steady_clock::now()) {}
+        ~ScopedTimer();
+
+        ScopedTimer(const ScopedTimer&) = delete;
+        ScopedTimer& operator=(const ScopedTimer&) = delete;
+
+    private:
+        Histogram& histogram_;
+        const char* name_;
+        std::chrono::steady_clock::time_point start_;
+};
+
+//STAGE_TIMER("embed.onnx_run"); times the rest of the scope into that histogram
+#define CORTEX_CONCAT_(a, b) a##b
+#define CORTEX_CONCAT(a, b) CORTEX_CONCAT_(a, b)
+#define STAGE_TIMER(name)                                                              \
+    static Histogram& CORTEX_CONCAT(stageHist_, __LINE__) = Metrics::instance().histogram(name); \
+    ScopedTimer CORTEX_CONCAT(stageTimer_, __LINE__)(CORTEX_CONCAT(stageHist_, __LINE__), name)
@@ -0,0 +1,29 @@
+/*Near-duplicate text signatures (SimHash) for revised drafts, exported copies and
+rotated logs, which would otherwise each be embedded and each come back in results.
+-A 64-bit SimHash over 3-word shingles of the extracted text: texts that share most
+ shingles end up a few bits apart, unrelated texts about 32 bits apart
+-Stored on the files row; LSH buckets are the signature's four 16-bit bands, so two
+ signatures within kMaxDistance (<= 3) bits share at least one band exactly and are
+ found with an index lookup instead of a scan
+-SimHash rather than MinHash: one integer per file instead of ~100, at the cost of
+ only catching close matches (about 95% of shingles shared), which is the case here*/
+
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <string>
+
+namespace NearDuplicate{
+    constexpr int kBands = 4;
+    //Hamming distance at or below which two texts count as near-duplicates
+    constexpr int kMaxDistance = 3;
+
+    //0 for text without a single word
+    uint64_t simhash(const std::string& text);
+
+    inline int distance(uint64_t a, uint64_t b) { return __builtin_popcountll(a ^ b); }
+
+    //(band << 16) | band bits, one bucket per band
+    std::array<int64_t, kBands> buckets(uint64_t signature);
+}
@@ -0,0 +1,76 @@
+/*Compact path/name/extension columns for the in-memory index.
+-Directories are a tree of interned components: a directory is stored once, as its
+ parent id plus its own name, however many files sit in it
+-Per file only the directory id, the file name (without its extension when the
+ extension can be put back) and a small extension id are kept
+-Full path strings are built on demand, for results that are actually returned
+Rows are appended once while loading and read-only afterwards; the caller locks*/
+
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+class PathStore{
+    public:
+        //appends one file; returns its row
+        size_t add(const std::string& path, const std::string& name, const std::string& extension);
+        //drops the lookup tables only adding needs and trims the columns
+        void seal();
+
+        std::string path(size_t row) const;
+        std::string name(size_t row) const;
+        //as it was added, original case: ".PDF" for "SCAN.PDF"
+        const std::string& extension(size_t row) const { return extensions_[files_[row].ext]; }
+        uint16_t extensionId(size_t row) const { return files_[row].ext; }
+        //every extension seen, indexed by extensionId; ".MD" and ".md" get their own ids
+        const std::vector<std::string>& extensions() const { return extensions_; }
+        //lowerExtension() of each of them, what extension filters match against
+        const std::vector<std::string>& extensionKeys() const { return extensionKeys_; }
+
+        //first row whose path is not less than path; rows must have been added in path order
+        size_t lowerBound(const std::string& path) const;
+
+        size_t size() const { return files_.size(); }
+        bool empty() const { return files_.empty(); }
+        //heap bytes held by the columns (what a million files cost, see cortex_bench)
+        size_t bytes() const;
+
+        static std::string lowerExtension(const std::string& ext);
+
+    private:
+        static constexpr uint32_t kNoDir = UINT32_MAX;
+        //top bit of File::leafLength: the extension was cut off the stored name
+        static constexpr uint16_t kExtCut = 0x8000;
+
+        struct Dir{
+            uint32_t parent;     //kNoDir above the first component
+            uint32_t offset;     //name in chars_
+            uint32_t length;
+        };
+        struct File{
+            uint32_t dir;
+            uint32_t leafOffset; //file name in chars_
+            uint16_t leafLength; //| kExtCut
+            uint16_t ext;
+        };
+
+        std::string chars_;                      //every component and file name, back to back
+        std::vector<Dir> dirs_;
+        std::vector<File> files_;
+        std::vector<std::string> extensions_;
+        std::vector<std::string> extensionKeys_;
+        //names that are not the last path component, rare (FileRow.name is the file name)
+        std::unordered_map<uint32_t, std::string> otherNames_;
+
+        //while adding: (parent, component) -> dir, extension -> id
+        std::unordered_map<std::string, uint32_t> dirLookup_;
+        std::unordered_map<std::string, uint16_t> extLookup_;
+
+        uint32_t appendChars(const char* s, size_t n);
+        uint32_t directory(uint32_t parent, const char* s, size_t n);
+        void appendDir(uint32_t dir, std::string& out) const;
+        void appendLeaf(const File& f, std::string& out) const;
+};
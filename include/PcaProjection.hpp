@@ -0,0 +1,59 @@
+/*Linear projection of the full embeddings onto their top principal components.
+-Learned from a sample of the indexed vectors, stored as JSON in the metadata table
+-VectorIndex keeps the reduced (64/128-d) rows next to the full ones for a cheap
+ first pass; the shortlist is then rescored with the full vectors
+-Remembers how many rows it was trained on and how much variance it kept, so a
+ corpus that has grown or shifted can be detected and the projection retrained*/
+
+#pragma once
+
+#include <cstddef>
+#include <memory>
+#include <string>
+#include <vector>
+#include "DatabaseManager.hpp"
+
+class VectorIndex;
+
+class PcaProjection{
+    public:
+        //top outDim components of rows (count x dim, row-major), from at most maxSamples rows
+        static std::shared_ptr<PcaProjection> train(const float* rows, size_t count, size_t dim,
+                                                    size_t outDim, size_t maxSamples = 8192);
+        //nullptr when the index has no vectors or fewer than outDim dimensions
+        static std::shared_ptr<PcaProjection> train(const VectorIndex& index, size_t outDim);
+
+        //nullptr when nothing (or something unreadable) is stored
+        static std::shared_ptr<PcaProjection> load(DatabaseManager& manager);
+        bool save(DatabaseManager& manager) const;
+
+        //out[outputDim()] = components * (in - mean)
+        void project(const float* in, float* out) const;
+        //dot(mean, v): with it, dot(x, q) = dot(Px, Pq) + dot(mean, x) + dot(mean, q) - |mean|^2
+        //up to the variance the dropped components held
+        float meanDot(const float* v) const;
+        float meanSquaredNorm() const { return meanSquaredNorm_; }
+
+        //share of the rows' variance (around the stored mean) the components keep, 0..1
+        float retainedVariance(const float* rows, size_t count, size_t maxSamples = 2048) const;
+        //true when the index no longer matches what this was trained on: other dimension,
+        //row count off by more than a third, or noticeably less variance retained
+        bool stale(const VectorIndex& index) const;
+
+        size_t inputDim() const { return inputDim_; }
+        size_t outputDim() const { return outputDim_; }
+        size_t trainedRows() const { return trainedRows_; }
+        float trainedVariance() const { return trainedVariance_; }
+
+    private:
+        size_t inputDim_ = 0;
+        size_t outputDim_ = 0;
+        size_t trainedRows_ = 0;
+        float trainedVariance_ = 0.0f;
+        std::vector<float> mean_;          //inputDim_
+        std::vector<float> components_;    //outputDim_ x inputDim_, orthonormal rows
+        std::vector<float> meanProjected_; //components_ * mean_
+        float meanSquaredNorm_ = 0.0f;
+
+        void finish();   //derives meanProjected_/meanSquaredNorm_ once mean_/components_ are set
+};
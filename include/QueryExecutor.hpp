@@ -0,0 +1,67 @@
+/*Runs searches off the UI thread.
+-submit() is cheap: it records the newest query and cancels whatever is still running
+-a worker waits for the typing to pause (debounce), then runs the newest query only
+-finished results are published as an immutable snapshot swapped in atomically,
+ so the render loop just loads the pointer each frame and never waits on a search
+-a scan that runs long publishes its best-so-far results along the way (completeness < 1),
+ newest files first, and the final snapshot replaces them*/
+
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include "SearchEngine.hpp"
+
+struct QuerySnapshot{
+    uint64_t generation = 0;   //increases with every submit
+    std::string query;
+    std::vector<SearchResult> results;
+    double latencyMs = 0.0;
+    double completeness = 1.0; //share of matching files scored; < 1 while the scan is still refining
+};
+
+class QueryExecutor{
+    public:
+        explicit QueryExecutor(SearchEngine& searcher,
+                               std::chrono::milliseconds debounce = std::chrono::milliseconds(150));
+        ~QueryExecutor();
+
+        QueryExecutor(const QueryExecutor&) = delete;
+        QueryExecutor& operator=(const QueryExecutor&) = delete;
+
+        //immediate skips the debounce (e.g. Enter pressed)
+        void submit(const std::string& query, const SearchOptions& options, bool immediate = false);
+
+        //newest published results; never null
+        std::shared_ptr<const QuerySnapshot> latest() const;
+
+        //a query is waiting for the debounce or running
+        bool busy() const { return busy_.load(std::memory_order_relaxed); }
+
+    private:
+        SearchEngine& searcher;
+        const std::chrono::milliseconds debounce;
+
+        std::mutex mutex_;
+        std::condition_variable wake_;
+        bool stop_ = false;
+        bool hasPending_ = false;
+        std::string pendingQuery_;
+        SearchOptions pendingOptions_;
+        uint64_t pendingGeneration_ = 0;
+        std::chrono::steady_clock::time_point pendingAt_;
+        std::shared_ptr<std::atomic<bool>> newestCancel_;
+
+        std::atomic<bool> busy_{false};
+        std::shared_ptr<const QuerySnapshot> published_;   //accessed with std::atomic_load/store
+        std::thread worker_;
+
+        void run();
+        void publish(std::shared_ptr<const QuerySnapshot> snapshot);
+};
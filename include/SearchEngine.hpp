@@ -10,29 +10,39 @@
 #include <vector>
 #include <string>
 #include "DatabaseManager.hpp"
-#include "EmbeddingEngine.hpp"
+#include "Embedder.hpp"
+#include "VectorIndex.hpp"
+#include "TaskScheduler.hpp"
 
 
-struct SearchResult{    
-    std::string path;
-    std::string name;
-    std::string extension;
-    float score;//the closeness to the vector
-};
-
 class SearchEngine{
     public:
         //constructor takes in the databse and the Embedding vector 
-        SearchEngine(DatabaseManager& manager, EmbeddingEngine& embedder);
+        SearchEngine(DatabaseManager& manager, Embedder& embedder);
+        //with a warm index the vectors are scored from memory instead of sqlite
+        SearchEngine(DatabaseManager& manager, Embedder& embedder, const VectorIndex& index);
 
 
         //search function gets the topK search results based on the input 
+        //(with options.deadline it returns the best found in time, see options.completeness)
         std::vector<SearchResult> search(const std::string& searchInput, int topK = 5);
+        std::vector<SearchResult> search(const std::string& searchInput, const SearchOptions& options);
+
+        //"more like this": ranks against the file's stored vector, no extraction or inference.
+        //The file itself is left out; empty when it isn't indexed
+        std::vector<SearchResult> searchByFile(const std::string& path, int topK = 5);
+        std::vector<SearchResult> searchByFile(const std::string& path, const SearchOptions& options);
+
+        //when set, embedding and scoring run in an Interactive slot, ahead of any indexing
+        TaskScheduler* scheduler = nullptr;
     
     private:
         DatabaseManager& manager;
-        EmbeddingEngine& embedder;
+        Embedder& embedder;
+        const VectorIndex* index = nullptr;
 
-        float cosineSimilarity(const std::vector<float>& fileEmbeddingVector, const std::vector<float> searchEmbeddingVector);
+        //ranks the index (or the db rows) against an already embedded query
+        std::vector<SearchResult> rank(const std::vector<float>& query, const SearchOptions& options);
+        float cosineSimilarity(const std::vector<float>& fileEmbeddingVector, const std::vector<float>& searchEmbeddingVector);
 
 };
\ No newline at end of file
@@ -0,0 +1,136 @@
+/*Long running search daemon
+-Keeps the EmbeddingEngine, the database and a warm VectorIndex in memory
+-Listens on a unix domain socket, one JSON request per line, one JSON reply per line
+    {"op":"search","query":"...","k":5,"ext":[".pdf"],"under":"/dir","since":1700000000,"coarse":true}
+    {"op":"similar","path":"/dir/file.pdf","k":5}    (same filters as search)
+    "budget_ms":50 on either returns the best found by then, newest files scanned first;
+    the reply's "completeness" is the share of matching files that were scored;
+    "collapse":true returns one hit per near-duplicate group, with a "duplicates" count
+    {"op":"index","path":"/dir","resume":true,"limits":{"threads":4,"cpu_share":0.5}}
+    ("limits" override the daemon's governor limits for that run, see limitsToJson)
+    {"op":"stats"}
+    {"op":"attach","name":"home","root":"/Users/me"}, {"op":"detach","name":"home"},
+    {"op":"rebuild","name":"home"}, {"op":"shards"}     (sharded index only)
+-A fixed pool of workers serves the accepted connections
+-Query texts that arrive together are embedded as one batch (EmbeddingBatcher)
+SearchClient is the other end, used by the CLI when a daemon is running*/
+
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <thread>
+#include <vector>
+#include <nlohmann/json.hpp>
+#include "DatabaseManager.hpp"
+#include "ContextExtractor.hpp"
+#include "Embedder.hpp"
+#include "EmbeddingBatcher.hpp"
+#include "VectorIndex.hpp"
+#include "ShardSet.hpp"
+#include "IndexGovernor.hpp"
+#include "TaskScheduler.hpp"
+
+struct ServerConfig{
+    std::string socketPath = "cortex.sock";
+    int workers = 4;
+    size_t pcaDims = 64;   //reduced size for coarse search; 0 never trains a projection
+    size_t batchMax = 16;  //queries embedded in one model run; 1 turns batching off
+    int batchWindowUs = 2000;   //longest a query waits for others to batch with
+    GovernorLimits indexLimits; //for index/rebuild requests, which run next to the queries
+};
+
+class SearchServer{
+    public:
+        SearchServer(DatabaseManager& manager, ContextExtractor& extractor,
+                     Embedder& embedder, const ServerConfig& config);
+        //sharded index: search fans out over the shards and the shard ops
+        //(attach, detach, rebuild, shards) are enabled
+        SearchServer(ShardSet& shards, ContextExtractor& extractor,
+                     Embedder& embedder, const ServerConfig& config);
+        ~SearchServer();
+
+        //binds the socket and serves until stop() (or SIGINT/SIGTERM); returns an exit code
+        int run();
+        //asks run() to return; safe to call from any thread
+        void stop();
+
+        //handles one decoded request; public so it can be driven without a socket
+        nlohmann::json handle(const nlohmann::json& request);
+
+    private:
+        DatabaseManager* manager = nullptr;   //exactly one of manager / shards is set
+        ShardSet* shards = nullptr;
+        ContextExtractor& extractor;
+        Embedder& embedder;
+        ServerConfig config;
+        //query embedding goes through this when batching is on; indexing never does
+        std::unique_ptr<EmbeddingBatcher> batcher;
+        Embedder& queryEmbedder() { return batcher ? static_cast<Embedder&>(*batcher) : embedder; }
+        VectorIndex index;
+        //one slot per worker; searches are Interactive, index requests Background
+        TaskScheduler scheduler;
+
+        int listenFd = -1;
+        std::atomic<bool> running{false};
+        std::vector<std::thread> workers;
+
+        //accepted connections waiting for a worker
+        std::mutex queueMutex;
+        std::condition_variable queueReady;
+        std::deque<int> pending;
+
+        //one index run (and the reload after it) at a time; DatabaseManager itself is
+        //thread safe, so reads and the projection save don't take it
+        std::mutex dbMutex;
+
+        std::chrono::steady_clock::time_point startedAt;
+        std::string modelVariant;   //read once at start-up, reported by stats
+        std::atomic<long long> requestsServed{0};
+
+        //background PCA retraining; at most one job runs. The job clears retraining when
+        //it is done, so projectionJob is reaped and replaced only under projectionMutex
+        std::atomic<bool> retraining{false};
+        std::mutex projectionMutex;
+        std::future<void> projectionJob;
+
+        void shutdown();   //joins workers, closes and removes the socket
+        void workerLoop();
+        void serveConnection(int fd);
+
+        nlohmann::json handleSearch(const nlohmann::json& request);
+        nlohmann::json handleSimilar(const nlohmann::json& request);
+        nlohmann::json handleIndex(const nlohmann::json& request);
+        nlohmann::json handleStats();
+        //loads the stored projection and retrains it in the background when it is missing or stale
+        void maintainProjection();
+        nlohmann::json handleShardOp(const std::string& op, const nlohmann::json& request);
+};
+
+class SearchClient{
+    public:
+        explicit SearchClient(std::string socketPath = "cortex.sock");
+
+        //true when a daemon accepts connections on the socket
+        bool available() const;
+
+        //sends one request and waits for its reply; nullopt if the daemon can't be reached
+        std::optional<nlohmann::json> request(const nlohmann::json& request) const;
+
+    private:
+        std::string socketPath;
+};
+
+//wire format helpers shared by both ends
+nlohmann::json filterToJson(const SearchFilter& filter);
+SearchFilter filterFromJson(const nlohmann::json& j);
+//only the limits that differ from GovernorLimits(); the rest keep the daemon's own
+nlohmann::json limitsToJson(const GovernorLimits& limits);
+GovernorLimits limitsFromJson(const nlohmann::json& j, GovernorLimits base);
@@ -0,0 +1,102 @@
+/*An index split into shards, each with its own sqlite file and in-memory VectorIndex.
+-Every shard covers a root directory; a file goes to the shard with the longest root
+ that contains it. Shards that share a root split its files by path hash.
+-Attaching or detaching a shard re-routes files (a deeper root takes them over, a
+ same-root sibling changes the hash split): the stored rows that no longer route to
+ their shard are moved, vectors included, to the shard they route to now, so a file
+ is never searched twice. Rows whose new shard is not involved are dropped and come
+ back with the next index run.
+-A query runs on all shards in parallel and the per-shard topK lists are merged
+-Shards are attached, detached and rebuilt one at a time; queries keep running on
+ the others (and on the old copy of a shard until its rebuild is swapped in)
+The shard list lives in <dir>/shards.json, shard data in <dir>/<name>.db*/
+
+#pragma once
+
+#include <memory>
+#include <mutex>
+#include <shared_mutex>
+#include <string>
+#include <vector>
+#include <nlohmann/json.hpp>
+#include "ContextExtractor.hpp"
+#include "DatabaseManager.hpp"
+#include "Embedder.hpp"
+#include "IndexGovernor.hpp"
+#include "TaskScheduler.hpp"
+#include "VectorIndex.hpp"
+
+struct ShardInfo{
+    std::string name;
+    std::string root;
+    size_t files = 0;
+};
+
+class ShardSet{
+    public:
+        //opens every shard listed in <directory>/shards.json; variant is checked on each shard,
+        //and model name/dimension (when given) are recorded with it, see useModelVariant
+        ShardSet(const std::string& directory, const std::string& modelVariant = "fp32",
+                 const std::string& modelName = "", size_t dimension = 0);
+
+        //the variant the shards listed in <directory>/shards.json were embedded with, read from
+        //their metadata before a ShardSet (and its embedder) is built; "" when none holds files.
+        //False, with a message on stderr, when the shards disagree
+        static bool storedModelVariant(const std::string& directory, std::string& variant);
+
+        //adds a shard for root (creating <name>.db if needed) and loads its vectors, then
+        //moves over the rows of the shards it takes files from
+        bool attach(const std::string& name, const std::string& root);
+        //stops routing to and searching the shard; its .db file is kept for a later attach.
+        //Same-root siblings re-split the files among themselves
+        bool detach(const std::string& name);
+        //re-indexes the shard's root into a fresh database and swaps it in; -1 if unknown or
+        //if the swap failed (the old database stays in use, the new one is kept as
+        //<name>.rebuild.db)
+        int rebuild(const std::string& name, ContextExtractor& extractor, Embedder& embedder,
+                    TaskScheduler* scheduler = nullptr, IndexGovernor* governor = nullptr);
+
+        //indexes every file under directory into the shard it routes to; files outside
+        //every root are skipped. Returns the number of files inserted/updated.
+        //With a scheduler the embedding runs in Background slots (see Indexer::scheduler),
+        //with a governor extraction runs in parallel under its limits (Indexer::governor)
+        int indexDirectory(const std::string& directory, ContextExtractor& extractor, Embedder& embedder,
+                           TaskScheduler* scheduler = nullptr, IndexGovernor* governor = nullptr);
+
+        //fan-out over the shards that can hold matches, then merge to options.topK
+        std::vector<SearchResult> search(const std::vector<float>& query, const SearchOptions& options) const;
+
+        //stored vector of an indexed file, from the shard it routes to; empty if it isn't indexed
+        std::vector<float> vectorOf(const std::string& path) const;
+
+        std::vector<ShardInfo> list() const;
+        size_t size() const;        //files over all shards
+        size_t dimension() const;   //of the first non-empty shard
+        const std::string& modelVariant() const { return modelVariant_; }
+
+    private:
+        struct Shard{
+            std::string name;
+            std::string root;                  //absolute, no trailing '/'
+            std::mutex writeMutex;             //serializes indexing/rebuild of this shard
+            std::unique_ptr<DatabaseManager> db;
+            VectorIndex index;
+        };
+
+        std::string directory_;
+        std::string modelVariant_;
+        std::string modelName_;
+        size_t dimension_ = 0;
+        mutable std::shared_mutex mutex_;      //guards shards_ (the list, not the shards)
+        std::vector<std::shared_ptr<Shard>> shards_;
+
+        std::string dbPath(const std::string& name) const;
+        bool saveManifest() const;             //caller holds mutex_
+        std::shared_ptr<Shard> find(const std::string& name) const;
+        std::vector<std::shared_ptr<Shard>> snapshot() const;
+        //shard a file belongs to, or nullptr when no root contains it
+        std::shared_ptr<Shard> route(const std::string& path) const;
+        //after the shard list changed at root: moves rows of the same-root shards (and, on
+        //attach, of the new shard and the shards above it) to the shard they route to now
+        void rehome(const std::string& root, const std::shared_ptr<Shard>& attached);
+};
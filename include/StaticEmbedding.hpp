@@ -0,0 +1,45 @@
+/*Static token embeddings (model2vec-style): one distilled vector per vocabulary token,
+no transformer pass. A text's embedding is the weighted mean of its tokens' rows,
+L2-normalized, which costs a table lookup and an add per token.
+-Loaded from one file written by tools/export_static.py:
+   "CXSTATIC" | u32 version=1 | u32 vocab | u32 dim | u32 unk id | u32 flags (1 = f16 rows)
+   | vocab x (u16 length, token bytes) | vocab x f32 weight | vocab x dim rows
+-Tokenized in process with the vocabulary's WordPiece rules (BERT uncased: lowercase,
+ split on whitespace and punctuation, greedy longest match with "##" continuations);
+ unknown words are dropped rather than pooled as [UNK]
+-Immutable after load, so any number of threads can embed at once*/
+
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+class StaticEmbedding{
+    public:
+        //nullptr (and a message on stderr) when the file is missing or malformed
+        static std::unique_ptr<StaticEmbedding> load(const std::string& path);
+        //the table's vector size from its header alone; 0 when the file is not a table
+        static size_t readDimension(const std::string& path);
+
+        //writes dimension() floats; false when no token of text is in the vocabulary
+        bool embed(const std::string& text, float* out) const;
+
+        size_t dimension() const { return dim_; }
+        size_t vocabularySize() const { return weights_.size(); }
+
+        //token ids of text as embed() pools them (exposed for checks and benchmarks)
+        std::vector<int32_t> tokenize(const std::string& text) const;
+
+    private:
+        size_t dim_ = 0;
+        int32_t unkId_ = -1;
+        std::unordered_map<std::string, int32_t> vocab_;
+        std::vector<float> weights_;   //pooling weight per token
+        std::vector<float> rows_;      //vocab x dim_, float32 whatever the file holds
+
+        //WordPiece of one lowercased word, appended to ids
+        void wordPiece(const std::string& word, std::string& probe, std::vector<int32_t>& ids) const;
+};
@@ -0,0 +1,65 @@
+/*Priority gate in front of the work queries and indexing share (the embedding
+session, the vector scan, the database).
+-A fixed number of slots; a task holds one while it runs
+-Interactive tasks (search) are always admitted before Background ones (indexing):
+ a background task is not let in while an interactive one is queued
+-Background tasks call yield() at safe points (between files, between embedding and
+ the insert) so a query never waits for more than one such step
+Work that needs none of the shared state (file scanning, text extraction, OCR) runs
+outside a slot*/
+
+#pragma once
+
+#include <condition_variable>
+#include <mutex>
+
+class TaskScheduler{
+    public:
+        enum class Priority{ Interactive, Background };
+
+        //released when it goes out of scope; an empty Slot (default constructed) holds nothing
+        class Slot{
+            public:
+                Slot() = default;
+                Slot(Slot&& other) noexcept;
+                Slot& operator=(Slot&& other) noexcept;
+                Slot(const Slot&) = delete;
+                Slot& operator=(const Slot&) = delete;
+                ~Slot() { release(); }
+
+                void release();
+                bool held() const { return owner_ != nullptr; }
+
+            private:
+                friend class TaskScheduler;
+                Slot(TaskScheduler* owner, Priority priority) : owner_(owner), priority_(priority) {}
+                TaskScheduler* owner_ = nullptr;
+                Priority priority_ = Priority::Background;
+        };
+
+        explicit TaskScheduler(int slots = 1);
+
+        //blocks until a slot is free and no higher priority task is waiting for it
+        Slot acquire(Priority priority);
+        //background safe point: when interactive work is queued, gives the slot up and waits
+        //to get it back. Returns true if it yielded
+        bool yield(Slot& slot);
+
+        bool interactiveWaiting() const;
+
+        //runs f while holding a slot of the given priority
+        template <typename F>
+        auto run(Priority priority, F&& f) -> decltype(f()) {
+            Slot slot = acquire(priority);
+            return f();
+        }
+
+    private:
+        mutable std::mutex mutex_;
+        std::condition_variable changed_;
+        const int slots_;
+        int inUse_ = 0;
+        int interactiveQueued_ = 0;    //waiting in acquire()
+
+        void releaseSlot();
+};
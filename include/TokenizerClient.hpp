@@ -14,6 +14,8 @@ class TokenizerClient{
     public:
         TokenizerClient(const std::string pythonExe, std::string modelPath, std::string tokenizerJson, int maxLen = 256);
         std::optional<TokenizerResults> encode(const std::string& text) const; 
+        //all texts in one helper run; nullopt if any of them fails
+        std::optional<std::vector<TokenizerResults>> encodeBatch(const std::vector<std::string>& texts) const;
 
 
     private:
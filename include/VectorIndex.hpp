@@ -0,0 +1,130 @@
+/*In-memory copy of every stored embedding so a long running process can answer
+queries without going back to sqlite.
+-Vectors live in one contiguous row-major block (one row per file)
+-Rows are ordered by path so a directory prefix is a contiguous row range
+-Paths live in a PathStore (interned directories, extension ids); full strings are
+ only built for the rows a search returns
+-Extensions are kept as small ids so a filter becomes a bitmap over the rows
+-With a PCA projection set, reduced copies of the rows sit next to the full ones for a
+ coarse first pass (options.coarse) whose shortlist is rescored on the full vectors
+-Near-duplicate groups (files sharing a representative's embedding) are a bitmap of the
+ rows in any group plus a row -> representative row map, both empty for most corpora
+-Anytime search (a deadline or a progress callback) scans runs of 64 rows in order of
+ their newest file, so a scan cut short has scored the recently touched directories*/
+
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <shared_mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "DatabaseManager.hpp"
+#include "PcaProjection.hpp"
+#include "PathStore.hpp"
+
+struct SearchResult{
+    std::string path;
+    std::string name;
+    std::string extension;
+    float score;//the closeness to the vector
+    int duplicates = 0;//with collapseDuplicates: other matching files of its near-duplicate group
+};
+
+//one file and the files closest to it, best first
+struct Neighbours{
+    std::string path;
+    std::vector<SearchResult> similar;
+};
+
+//everything that shapes a search besides the query text itself
+struct SearchOptions{
+    int topK = 5;
+    SearchFilter filter;//applied before scoring so topK is filled from matching files only
+    //polled inside the scan loop; once set the search stops early and its results are stale
+    const std::atomic<bool>* cancelled = nullptr;
+    //rank on the PCA-reduced vectors, then rescore the best `shortlist` rows with the full
+    //ones (0 = max(20 * topK, 200)); ignored while the index has no projection
+    bool coarse = false;
+    int shortlist = 0;
+    //one result per near-duplicate group (the representative when scores tie, which they
+    //do for files that share its embedding); SearchResult::duplicates counts the rest.
+    //Warm index only: the sqlite fallback scan has no groups
+    bool collapseDuplicates = false;
+
+    //anytime search: once the deadline passes the scan stops and the best rows scored so far
+    //are returned; rows are then visited newest first. Default time_point = no deadline
+    std::chrono::steady_clock::time_point deadline{};
+    //called from the scan at most every progressEvery with the current topK and the share of
+    //matching rows scored so far, so a UI can draw early results and refine them
+    std::function<void(const std::vector<SearchResult>&, double)> onProgress;
+    std::chrono::milliseconds progressEvery{50};
+    //when set, receives the share of matching rows actually scored (1 unless cut short)
+    double* completeness = nullptr;
+
+    bool isCancelled() const { return cancelled && cancelled->load(std::memory_order_relaxed); }
+    bool hasDeadline() const { return deadline != std::chrono::steady_clock::time_point{}; }
+    bool pastDeadline() const { return hasDeadline() && std::chrono::steady_clock::now() >= deadline; }
+    void reportCompleteness(double share) const { if (completeness) *completeness = share; }
+};
+
+class VectorIndex{
+    public:
+        using RowVisitor = std::function<void(const FileRow&, const float*, size_t)>;
+
+        //(re)loads every embedding from the database, replacing what is in memory
+        void load(DatabaseManager& manager);
+        //same, from any source that calls the visitor once per row in path order
+        void load(const std::function<void(const RowVisitor&)>& source);
+
+        //scores only the rows that pass options.filter and returns the best topK
+        std::vector<SearchResult> search(const std::vector<float>& query, const SearchOptions& options) const;
+
+        //the stored vector of one file (exact path); empty when it isn't in the index
+        std::vector<float> vectorOf(const std::string& path) const;
+        //topK closest other files for every row, in path order (duplicate and cluster reports).
+        //Rows are split over `threads` workers (0 = one per core)
+        std::vector<Neighbours> allNeighbours(size_t topK, unsigned threads = 0) const;
+
+        size_t size() const;
+        size_t dimension() const;
+        //heap bytes of the path/name/extension columns
+        size_t metadataBytes() const;
+
+        //projects every row (and every later load) with pca; nullptr drops the reduced rows.
+        //A projection for another dimension is kept but unused until the rows match it
+        void setProjection(std::shared_ptr<const PcaProjection> pca);
+        std::shared_ptr<const PcaProjection> projection() const;
+        //copies of up to maxRows rows spread evenly over the index, for training/drift checks
+        std::vector<float> sampleRows(size_t maxRows, size_t& dim) const;
+
+    private:
+        mutable std::shared_mutex mutex_;
+        std::mutex writeMutex_;             //serializes load/setProjection; queries never take it
+
+        size_t dim_ = 0;
+        std::vector<float> vectors_;        //size() * dim_ floats
+        std::vector<float> norms_;          //L2 norm per row
+        PathStore files_;                   //one row per vector, sorted by path
+        std::vector<long long> modified_;
+        //first row of each kSegmentRows run, the run holding the newest file first (anytime scans).
+        //Runs rather than single rows keep the scan streaming memory in order
+        static constexpr size_t kSegmentRows = 64;
+        std::vector<uint32_t> newestSegments_;
+        std::vector<uint64_t> grouped_;                   //bit per row: in a group of two or more
+        std::unordered_map<uint32_t, uint32_t> groupOf_;  //grouped row -> its group's representative row
+
+        std::shared_ptr<const PcaProjection> pca_;
+        std::vector<float> reduced_;        //size() * pca_->outputDim() floats, empty if unusable
+        std::vector<float> meanDots_;       //dot(pca mean, row) per row
+
+        //rows [first, last) whose path lies under dir
+        void pathRange(const std::string& dir, size_t& first, size_t& last) const;
+        //one bit per row in [first, last) for rows passing the extension/mtime predicates
+        std::vector<uint64_t> filterBitmap(const SearchFilter& filter, size_t first, size_t last) const;
+};
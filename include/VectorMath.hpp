@@ -0,0 +1,23 @@
+/*Small float kernels shared by the embedding, search and benchmark code.
+Written as plain loops over raw pointers so the compiler can vectorize them*/
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+namespace VectorMath{
+    float dot(const float* a, const float* b, size_t n);
+    float squaredNorm(const float* a, size_t n);
+    //0 when either vector is all zeros
+    float cosineSimilarity(const float* a, const float* b, size_t n);
+    //scales v to unit length in place (left alone if it is all zeros)
+    void l2Normalize(float* v, size_t n);
+    //y += a * x; x and y must not overlap
+    void axpy(float a, const float* x, float* y, size_t n);
+    //out[h] = mean of H[t][h] over the tokens with mask[t] != 0; H is [seq, hidden] row-major
+    void maskedMeanPool(const float* H, const int64_t* mask, size_t seq, size_t hidden, float* out);
+    //maskedMeanPool followed by l2Normalize in one pass over H; the mean's 1/count
+    //cancels under normalization so it is never applied
+    void maskedMeanPoolNormalize(const float* H, const int64_t* mask, size_t seq, size_t hidden, float* out);
+}
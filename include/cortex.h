@@ -0,0 +1,110 @@
+/*libcortex: CortexSearch as a library, behind a C ABI.
+-One cortex_index handle keeps the model, the database and the warm vector index loaded;
+ every function taking it is safe to call from any number of threads at once
+-Searches write into caller-provided buffers, nothing the library allocates crosses
+ the boundary
+-Option structs start with struct_size; fill them with the cortex_default_* functions
+ first so a caller built against an older header keeps working with a newer library
+-Functions return a cortex_status; cortex_last_error() has the message for the
+ failing call on the calling thread*/
+
+#ifndef CORTEX_H
+#define CORTEX_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define CORTEX_API __attribute__((visibility("default")))
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define CORTEX_ABI_VERSION 1
+
+typedef enum cortex_status{
+    CORTEX_OK = 0,
+    CORTEX_ERR_ARGUMENT = 1,   /* null handle/pointer or a malformed option */
+    CORTEX_ERR_OPEN = 2,       /* database or model could not be opened */
+    CORTEX_ERR_EMBED = 3,      /* the query could not be embedded */
+    CORTEX_ERR_BUFFER = 4,     /* text buffer too small; the hits that fit were written */
+    CORTEX_ERR_INTERNAL = 5
+} cortex_status;
+
+typedef struct cortex_index cortex_index;
+
+typedef struct cortex_options{
+    size_t struct_size;
+    const char* db_path;           /* "cortex.db" */
+    const char* model_path;        /* "models/model.onnx" */
+    const char* python_exe;        /* "./.venv/bin/python" */
+    const char* tokenizer_script;  /* "tools/tokenize.py" */
+    const char* tokenizer_json;    /* "models/tokenizer.json" */
+    const char* model_variant;     /* NULL: the variant the index was built with */
+    int fake_embedder;             /* 1: deterministic hashing embedder, no model files */
+    int threads;                   /* searches/index steps running at once (4) */
+    int max_batch;                 /* concurrent queries embedded together (16, 1 = off) */
+    int batch_window_us;           /* longest a query waits for others (2000) */
+} cortex_options;
+
+typedef struct cortex_search_options{
+    size_t struct_size;
+    const char* extensions;        /* "pdf,txt" or NULL for any */
+    const char* under;             /* only files below this directory, NULL for anywhere */
+    int64_t modified_since;        /* unix seconds, 0 = no bound */
+    int64_t modified_before;       /* unix seconds (exclusive), 0 = no bound */
+    int coarse;                    /* rank on the PCA-reduced vectors first */
+} cortex_search_options;
+
+typedef struct cortex_hit{
+    float score;
+    const char* path;              /* point into the caller's text buffer */
+    const char* name;
+    const char* extension;
+} cortex_hit;
+
+typedef struct cortex_stats{
+    size_t struct_size;
+    uint64_t files;                /* vectors in the warm index */
+    uint32_t dimension;
+    uint64_t searches;             /* served by this handle */
+    uint64_t indexed;              /* files inserted/updated through this handle */
+    double uptime_s;
+} cortex_stats;
+
+CORTEX_API int cortex_abi_version(void);
+CORTEX_API const char* cortex_status_string(cortex_status status);
+/* message of the last failed call on this thread; "" when there is none */
+CORTEX_API const char* cortex_last_error(void);
+
+CORTEX_API void cortex_default_options(cortex_options* options);
+CORTEX_API void cortex_default_search_options(cortex_search_options* options);
+
+/* opens the database, loads its vectors and warms the model; options may be NULL */
+CORTEX_API cortex_status cortex_open(const cortex_options* options, cortex_index** out);
+/* frees the handle; no other thread may still be using it */
+CORTEX_API void cortex_close(cortex_index* index);
+
+/* best max_hits files for query. Their strings are packed into text (text_size bytes)
+   and the hits point into it; *hit_count gets the number written. options may be NULL */
+CORTEX_API cortex_status cortex_search(cortex_index* index, const char* query,
+                                       const cortex_search_options* options,
+                                       cortex_hit* hits, size_t max_hits,
+                                       char* text, size_t text_size, size_t* hit_count);
+
+/* indexes new and changed files under directory and makes them searchable; searches keep
+   running meanwhile. resume continues an interrupted run. indexed may be NULL */
+CORTEX_API cortex_status cortex_index_directory(cortex_index* index, const char* directory,
+                                                int resume, uint64_t* indexed);
+
+/* set stats->struct_size = sizeof(cortex_stats) first; only that much is written */
+CORTEX_API cortex_status cortex_get_stats(cortex_index* index, cortex_stats* stats);
+/* the per-stage metrics as JSON (same shape as the daemon's "metrics"); *needed gets the
+   size including the terminating 0, so a NULL/short buffer can be used to size it */
+CORTEX_API cortex_status cortex_stats_json(cortex_index* index, char* buffer, size_t size, size_t* needed);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
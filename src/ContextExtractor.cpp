@@ -1,4 +1,5 @@
 #include "ContextExtractor.hpp"
+#include "Metrics.hpp"
 //Include fstream and sstream handles file inputs and output
 //fstream handles files and sstream handles string inputs
 
@@ -6,74 +7,356 @@
 #include <sstream>
 #include <filesystem>
 #include <cstdlib>  // for system()
+#include <cstdio>
+#include <cctype>
 #include <iostream>
+#include <algorithm>
+#include <charconv>
+#include <chrono>
+#include <limits>
+#include <thread>
+#include <vector>
+
+using Clock = std::chrono::steady_clock;
+
+static const int kAnalysisSide = 1200;       // long side of the triage copy
+static const float kOcrGlyphHeight = 32.0f;  // glyph height tesseract reads best, ~10pt at 300 DPI
+
+// cuts text to at most max bytes without leaving half a UTF-8 sequence at the end
+static void trimToBudget(std::string& text, size_t max){
+    if (text.size() <= max) return;
+    size_t cut = max;
+    while (cut > 0 && (static_cast<unsigned char>(text[cut]) & 0xC0) == 0x80) --cut;
+    text.resize(cut);
+}
+
+bool ExtractionBudget::parse(const std::string& spec){
+    unsigned long long n = 0;
+    const char* end = spec.data() + spec.size();
+    auto [rest, ec] = std::from_chars(spec.data(), end, n);
+    if (ec != std::errc()) return false;    // no digits, or more than fit in 64 bits
+    std::string unit(rest, end);
+    for (auto& c : unit) c = static_cast<char>(std::tolower(static_cast<unsigned char>(c)));
+    if (n == 0) return false;
+
+    if (unit == "p" || unit == "pages") {
+        if (n > static_cast<unsigned long long>(std::numeric_limits<int>::max())) return false;
+        maxPages = static_cast<int>(n);
+        return true;
+    }
+    unsigned long long scale = 0;
+    if (unit.empty() || unit == "b")          scale = 1;
+    else if (unit == "k" || unit == "kb")     scale = 1024;
+    else if (unit == "m" || unit == "mb")     scale = 1024 * 1024;
+    else if (unit == "t" || unit == "tokens") scale = kBytesPerToken;
+    else return false;
+    // checked before multiplying: "99999999999m" must not wrap to a small budget
+    if (n > std::numeric_limits<size_t>::max() / scale) return false;
+    maxBytes = static_cast<size_t>(n * scale);
+    return true;
+}
+
+ContextExtractor::ContextExtractor(const ExtractionBudget& budget) : budget_(budget) {
+    setOcrConcurrency(static_cast<int>(std::thread::hardware_concurrency() / 4));
+}
+
+void ContextExtractor::setOcrConcurrency(int jobs){
+    ocrSlots_ = std::make_unique<TaskScheduler>(std::max(1, jobs));
+}
+
+OcrStats ContextExtractor::ocrStats() const{
+    std::lock_guard<std::mutex> lock(statsMutex_);
+    OcrStats out = stats_;
+    if (ocrPixels_ > 0) out.savedSeconds = skippedPixels_ * (ratedOcrSeconds_ / ocrPixels_);
+    return out;
+}
 
 
 std::string ContextExtractor::extractText(const std::string& filePath){
+    STAGE_TIMER("extract");
+    static Counter& inputBytes = Metrics::instance().counter("extract.input_bytes");
+    static Counter& textBytes  = Metrics::instance().counter("extract.text_bytes");
+    static Counter& truncated  = Metrics::instance().counter("extract.truncated");
+
     std::string extension = std::filesystem::path(filePath).extension().string();
+    std::error_code ec;
+    auto size = std::filesystem::file_size(filePath, ec);
+    if (!ec) inputBytes.add(size);
 
+    std::string text;
     if(extension == ".txt"){
-        return extractTxtFile(filePath);
+        text = extractTxtFile(filePath);
     }else if(extension == ".pdf"){
-        return extractPDFFile(filePath);
-    }else if(extension == ".jpg" || extension ==".png" || extension == "jpeg"){
-        return extractImageFile(filePath);
+        text = extractPDFFile(filePath);
+    }else if(extension == ".jpg" || extension ==".png" || extension == ".jpeg"){
+        text = extractImageFile(filePath);
     }
-    return "";
+    if (text.size() > budget_.maxBytes) truncated.add();
+    trimToBudget(text, budget_.maxBytes);
+    textBytes.add(text.size());
+    return text;
 }
 
 std::string ContextExtractor::extractTxtFile(const std::string& filePath){
-    std::ifstream file(filePath);
+    std::ifstream file(filePath, std::ios::binary);
 
     if(!file.is_open()){
         return "";
     }
 
-    std::stringstream context;
-    context << file.rdbuf();
-    return context.str();
+    //only the prefix the budget allows (+1 byte so extractText can tell it was cut)
+    std::string context(budget_.maxBytes + 1, '\0');
+    file.read(&context[0], static_cast<std::streamsize>(context.size()));
+    context.resize(static_cast<size_t>(file.gcount()));
+    return context;
+}
+
+// single quotes: the shell expands nothing inside them, so a file named "a$(cmd).png"
+// or "a`cmd`.pdf" stays a file name
+static std::string shellQuote(const std::string& s){
+    std::string out = "'";
+    for (char c : s) {
+        if (c == '\'') out += "'\\''";
+        else out += c;
+    }
+    return out + "'";
 }
 
 std::string ContextExtractor::extractPDFFile(const std::string& filePath){
     //deal with extracting the pdf file into plain text
-    //running the command to convert to pdf to straight text to extract meaning
-    std::string command = "pdftotext \"" + filePath + "\" -";
-    std::string result;
-    char buffer[128];
+    //running the command to convert to pdf to straight text to extract meaning;
+    //-f/-l keep pdftotext from rendering pages past the budget at all
+    std::string command = "pdftotext -q -f 1 -l " + std::to_string(budget_.maxPages) +
+                          " " + shellQuote(filePath) + " -";
+    return readCommand(command, budget_.maxBytes);
+}
 
-    //reading the pdf file
-    FILE* pipe = popen(command.c_str(), "r");
-    if(!pipe) return "";
+// "magick" (ImageMagick 7), "convert" (6), or "" when neither is installed; probed once
+static const std::string& imageTool(){
+    static const std::string tool = [] {
+        for (const char* candidate : {"magick", "convert"}) {
+            std::string probe = std::string("command -v ") + candidate + " >/dev/null 2>&1";
+            if (std::system(probe.c_str()) == 0) return std::string(candidate);
+        }
+        std::cerr << "ImageMagick not found, images are OCR'd without triage\n";
+        return std::string();
+    }();
+    return tool;
+}
 
+// "<w> <h>\n" (the original size, from -print) followed by a binary 8-bit PGM
+static bool parseTriageImage(const std::string& data, std::vector<unsigned char>& gray,
+                             int& width, int& height, int& originalWidth, int& originalHeight){
+    std::istringstream in(data);
+    std::string magic;
+    int maxValue = 0;
+    if (!(in >> originalWidth >> originalHeight >> magic >> width >> height >> maxValue)) return false;
+    if (magic != "P5" || maxValue != 255 || width <= 0 || height <= 0 || originalWidth <= 0) return false;
+    in.get();   // the single whitespace before the pixels
+    const size_t offset = static_cast<size_t>(in.tellg());
+    const size_t pixels = static_cast<size_t>(width) * static_cast<size_t>(height);
+    if (data.size() < offset + pixels) return false;
+    gray.assign(data.begin() + static_cast<long>(offset), data.begin() + static_cast<long>(offset + pixels));
+    return true;
+}
 
-    //reading in the file by the buffer size till we get to the end of the file
-    while(fgets(buffer, sizeof(buffer), pipe)!= nullptr){
-        result +=buffer;
-    }
+std::string ContextExtractor::extractImageFile(const std::string& filePath){
+    static Counter& images  = Metrics::instance().counter("ocr.images");
+    static Counter& skipped = Metrics::instance().counter("ocr.skipped");
 
-    pclose(pipe);
+    //decoding and tesseract both fan out over cores; the stage has its own limit
+    TaskScheduler::Slot slot = ocrSlots_->acquire(TaskScheduler::Priority::Background);
 
-    return result;
+    const std::string tool = ocrTriage ? imageTool() : std::string();
+    std::string command = "tesseract " + shellQuote(filePath) + " stdout 2>/dev/null";
+    double pixels = 0;
+
+    if (!tool.empty()) {
+        auto started = Clock::now();
+        std::vector<unsigned char> gray;
+        int width = 0, height = 0, originalWidth = 0, originalHeight = 0;
+        TextLikelihood text;
+        bool decoded = false;
+        {
+            STAGE_TIMER("extract.ocr_triage");
+            const std::string side = std::to_string(kAnalysisSide);
+            std::string decode = tool + " " + shellQuote(filePath + "[0]") + " -auto-orient -print \"%w %h\\n\" -colorspace Gray"
+                                 " -resize \"" + side + "x" + side + ">\" -depth 8 pgm:- 2>/dev/null";
+            decoded = parseTriageImage(readCommand(decode, static_cast<size_t>(kAnalysisSide) * kAnalysisSide + 256),
+                                       gray, width, height, originalWidth, originalHeight);
+            if (decoded) text = measureText(gray.data(), width, height);
+        }
+        const double triageSeconds = std::chrono::duration<double>(Clock::now() - started).count();
 
+        if (decoded) {
+            pixels = static_cast<double>(originalWidth) * originalHeight;
+            if (!text.likely()) {
+                skipped.add();
+                std::lock_guard<std::mutex> lock(statsMutex_);
+                ++stats_.skipped;
+                stats_.triageSeconds += triageSeconds;
+                skippedPixels_ += pixels;
+                return "";
+            }
+            //glyphs far bigger than tesseract needs (big scans, retina screenshots): shrink first
+            const float glyph = text.glyphHeight * static_cast<float>(originalWidth) / static_cast<float>(width);
+            if (glyph > 2.0f * kOcrGlyphHeight) {
+                const int percent = std::max(1, static_cast<int>(100.0f * kOcrGlyphHeight / glyph));
+                command = tool + " " + shellQuote(filePath + "[0]") + " -auto-orient -colorspace Gray -resize " +
+                          std::to_string(percent) + "% png:- 2>/dev/null | tesseract stdin stdout 2>/dev/null";
+                pixels *= (percent / 100.0) * (percent / 100.0);
+            }
+        }
+        std::lock_guard<std::mutex> lock(statsMutex_);
+        stats_.triageSeconds += triageSeconds;
+    }
+
+    images.add();
+    auto started = Clock::now();
+    std::string text;
+    {
+        STAGE_TIMER("extract.ocr");
+        text = readCommand(command, budget_.maxBytes);
+    }
+    const double seconds = std::chrono::duration<double>(Clock::now() - started).count();
+
+    std::lock_guard<std::mutex> lock(statsMutex_);
+    ++stats_.ocred;
+    stats_.ocrSeconds += seconds;
+    if (pixels > 0) {
+        ocrPixels_ += pixels;
+        ratedOcrSeconds_ += seconds;
+    }
+    return text;
 }
 
-std::string ContextExtractor::extractImageFile(const std::string& filePath){
+TextLikelihood ContextExtractor::measureText(const unsigned char* gray, int width, int height){
+    TextLikelihood best;
+    if (!gray || width < 8 || height < 8) return best;
+    const size_t w = static_cast<size_t>(width), h = static_cast<size_t>(height), n = w * h;
 
-    std::string command = "tesseract \"" + filePath +"\" stdout";
+    //local mean over a 15x15 box from an integral image; ink is whatever stands out of it
+    std::vector<uint32_t> integral((w + 1) * (h + 1), 0);
+    for (size_t y = 0; y < h; ++y) {
+        uint32_t row = 0;
+        for (size_t x = 0; x < w; ++x) {
+            row += gray[y * w + x];
+            integral[(y + 1) * (w + 1) + x + 1] = integral[y * (w + 1) + x + 1] + row;
+        }
+    }
+    const int radius = 7, contrast = 24;
+    std::vector<int> localMean(n);
+    for (size_t y = 0; y < h; ++y) {
+        const size_t y0 = y > static_cast<size_t>(radius) ? y - radius : 0, y1 = std::min(h, y + radius + 1);
+        for (size_t x = 0; x < w; ++x) {
+            const size_t x0 = x > static_cast<size_t>(radius) ? x - radius : 0, x1 = std::min(w, x + radius + 1);
+            const uint32_t sum = integral[y1 * (w + 1) + x1] - integral[y0 * (w + 1) + x1] -
+                                 integral[y1 * (w + 1) + x0] + integral[y0 * (w + 1) + x0];
+            localMean[y * w + x] = static_cast<int>(sum / ((y1 - y0) * (x1 - x0)));
+        }
+    }
 
-    std::string result;
+    struct Box{ int x0, y0, x1, y1; bool aligned; };
+    std::vector<unsigned char> ink(n);
+    std::vector<size_t> stack;
 
-    char buffer[128];
+    //dark text on light, then light on dark; the better reading wins
+    for (int polarity : {-1, 1}) {
+        for (size_t i = 0; i < n; ++i)
+            ink[i] = polarity * (static_cast<int>(gray[i]) - localMean[i]) > contrast;
 
-    FILE* pipe = popen(command.c_str(), "r");
-    if(!pipe) return "";
+        //8-connected components, kept when they are glyph (or short word) shaped
+        std::vector<Box> glyphs;
+        for (size_t start = 0; start < n; ++start) {
+            if (!ink[start]) continue;
+            ink[start] = 0;
+            stack.assign(1, start);
+            int x0 = width, y0 = height, x1 = -1, y1 = -1;
+            size_t count = 0;
+            while (!stack.empty()) {
+                const size_t p = stack.back();
+                stack.pop_back();
+                ++count;
+                const int px = static_cast<int>(p % w), py = static_cast<int>(p / w);
+                x0 = std::min(x0, px); x1 = std::max(x1, px);
+                y0 = std::min(y0, py); y1 = std::max(y1, py);
+                for (int dy = -1; dy <= 1; ++dy)
+                    for (int dx = -1; dx <= 1; ++dx) {
+                        const int nx = px + dx, ny = py + dy;
+                        if (nx < 0 || ny < 0 || nx >= width || ny >= height) continue;
+                        const size_t q = static_cast<size_t>(ny) * w + static_cast<size_t>(nx);
+                        if (ink[q]) { ink[q] = 0; stack.push_back(q); }
+                    }
+            }
+            const int bw = x1 - x0 + 1, bh = y1 - y0 + 1;
+            const double fill = static_cast<double>(count) / (static_cast<double>(bw) * bh);
+            if (bh >= 4 && bh <= 100 && bw <= 20 * bh && bw < width / 2 && fill >= 0.08)
+                glyphs.push_back({x0, y0, x1, y1, false});
+        }
 
+        //next glyph to the right on the same line: similar size, close by, sharing a baseline
+        //or top line. Chance neighbours in textures are common, runs of three are not
+        std::sort(glyphs.begin(), glyphs.end(), [](const Box& a, const Box& b) { return a.x0 < b.x0; });
+        std::vector<int> right(glyphs.size(), -1), left(glyphs.size(), -1);
+        for (size_t i = 0; i < glyphs.size(); ++i) {
+            const Box& a = glyphs[i];
+            const int ah = a.y1 - a.y0 + 1;
+            for (size_t j = i + 1; j < glyphs.size() && glyphs[j].x0 <= a.x1 + 2 * ah; ++j) {
+                const Box& b = glyphs[j];
+                const int bh = b.y1 - b.y0 + 1;
+                const int slack = std::max(1, std::max(ah, bh) / 5);
+                if (2 * bh < ah || 2 * ah < bh) continue;
+                if (std::abs(a.y1 - b.y1) > slack && std::abs(a.y0 - b.y0) > slack) continue;
+                if (b.x0 < a.x1 - ah / 5) continue;   //overlapping, not next to each other
+                if (left[j] >= 0) continue;
+                right[i] = static_cast<int>(j);
+                left[j] = static_cast<int>(i);
+                break;
+            }
+        }
+        for (size_t i = 0; i < glyphs.size(); ++i) {
+            const int l = left[i], r = right[i];
+            glyphs[i].aligned = (l >= 0 && r >= 0) || (r >= 0 && right[r] >= 0) || (l >= 0 && left[l] >= 0);
+        }
 
-    //reading in the file by the buffer size till we get to the end of the file
-    while(fgets(buffer, sizeof(buffer), pipe)!= nullptr){
-        result +=buffer;
+        TextLikelihood found;
+        found.candidates = static_cast<int>(glyphs.size());
+        for (size_t i = 0; i < glyphs.size(); ++i) {
+            if (left[i] >= 0) continue;
+            int length = 1;
+            for (int r = right[i]; r >= 0; r = right[r]) ++length;
+            if (length >= 8) ++found.runs;
+        }
+        std::vector<int> heights;
+        for (const auto& g : glyphs)
+            if (g.aligned) heights.push_back(g.y1 - g.y0 + 1);
+        found.aligned = static_cast<int>(heights.size());
+        if (!heights.empty()) {
+            std::nth_element(heights.begin(), heights.begin() + static_cast<long>(heights.size() / 2), heights.end());
+            found.glyphHeight = static_cast<float>(heights[heights.size() / 2]);
+        }
+        if (found.aligned > best.aligned) best = found;
+    }
+    return best;
+}
+
+std::string ContextExtractor::readCommand(const std::string& command, size_t limit){
+    // the prefix has to cover every stage of a pipeline, so the whole line goes through sh
+    const std::string line = commandPrefix.empty() ? command : commandPrefix + "/bin/sh -c " + shellQuote(command);
+    FILE* pipe = popen(line.c_str(), "r");
+    if(!pipe) return "";
+
+    //reading in chunks until the end of the output or the budget (+1 byte to flag a cut);
+    //closing the pipe early ends the child on its next write
+    std::string result;
+    std::vector<char> buffer(16 * 1024);
+    while(result.size() <= limit){
+        size_t want = std::min(buffer.size(), limit + 1 - result.size());
+        size_t got = fread(buffer.data(), 1, want, pipe);
+        if (got == 0) break;
+        result.append(buffer.data(), got);
     }
 
     pclose(pipe);
     return result;
-}
\ No newline at end of file
+}
@@ -0,0 +1,301 @@
+/*C API (include/cortex.h)
+--cortex_index bundles what the daemon keeps warm: db, embedder (behind a batcher),
+  extractor, VectorIndex and a scheduler so searches go ahead of indexing
+--searches never touch sqlite, they read the VectorIndex under its own shared lock;
+  indexing and the reload after it hold dbMutex
+--no exception crosses the C boundary: every entry point catches and reports
+  CORTEX_ERR_INTERNAL with the message in cortex_last_error()*/
+
+#include "cortex.h"
+#include "DatabaseManager.hpp"
+#include "ContextExtractor.hpp"
+#include "EmbeddingBatcher.hpp"
+#include "EmbeddingEngine.hpp"
+#include "FakeEmbedder.hpp"
+#include "Indexer.hpp"
+#include "Metrics.hpp"
+#include "PcaProjection.hpp"
+#include "SearchEngine.hpp"
+#include "TaskScheduler.hpp"
+#include "VectorIndex.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstring>
+#include <exception>
+#include <filesystem>
+#include <memory>
+#include <mutex>
+#include <sstream>
+#include <string>
+
+struct cortex_index{
+    std::unique_ptr<DatabaseManager> db;
+    std::unique_ptr<Embedder> embedder;
+    std::unique_ptr<EmbeddingBatcher> batcher;   //declared after embedder: destroyed first
+    ContextExtractor extractor;
+    VectorIndex index;
+    std::unique_ptr<TaskScheduler> scheduler;
+    std::mutex dbMutex;
+
+    std::atomic<uint64_t> searches{0};
+    std::atomic<uint64_t> indexed{0};
+    std::chrono::steady_clock::time_point opened = std::chrono::steady_clock::now();
+
+    Embedder& queryEmbedder() { return batcher ? static_cast<Embedder&>(*batcher) : *embedder; }
+};
+
+static thread_local std::string g_lastError;
+
+static cortex_status fail(cortex_status status, const std::string& message){
+    g_lastError = message;
+    return status;
+}
+
+// runs f and turns anything it throws into CORTEX_ERR_INTERNAL
+template <typename F>
+static cortex_status guarded(F&& f){
+    g_lastError.clear();
+    try {
+        return f();
+    } catch (const std::exception& e) {
+        return fail(CORTEX_ERR_INTERNAL, e.what());
+    } catch (...) {
+        return fail(CORTEX_ERR_INTERNAL, "unknown exception");
+    }
+}
+
+// options from a caller built against an older header are shorter: the fields it
+// doesn't know keep their defaults
+template <typename T>
+static T upgrade(const T* given, T defaults){
+    if (given && given->struct_size > 0)
+        std::memcpy(&defaults, given, std::min(given->struct_size, sizeof(T)));
+    defaults.struct_size = sizeof(T);
+    return defaults;
+}
+
+static std::string orDefault(const char* s, const char* fallback){
+    return (s && *s) ? s : fallback;
+}
+
+extern "C" {
+
+int cortex_abi_version(void){
+    return CORTEX_ABI_VERSION;
+}
+
+const char* cortex_status_string(cortex_status status){
+    switch (status) {
+        case CORTEX_OK:           return "ok";
+        case CORTEX_ERR_ARGUMENT: return "invalid argument";
+        case CORTEX_ERR_OPEN:     return "could not open index or model";
+        case CORTEX_ERR_EMBED:    return "could not embed query";
+        case CORTEX_ERR_BUFFER:   return "buffer too small";
+        case CORTEX_ERR_INTERNAL: return "internal error";
+    }
+    return "unknown status";
+}
+
+const char* cortex_last_error(void){
+    return g_lastError.c_str();
+}
+
+void cortex_default_options(cortex_options* options){
+    if (!options) return;
+    *options = cortex_options{};
+    options->struct_size      = sizeof(cortex_options);
+    options->db_path          = "cortex.db";
+    options->model_path       = "models/model.onnx";
+    options->python_exe       = "./.venv/bin/python";
+    options->tokenizer_script = "tools/tokenize.py";
+    options->tokenizer_json   = "models/tokenizer.json";
+    options->threads          = 4;
+    options->max_batch        = 16;
+    options->batch_window_us  = 2000;
+}
+
+void cortex_default_search_options(cortex_search_options* options){
+    if (!options) return;
+    *options = cortex_search_options{};
+    options->struct_size = sizeof(cortex_search_options);
+}
+
+cortex_status cortex_open(const cortex_options* given, cortex_index** out){
+    if (!out) return fail(CORTEX_ERR_ARGUMENT, "out is NULL");
+    *out = nullptr;
+    return guarded([&] {
+        cortex_options defaults;
+        cortex_default_options(&defaults);
+        const cortex_options options = upgrade(given, defaults);
+
+        auto handle = std::make_unique<cortex_index>();
+        handle->db = std::make_unique<DatabaseManager>(orDefault(options.db_path, "cortex.db"));
+
+        if (options.fake_embedder) {
+            handle->embedder = std::make_unique<FakeEmbedder>();
+        } else {
+            // same rule as the CLI: default to the variant the index was built with
+            const std::string variant = options.model_variant && *options.model_variant
+                ? options.model_variant : handle->db->getMetadata("model_variant", "fp32");
+            if (!EmbeddingEngine::isKnownVariant(variant))
+                return fail(CORTEX_ERR_ARGUMENT, "unknown model variant: " + variant);
+            auto engine = std::make_unique<EmbeddingEngine>(
+                orDefault(options.model_path, "models/model.onnx"),
+                orDefault(options.python_exe, "./.venv/bin/python"),
+                orDefault(options.tokenizer_script, "tools/tokenize.py"),
+                orDefault(options.tokenizer_json, "models/tokenizer.json"),
+                256, variant);
+            if (!handle->db->useModelVariant(variant, engine->modelName(), engine->modelDimension()))
+                return fail(CORTEX_ERR_OPEN, "index was built with another model variant than " + variant);
+            handle->embedder = std::move(engine);
+        }
+        if (!handle->embedder->warmUp())
+            return fail(CORTEX_ERR_OPEN, "could not load the embedding model");
+        if (options.max_batch > 1) {
+            BatcherConfig batching;
+            batching.maxBatch  = static_cast<size_t>(options.max_batch);
+            batching.maxWindow = std::chrono::microseconds(std::max(0, options.batch_window_us));
+            handle->batcher = std::make_unique<EmbeddingBatcher>(*handle->embedder, batching);
+        }
+        handle->scheduler = std::make_unique<TaskScheduler>(std::max(1, options.threads));
+
+        handle->index.load(*handle->db);
+        // a stored projection makes coarse search available; training it is left to the CLI/daemon
+        if (auto pca = PcaProjection::load(*handle->db)) handle->index.setProjection(pca);
+
+        *out = handle.release();
+        return CORTEX_OK;
+    });
+}
+
+void cortex_close(cortex_index* index){
+    delete index;
+}
+
+cortex_status cortex_search(cortex_index* index, const char* query, const cortex_search_options* given,
+                            cortex_hit* hits, size_t max_hits, char* text, size_t text_size, size_t* hit_count){
+    if (hit_count) *hit_count = 0;
+    if (!index || !query || !hit_count || (max_hits > 0 && (!hits || !text)))
+        return fail(CORTEX_ERR_ARGUMENT, "index, query, hits, text and hit_count are required");
+    return guarded([&] {
+        cortex_search_options defaults;
+        cortex_default_search_options(&defaults);
+        const cortex_search_options options = upgrade(given, defaults);
+
+        SearchOptions search;
+        search.topK   = static_cast<int>(std::min<size_t>(max_hits, 1u << 20));
+        search.coarse = options.coarse != 0;
+        if (options.extensions) {
+            // comma separated, with or without the leading dot (like --ext)
+            std::stringstream list(options.extensions);
+            std::string ext;
+            while (std::getline(list, ext, ',')) {
+                if (ext.empty()) continue;
+                if (ext[0] != '.') ext = "." + ext;
+                search.filter.extensions.push_back(ext);
+            }
+        }
+        if (options.under && *options.under)
+            search.filter.underPath = std::filesystem::absolute(options.under).lexically_normal().string();
+        search.filter.modifiedSince  = options.modified_since;
+        search.filter.modifiedBefore = options.modified_before;
+        if (search.topK == 0) return CORTEX_OK;
+
+        // the slot covers the query embed too, so it goes ahead of background indexing embeds
+        // (same as SearchEngine::search)
+        std::vector<SearchResult> results;
+        {
+            TaskScheduler::Slot slot = index->scheduler->acquire(TaskScheduler::Priority::Interactive);
+            std::vector<float> embedded = index->queryEmbedder().createEmbedding(query);
+            if (embedded.empty()) return fail(CORTEX_ERR_EMBED, "embedding the query failed");
+            results = index->index.search(embedded, search);
+        }
+        index->searches.fetch_add(1, std::memory_order_relaxed);
+
+        // pack path, name, extension of each hit; stop at the first one that doesn't fit
+        size_t used = 0;
+        auto put = [&](const std::string& s) -> const char* {
+            if (used + s.size() + 1 > text_size) return nullptr;
+            char* at = text + used;
+            std::memcpy(at, s.c_str(), s.size() + 1);
+            used += s.size() + 1;
+            return at;
+        };
+        for (const auto& r : results) {
+            const size_t mark = used;
+            cortex_hit hit;
+            hit.score     = r.score;
+            hit.path      = put(r.path);
+            hit.name      = hit.path ? put(r.name) : nullptr;
+            hit.extension = hit.name ? put(r.extension) : nullptr;
+            if (!hit.extension) {
+                used = mark;
+                return fail(CORTEX_ERR_BUFFER, "text buffer holds " + std::to_string(*hit_count) +
+                                               " of " + std::to_string(results.size()) + " hits");
+            }
+            hits[(*hit_count)++] = hit;
+        }
+        return CORTEX_OK;
+    });
+}
+
+cortex_status cortex_index_directory(cortex_index* index, const char* directory, int resume, uint64_t* indexed){
+    if (indexed) *indexed = 0;
+    if (!index || !directory || !*directory) return fail(CORTEX_ERR_ARGUMENT, "index and directory are required");
+    return guarded([&] {
+        const std::string path = std::filesystem::absolute(directory).lexically_normal().string();
+        int count = 0;
+        {
+            // embedding and inserts take Background slots, so searches on other threads go first
+            // and extraction runs under the default governor limits, at low priority
+            std::lock_guard<std::mutex> lock(index->dbMutex);
+            IndexGovernor governor;
+            Indexer indexer(*index->db, index->extractor, *index->embedder);
+            indexer.scheduler = index->scheduler.get();
+            indexer.governor = &governor;
+            indexer.resume = resume != 0;
+            count = indexer.indexDirectory(path);
+            if (count > 0) index->index.load(*index->db);   // swapped in under the index lock
+        }
+        index->indexed.fetch_add(static_cast<uint64_t>(count), std::memory_order_relaxed);
+        if (indexed) *indexed = static_cast<uint64_t>(count);
+        return CORTEX_OK;
+    });
+}
+
+cortex_status cortex_get_stats(cortex_index* index, cortex_stats* stats){
+    if (!index || !stats) return fail(CORTEX_ERR_ARGUMENT, "index and stats are required");
+    return guarded([&] {
+        // write no further than the caller's struct reaches
+        cortex_stats s{};
+        s.struct_size = sizeof(cortex_stats);
+        s.files     = index->index.size();
+        s.dimension = static_cast<uint32_t>(index->index.dimension());
+        s.searches  = index->searches.load(std::memory_order_relaxed);
+        s.indexed   = index->indexed.load(std::memory_order_relaxed);
+        s.uptime_s  = std::chrono::duration<double>(std::chrono::steady_clock::now() - index->opened).count();
+        const size_t size = (stats->struct_size > 0) ? std::min(stats->struct_size, sizeof(cortex_stats))
+                                                     : sizeof(cortex_stats);
+        std::memcpy(stats, &s, size);
+        stats->struct_size = size;
+        return CORTEX_OK;
+    });
+}
+
+cortex_status cortex_stats_json(cortex_index* index, char* buffer, size_t size, size_t* needed){
+    if (!index) return fail(CORTEX_ERR_ARGUMENT, "index is required");
+    return guarded([&] {
+        const std::string json = Metrics::instance().toJson().dump();
+        if (needed) *needed = json.size() + 1;
+        if (!buffer || size < json.size() + 1) {
+            if (buffer && size > 0) buffer[0] = '\0';
+            return fail(CORTEX_ERR_BUFFER, "stats need " + std::to_string(json.size() + 1) + " bytes");
+        }
+        std::memcpy(buffer, json.c_str(), json.size() + 1);
+        return CORTEX_OK;
+    });
+}
+
+}
@@ -1,15 +1,20 @@
 // src/DatabaseManager.cpp
 // Creates/initializes the SQLite database and handles inserts/updates and reads.
 // Stores embeddings as a BLOB (float32[384]) in a separate `embeddings` table.
+// Writes go through one connection under writeMutex_; reads lease a read-only
+// connection from a small pool, which in WAL mode reads the last committed
+// snapshot without waiting for the writer.
 
 #include "DatabaseManager.hpp"
+#include "Metrics.hpp"
+#include "NearDuplicate.hpp"
 
 #include <sqlite3.h>
 #include <iostream>
 #include <sstream>
 #include <tuple>
 #include <vector>
-#include <cstring>   // std::memcpy
+#include <cstring>   // std::memcpy, std::strcmp
 #include <cassert>
 
 // ─────────────────────────────────────────────────────────────────────────────
@@ -17,17 +22,36 @@
 // ─────────────────────────────────────────────────────────────────────────────
 
 DatabaseManager::DatabaseManager(const std::string& dbPath)
-    : db(nullptr)
+    : writer_(nullptr), dbPath_(dbPath)
 {
-    if (sqlite3_open(dbPath.c_str(), &db) != SQLITE_OK) {
-        std::cerr << "Failed to open database: " << sqlite3_errmsg(db) << "\n";
-        db = nullptr;
+    if (sqlite3_open(dbPath.c_str(), &writer_) != SQLITE_OK) {
+        std::cerr << "Failed to open database: " << sqlite3_errmsg(writer_) << "\n";
+        sqlite3_close(writer_);
+        writer_ = nullptr;
         return;
     }
+    // another process (CLI next to the daemon) may hold the write lock for a moment
+    sqlite3_busy_timeout(writer_, 5000);
+
+    // WAL lets the read connections keep reading the last commit while a batch is
+    // being written. In-memory/temp databases can't do WAL: everything then goes
+    // through the writer connection.
+    {
+        sqlite3_stmt* st = nullptr;
+        if (sqlite3_prepare_v2(writer_, "PRAGMA journal_mode=WAL;", -1, &st, nullptr) == SQLITE_OK) {
+            if (sqlite3_step(st) == SQLITE_ROW) {
+                const unsigned char* mode = sqlite3_column_text(st, 0);
+                wal_ = mode && std::strcmp(reinterpret_cast<const char*>(mode), "wal") == 0;
+            }
+            sqlite3_finalize(st);
+        }
+    }
+    // in WAL, NORMAL only risks the last commits on power loss, never corruption
+    if (wal_) sqlite3_exec(writer_, "PRAGMA synchronous=NORMAL;", nullptr, nullptr, nullptr);
 
     // Ensure foreign keys are enforced (needed for ON DELETE CASCADE)
     char* err = nullptr;
-    if (sqlite3_exec(db, "PRAGMA foreign_keys = ON;", nullptr, nullptr, &err) != SQLITE_OK) {
+    if (sqlite3_exec(writer_, "PRAGMA foreign_keys = ON;", nullptr, nullptr, &err) != SQLITE_OK) {
         std::cerr << "Failed to enable foreign keys: " << (err ? err : "unknown") << "\n";
         sqlite3_free(err);
     }
@@ -36,12 +60,93 @@ DatabaseManager::DatabaseManager(const std::string& dbPath)
 }
 
 DatabaseManager::~DatabaseManager() {
-    if (db) {
-        sqlite3_close(db);
-        db = nullptr;
+    // every lease has been returned by now: nothing may use the manager while it's destroyed
+    for (sqlite3* reader : idleReaders_) sqlite3_close(reader);
+    idleReaders_.clear();
+    if (writer_) {
+        sqlite3_close(writer_);
+        writer_ = nullptr;
     }
 }
 
+// ─────────────────────────────────────────────────────────────────────────────
+// Connections
+// - A write holds writeMutex_ (recursive: insertFile calls the read helpers, and a
+//   batch holds it from beginBatch to commitBatch/rollbackBatch).
+// - A read on the thread that holds it uses the writer, so it sees the batch's own
+//   uncommitted rows; any other read leases a read-only connection.
+// - Readers are opened on demand up to kMaxReaders, then a read waits for one.
+// ─────────────────────────────────────────────────────────────────────────────
+
+void DatabaseManager::lockWriter() {
+    writeMutex_.lock();
+    if (writeDepth_++ == 0) writerThread_.store(std::this_thread::get_id());
+}
+
+void DatabaseManager::unlockWriter() {
+    if (--writeDepth_ == 0) writerThread_.store(std::thread::id());
+    writeMutex_.unlock();
+}
+
+bool DatabaseManager::holdsWriter() const {
+    return writerThread_.load() == std::this_thread::get_id();
+}
+
+sqlite3* DatabaseManager::acquireReader() {
+    std::unique_lock<std::mutex> lock(readersMutex_);
+    for (;;) {
+        if (!idleReaders_.empty()) {
+            sqlite3* reader = idleReaders_.back();
+            idleReaders_.pop_back();
+            return reader;
+        }
+        if (openReaders_ < kMaxReaders) break;
+        readerFreed_.wait(lock);
+    }
+    ++openReaders_;
+    lock.unlock();
+
+    sqlite3* reader = nullptr;
+    if (sqlite3_open_v2(dbPath_.c_str(), &reader, SQLITE_OPEN_READONLY | SQLITE_OPEN_NOMUTEX, nullptr) != SQLITE_OK) {
+        std::cerr << "Failed to open read connection: " << sqlite3_errmsg(reader) << "\n";
+        sqlite3_close(reader);
+        lock.lock();
+        --openReaders_;
+        readerFreed_.notify_one();
+        return nullptr;
+    }
+    sqlite3_busy_timeout(reader, 5000);
+    return reader;
+}
+
+void DatabaseManager::releaseReader(sqlite3* reader) {
+    {
+        std::lock_guard<std::mutex> lock(readersMutex_);
+        idleReaders_.push_back(reader);
+    }
+    readerFreed_.notify_one();
+}
+
+DatabaseManager::Connection::Connection(DatabaseManager& owner, Access access)
+    : owner_(owner)
+{
+    if (access == Read && owner_.wal_ && !owner_.holdsWriter()) {
+        handle_ = owner_.acquireReader();
+        if (handle_) {
+            reader_ = true;
+            return;
+        }
+    }
+    // writes, reads inside this thread's batch, and the no-WAL fallback
+    owner_.lockWriter();
+    handle_ = owner_.writer_;
+}
+
+DatabaseManager::Connection::~Connection() {
+    if (reader_) owner_.releaseReader(handle_);
+    else owner_.unlockWriter();
+}
+
 // ─────────────────────────────────────────────────────────────────────────────
 // Schema init (idempotent)
 // - Keeps your existing `files` table (including legacy `embedding TEXT` column)
@@ -49,6 +154,17 @@ DatabaseManager::~DatabaseManager() {
 // - Records current model configuration
 // ─────────────────────────────────────────────────────────────────────────────
 
+static bool hasColumn(sqlite3* db, const std::string& table, const std::string& column) {
+    sqlite3_stmt* st = nullptr;
+    const std::string sql = "PRAGMA table_info(" + table + ");";
+    bool found = false;
+    if (sqlite3_prepare_v2(db, sql.c_str(), -1, &st, nullptr) != SQLITE_OK) return false;
+    while (!found && sqlite3_step(st) == SQLITE_ROW)
+        found = column == reinterpret_cast<const char*>(sqlite3_column_text(st, 1));
+    sqlite3_finalize(st);
+    return found;
+}
+
 void DatabaseManager::initializeDatabase() {
     char* err = nullptr;
 
@@ -63,19 +179,31 @@ void DatabaseManager::initializeDatabase() {
         "  last_modified INTEGER"
         ");";
 
-    if (sqlite3_exec(db, createFiles, nullptr, nullptr, &err) != SQLITE_OK) {
+    if (sqlite3_exec(writer_, createFiles, nullptr, nullptr, &err) != SQLITE_OK) {
         std::cerr << "Failed to create files: " << err << "\n";
         sqlite3_free(err);
         return;
     }
 
+    // 1b) Near-duplicate signature columns, added in place to files tables from before them
+    for (const char* column : {"simhash INTEGER", "duplicate_of INTEGER REFERENCES files(id) ON DELETE SET NULL"}) {
+        const std::string name(column, std::strchr(column, ' '));
+        if (hasColumn(writer_, "files", name)) continue;
+        const std::string alter = "ALTER TABLE files ADD COLUMN " + std::string(column) + ";";
+        if (sqlite3_exec(writer_, alter.c_str(), nullptr, nullptr, &err) != SQLITE_OK) {
+            std::cerr << "Failed to add files." << name << ": " << err << "\n";
+            sqlite3_free(err);
+            return;
+        }
+    }
+
     // 2) Metadata table (records model info)
     const char* createMeta =
         "CREATE TABLE IF NOT EXISTS metadata ("
         "  key TEXT PRIMARY KEY,"
         "  value TEXT NOT NULL"
         ");";
-    if (sqlite3_exec(db, createMeta, nullptr, nullptr, &err) != SQLITE_OK) {
+    if (sqlite3_exec(writer_, createMeta, nullptr, nullptr, &err) != SQLITE_OK) {
         std::cerr << "Failed to create metadata: " << err << "\n";
         sqlite3_free(err);
         return;
@@ -88,43 +216,258 @@ void DatabaseManager::initializeDatabase() {
         "  vector  BLOB NOT NULL,"
         "  FOREIGN KEY(file_id) REFERENCES files(id) ON DELETE CASCADE"
         ");";
-    if (sqlite3_exec(db, createEmb, nullptr, nullptr, &err) != SQLITE_OK) {
+    if (sqlite3_exec(writer_, createEmb, nullptr, nullptr, &err) != SQLITE_OK) {
         std::cerr << "Failed to create embeddings: " << err << "\n";
         sqlite3_free(err);
         return;
     }
 
-    // 4) Record current model configuration (idempotent)
+    // 4) Indexes on the columns SearchFilter pushes down.
+    //    `path` is already covered by its UNIQUE index (used for prefix ranges).
+    const char* createIdx =
+        "CREATE INDEX IF NOT EXISTS idx_files_extension ON files(extension COLLATE NOCASE);"
+        "CREATE INDEX IF NOT EXISTS idx_files_last_modified ON files(last_modified);"
+        "CREATE INDEX IF NOT EXISTS idx_files_duplicate_of ON files(duplicate_of) WHERE duplicate_of IS NOT NULL;";
+    if (sqlite3_exec(writer_, createIdx, nullptr, nullptr, &err) != SQLITE_OK) {
+        std::cerr << "Failed to create file indexes: " << err << "\n";
+        sqlite3_free(err);
+        return;
+    }
+
+    // 5) Trigram full-text index over name/path for the file browser filter.
+    //    External content (no second copy of the strings), kept in sync by triggers.
+    //    Older sqlite builds without fts5/trigram fall back to LIKE scans.
+    bool ftsExisted = false;
+    {
+        sqlite3_stmt* st = nullptr;
+        if (sqlite3_prepare_v2(writer_, "SELECT 1 FROM sqlite_master WHERE name='files_fts';",
+                               -1, &st, nullptr) == SQLITE_OK) {
+            ftsExisted = (sqlite3_step(st) == SQLITE_ROW);
+            sqlite3_finalize(st);
+        }
+    }
+    const char* createFts =
+        "CREATE VIRTUAL TABLE IF NOT EXISTS files_fts USING fts5("
+        "  name, path, content='files', content_rowid='id', tokenize='trigram');"
+        "CREATE TRIGGER IF NOT EXISTS files_fts_ai AFTER INSERT ON files BEGIN"
+        "  INSERT INTO files_fts(rowid, name, path) VALUES (new.id, new.name, new.path);"
+        "END;"
+        "CREATE TRIGGER IF NOT EXISTS files_fts_ad AFTER DELETE ON files BEGIN"
+        "  INSERT INTO files_fts(files_fts, rowid, name, path) VALUES ('delete', old.id, old.name, old.path);"
+        "END;"
+        "CREATE TRIGGER IF NOT EXISTS files_fts_au AFTER UPDATE OF name, path ON files BEGIN"
+        "  INSERT INTO files_fts(files_fts, rowid, name, path) VALUES ('delete', old.id, old.name, old.path);"
+        "  INSERT INTO files_fts(rowid, name, path) VALUES (new.id, new.name, new.path);"
+        "END;";
+    if (sqlite3_exec(writer_, createFts, nullptr, nullptr, &err) != SQLITE_OK) {
+        std::cerr << "Trigram index unavailable, file filter uses LIKE: " << (err ? err : "unknown") << "\n";
+        sqlite3_free(err);
+        err = nullptr;
+    } else {
+        hasFts_ = true;
+        // index rows that were stored before the table existed
+        if (!ftsExisted &&
+            sqlite3_exec(writer_, "INSERT INTO files_fts(files_fts) VALUES ('rebuild');",
+                         nullptr, nullptr, &err) != SQLITE_OK) {
+            std::cerr << "Failed to build trigram index: " << err << "\n";
+            sqlite3_free(err);
+            err = nullptr;
+        }
+    }
+
+    // 6) Index journal (plan + per-file status of a run) and the quarantine list.
+    //    Lives in the same file so a batch commit covers files and journal together.
+    const char* createJournal =
+        "CREATE TABLE IF NOT EXISTS index_runs ("
+        "  id INTEGER PRIMARY KEY AUTOINCREMENT,"
+        "  root TEXT NOT NULL,"
+        "  started INTEGER NOT NULL,"
+        "  finished INTEGER"
+        ");"
+        "CREATE TABLE IF NOT EXISTS index_journal ("
+        "  run_id INTEGER NOT NULL,"
+        "  seq INTEGER NOT NULL,"
+        "  path TEXT NOT NULL,"
+        "  name TEXT NOT NULL,"
+        "  extension TEXT,"
+        "  done INTEGER NOT NULL DEFAULT 0,"
+        "  attempts INTEGER NOT NULL DEFAULT 0,"
+        "  PRIMARY KEY(run_id, seq)"
+        ");"
+        "CREATE INDEX IF NOT EXISTS idx_journal_path ON index_journal(run_id, path);"
+        "CREATE TABLE IF NOT EXISTS quarantine ("
+        "  path TEXT PRIMARY KEY,"
+        "  last_modified INTEGER NOT NULL,"
+        "  strikes INTEGER NOT NULL,"
+        "  reason TEXT,"
+        "  since INTEGER NOT NULL"
+        ");";
+    if (sqlite3_exec(writer_, createJournal, nullptr, nullptr, &err) != SQLITE_OK) {
+        std::cerr << "Failed to create index journal: " << err << "\n";
+        sqlite3_free(err);
+        return;
+    }
+
+    // 6b) LSH buckets of the group representatives' signatures (four 16-bit bands each)
+    const char* createBuckets =
+        "CREATE TABLE IF NOT EXISTS simhash_buckets ("
+        "  bucket  INTEGER NOT NULL,"
+        "  file_id INTEGER NOT NULL REFERENCES files(id) ON DELETE CASCADE,"
+        "  PRIMARY KEY(bucket, file_id)"
+        ") WITHOUT ROWID;"
+        "CREATE INDEX IF NOT EXISTS idx_simhash_buckets_file ON simhash_buckets(file_id);";
+    if (sqlite3_exec(writer_, createBuckets, nullptr, nullptr, &err) != SQLITE_OK) {
+        std::cerr << "Failed to create simhash buckets: " << err << "\n";
+        sqlite3_free(err);
+        return;
+    }
+
+    // 7) Record the model configuration (idempotent). Only fills missing keys:
+    //    model_variant, model_name and embedding_dim are owned by useModelVariant(),
+    //    which writes them from the embedder in use; a database from before
+    //    variants existed was embedded with fp32.
     const char* upsertMeta =
-        "INSERT OR REPLACE INTO metadata(key, value) VALUES"
+        "INSERT OR IGNORE INTO metadata(key, value) VALUES"
         " ('model_name',   'all-MiniLM-L6-v2-ONNX'),"
+        " ('model_variant','fp32'),"
         " ('embedding_dim','384'),"
         " ('max_seq_len',  '256');";
-    if (sqlite3_exec(db, upsertMeta, nullptr, nullptr, &err) != SQLITE_OK) {
+    if (sqlite3_exec(writer_, upsertMeta, nullptr, nullptr, &err) != SQLITE_OK) {
         std::cerr << "Failed to upsert metadata: " << err << "\n";
         sqlite3_free(err);
         return;
     }
 }
 
+static bool step_done(sqlite3_stmt* st) {
+    int rc = sqlite3_step(st);
+    return (rc == SQLITE_DONE);
+}
+
+// buckets of a group representative (a zero signature, i.e. no text, is never matched)
+static bool insertBuckets(sqlite3* db, long long id, uint64_t simhash) {
+    if (simhash == 0) return true;
+    sqlite3_stmt* st = nullptr;
+    if (sqlite3_prepare_v2(db, "INSERT OR IGNORE INTO simhash_buckets(bucket, file_id) VALUES(?, ?);", -1, &st, nullptr) != SQLITE_OK)
+        return false;
+    bool ok = true;
+    for (int64_t bucket : NearDuplicate::buckets(simhash)) {
+        sqlite3_bind_int64(st, 1, bucket);
+        sqlite3_bind_int64(st, 2, id);
+        ok = step_done(st) && ok;
+        sqlite3_reset(st);
+    }
+    sqlite3_finalize(st);
+    return ok;
+}
+
+// id stops representing its group: the oldest follower takes over (it holds the same
+// vector) and is bucketed from its stored signature, the others point at it
+static bool promoteFollower(sqlite3* db, long long id) {
+    sqlite3_stmt* st = nullptr;
+    if (sqlite3_prepare_v2(db, "SELECT id, simhash FROM files WHERE duplicate_of=? ORDER BY id LIMIT 1;", -1, &st, nullptr) != SQLITE_OK)
+        return false;
+    sqlite3_bind_int64(st, 1, id);
+    long long heir = -1;
+    uint64_t simhash = 0;
+    if (sqlite3_step(st) == SQLITE_ROW) {
+        heir = sqlite3_column_int64(st, 0);
+        simhash = static_cast<uint64_t>(sqlite3_column_int64(st, 1));
+    }
+    sqlite3_finalize(st);
+    if (heir < 0) return true;
+
+    if (sqlite3_prepare_v2(db, "UPDATE files SET duplicate_of=NULLIF(?1, id) WHERE duplicate_of=?2;", -1, &st, nullptr) != SQLITE_OK)
+        return false;
+    sqlite3_bind_int64(st, 1, heir);
+    sqlite3_bind_int64(st, 2, id);
+    const bool ok = step_done(st);
+    sqlite3_finalize(st);
+    return ok && insertBuckets(db, heir, simhash);
+}
+
+// ─────────────────────────────────────────────────────────────────────────────
+// Metadata
+// ─────────────────────────────────────────────────────────────────────────────
+
+std::string DatabaseManager::getMetadata(const std::string& key, const std::string& fallback) {
+    if (!writer_) return fallback;
+    Connection db(*this, Connection::Read);
+    sqlite3_stmt* st = nullptr;
+    if (sqlite3_prepare_v2(db, "SELECT value FROM metadata WHERE key=?;", -1, &st, nullptr) != SQLITE_OK) {
+        std::cerr << "Prepare metadata read failed: " << sqlite3_errmsg(db) << "\n";
+        return fallback;
+    }
+    sqlite3_bind_text(st, 1, key.c_str(), -1, SQLITE_TRANSIENT);
+    std::string value = fallback;
+    if (sqlite3_step(st) == SQLITE_ROW) value = reinterpret_cast<const char*>(sqlite3_column_text(st, 0));
+    sqlite3_finalize(st);
+    return value;
+}
+
+bool DatabaseManager::setMetadata(const std::string& key, const std::string& value) {
+    if (!writer_) return false;
+    Connection db(*this, Connection::Write);
+    sqlite3_stmt* st = nullptr;
+    if (sqlite3_prepare_v2(db, "INSERT OR REPLACE INTO metadata(key, value) VALUES(?, ?);",
+                           -1, &st, nullptr) != SQLITE_OK) {
+        std::cerr << "Prepare metadata write failed: " << sqlite3_errmsg(db) << "\n";
+        return false;
+    }
+    sqlite3_bind_text(st, 1, key.c_str(), -1, SQLITE_TRANSIENT);
+    sqlite3_bind_text(st, 2, value.c_str(), -1, SQLITE_TRANSIENT);
+    bool ok = step_done(st);
+    sqlite3_finalize(st);
+    return ok;
+}
+
+bool DatabaseManager::useModelVariant(const std::string& variant, const std::string& modelName, size_t dimension) {
+    if (!writer_) return false;
+    Connection db(*this, Connection::Write);
+    // name and size follow the variant, so whatever reads the metadata sees the model in use
+    auto record = [&] {
+        bool ok = true;
+        if (!modelName.empty() && getMetadata("model_name") != modelName) ok = setMetadata("model_name", modelName);
+        if (dimension && getMetadata("embedding_dim") != std::to_string(dimension))
+            ok = setMetadata("embedding_dim", std::to_string(dimension)) && ok;
+        return ok;
+    };
+    std::string stored = getMetadata("model_variant", "fp32");
+    if (stored == variant) return record();
+
+    // an empty index can switch freely; one with vectors would mix incompatible spaces
+    bool hasVectors = false;
+    sqlite3_stmt* st = nullptr;
+    if (sqlite3_prepare_v2(db, "SELECT EXISTS(SELECT 1 FROM embeddings);", -1, &st, nullptr) == SQLITE_OK) {
+        hasVectors = (sqlite3_step(st) == SQLITE_ROW && sqlite3_column_int(st, 0) != 0);
+        sqlite3_finalize(st);
+    }
+    if (!hasVectors) return setMetadata("model_variant", variant) && record();
+
+    std::cerr << "This index was embedded with the " << stored << " model; refusing to use it with "
+              << variant << ". Re-index into a new database or run with --model-variant " << stored << ".\n";
+    return false;
+}
+
+bool DatabaseManager::isUpToDate(const std::string& path, long lastModified) {
+    return fileExists(path) && !fileNeedUpdate(path, lastModified);
+}
+
 // ─────────────────────────────────────────────────────────────────────────────
 // Insert / Update
 // - We upsert the `files` row.
 // - We then upsert the `embeddings` row as a BLOB (float32[384]).
 // ─────────────────────────────────────────────────────────────────────────────
 
-static bool step_done(sqlite3_stmt* st) {
-    int rc = sqlite3_step(st);
-    return (rc == SQLITE_DONE);
-}
-
 bool DatabaseManager::insertFile(const std::string& path,
                                  const std::string& name,
                                  const std::string& extension,
                                  const std::vector<float>& embedding,
                                  long lastModified)
 {
-    if (!db) return false;
+    STAGE_TIMER("db.insert");
+    if (!writer_) return false;
+    Connection db(*this, Connection::Write);
 
     // If already present and unchanged → skip
     if (fileExists(path)) {
@@ -205,7 +548,8 @@ void DatabaseManager::updateFile(const std::string& path,
                                  const std::vector<float>& embedding,
                                  long lastModified)
 {
-    if (!db) return;
+    if (!writer_) return;
+    Connection db(*this, Connection::Write);
 
     // 1) Update file row (no TEXT embedding anymore)
     const char* updFile =
@@ -254,7 +598,8 @@ void DatabaseManager::updateFile(const std::string& path,
 // ─────────────────────────────────────────────────────────────────────────────
 
 bool DatabaseManager::fileExists(const std::string& filePath) {
-    if (!db) return false;
+    if (!writer_) return false;
+    Connection db(*this, Connection::Read);
 
     const char* sql = "SELECT COUNT(*) FROM files WHERE path=?;";
     sqlite3_stmt* st=nullptr;
@@ -271,7 +616,8 @@ bool DatabaseManager::fileExists(const std::string& filePath) {
 }
 
 bool DatabaseManager::fileNeedUpdate(const std::string& filePath, long currentModified) {
-    if (!db) return true;
+    if (!writer_) return true;
+    Connection db(*this, Connection::Read);
 
     const char* sql = "SELECT last_modified FROM files WHERE path=?;";
     sqlite3_stmt* st=nullptr;
@@ -288,25 +634,10 @@ bool DatabaseManager::fileNeedUpdate(const std::string& filePath, long currentMo
     return (currentModified > dbModified);
 }
 
-// NOTE: This returns rows with the *embedded vector* loaded from the BLOB table.
-// If you only need metadata, make a lighter query to avoid pulling blobs.
-std::vector<std::tuple<std::string, std::string, std::string, std::vector<float>>>
-DatabaseManager::getAllFiles()
+// Reads (path, name, extension, vector) rows from a prepared statement.
+static void readFileRows(sqlite3_stmt* st,
+    std::vector<std::tuple<std::string, std::string, std::string, std::vector<float>>>& out)
 {
-    std::vector<std::tuple<std::string, std::string, std::string, std::vector<float>>> out;
-    if (!db) return out;
-
-    // Join files with embeddings; LEFT JOIN in case some rows are missing vectors.
-    const char* sql =
-        "SELECT f.path, f.name, f.extension, e.vector "
-        "FROM files f LEFT JOIN embeddings e ON e.file_id = f.id;";
-
-    sqlite3_stmt* st=nullptr;
-    if (sqlite3_prepare_v2(db, sql, -1, &st, nullptr) != SQLITE_OK) {
-        std::cerr << "Prepare SELECT all failed: " << sqlite3_errmsg(db) << "\n";
-        return out;
-    }
-
     while (sqlite3_step(st) == SQLITE_ROW) {
         std::string path      = reinterpret_cast<const char*>(sqlite3_column_text(st, 0));
         std::string name      = reinterpret_cast<const char*>(sqlite3_column_text(st, 1));
@@ -329,14 +660,223 @@ DatabaseManager::getAllFiles()
 
         out.emplace_back(path, name, extension, std::move(vec));
     }
+}
+
+// NOTE: This returns rows with the *embedded vector* loaded from the BLOB table.
+// If you only need metadata, make a lighter query to avoid pulling blobs.
+std::vector<std::tuple<std::string, std::string, std::string, std::vector<float>>>
+DatabaseManager::getAllFiles()
+{
+    STAGE_TIMER("db.read");
+    std::vector<std::tuple<std::string, std::string, std::string, std::vector<float>>> out;
+    if (!writer_) return out;
+    Connection db(*this, Connection::Read);
+
+    // Join files with embeddings; LEFT JOIN in case some rows are missing vectors.
+    const char* sql =
+        "SELECT f.path, f.name, f.extension, e.vector "
+        "FROM files f LEFT JOIN embeddings e ON e.file_id = f.id;";
+
+    sqlite3_stmt* st=nullptr;
+    if (sqlite3_prepare_v2(db, sql, -1, &st, nullptr) != SQLITE_OK) {
+        std::cerr << "Prepare SELECT all failed: " << sqlite3_errmsg(db) << "\n";
+        return out;
+    }
+
+    readFileRows(st, out);
+    sqlite3_finalize(st);
+    return out;
+}
 
+// Filter pushdown: every predicate is an indexed column of `files`, so sqlite
+// narrows the candidate ids first and only joins/reads blobs for survivors.
+std::vector<std::tuple<std::string, std::string, std::string, std::vector<float>>>
+DatabaseManager::getFilteredFiles(const SearchFilter& filter)
+{
+    if (filter.empty()) return getAllFiles();
+
+    STAGE_TIMER("db.read");
+    std::vector<std::tuple<std::string, std::string, std::string, std::vector<float>>> out;
+    if (!writer_) return out;
+    Connection db(*this, Connection::Read);
+
+    std::string sql =
+        "SELECT f.path, f.name, f.extension, e.vector "
+        "FROM files f LEFT JOIN embeddings e ON e.file_id = f.id "
+        "WHERE 1";
+    if (!filter.extensions.empty()) {
+        sql += " AND f.extension COLLATE NOCASE IN (";
+        for (size_t i = 0; i < filter.extensions.size(); ++i) sql += (i ? ",?" : "?");
+        sql += ")";
+    }
+
+    // Directory prefix as a half-open range on the path index:
+    // "/a/b/" <= path < "/a/b0"  ('0' is the byte right after '/')
+    std::string lo, hi;
+    if (!filter.underPath.empty()) {
+        std::string dir = filter.underPath;
+        while (dir.size() > 1 && dir.back() == '/') dir.pop_back();
+        lo = (dir == "/") ? dir : dir + "/";
+        hi = lo;
+        hi.back() = '/' + 1;
+        sql += " AND f.path >= ? AND f.path < ?";
+    }
+    if (filter.modifiedSince  > 0) sql += " AND f.last_modified >= ?";
+    if (filter.modifiedBefore > 0) sql += " AND f.last_modified < ?";
+
+    sqlite3_stmt* st = nullptr;
+    if (sqlite3_prepare_v2(db, sql.c_str(), -1, &st, nullptr) != SQLITE_OK) {
+        std::cerr << "Prepare filtered SELECT failed: " << sqlite3_errmsg(db) << "\n";
+        return out;
+    }
+    int bind = 1;
+    for (const auto& ext : filter.extensions)
+        sqlite3_bind_text(st, bind++, ext.c_str(), -1, SQLITE_TRANSIENT);
+    if (!filter.underPath.empty()) {
+        sqlite3_bind_text(st, bind++, lo.c_str(), -1, SQLITE_TRANSIENT);
+        sqlite3_bind_text(st, bind++, hi.c_str(), -1, SQLITE_TRANSIENT);
+    }
+    if (filter.modifiedSince  > 0) sqlite3_bind_int64(st, bind++, filter.modifiedSince);
+    if (filter.modifiedBefore > 0) sqlite3_bind_int64(st, bind++, filter.modifiedBefore);
+
+    readFileRows(st, out);
+
+    sqlite3_finalize(st);
+    return out;
+}
+
+std::vector<float> DatabaseManager::getEmbedding(const std::string& path){
+    std::vector<float> vec;
+    if (!writer_) return vec;
+    Connection db(*this, Connection::Read);
+
+    sqlite3_stmt* st = nullptr;
+    const char* sql = "SELECT e.vector FROM files f JOIN embeddings e ON e.file_id = f.id WHERE f.path = ?;";
+    if (sqlite3_prepare_v2(db, sql, -1, &st, nullptr) != SQLITE_OK) {
+        std::cerr << "Prepare getEmbedding failed: " << sqlite3_errmsg(db) << "\n";
+        return vec;
+    }
+    sqlite3_bind_text(st, 1, path.c_str(), -1, SQLITE_TRANSIENT);
+    if (sqlite3_step(st) == SQLITE_ROW) {
+        const void* blob = sqlite3_column_blob(st, 0);
+        int bytes = sqlite3_column_bytes(st, 0);
+        if (blob && bytes > 0 && bytes % sizeof(float) == 0) {
+            vec.resize(static_cast<size_t>(bytes) / sizeof(float));
+            std::memcpy(vec.data(), blob, static_cast<size_t>(bytes));
+        }
+    }
+    sqlite3_finalize(st);
+    return vec;
+}
+
+int DatabaseManager::removeFiles(const std::vector<std::string>& paths){
+    if (!writer_) return 0;
+    Connection db(*this, Connection::Write);
+
+    sqlite3_stmt* find = nullptr;
+    sqlite3_stmt* drop = nullptr;
+    if (sqlite3_prepare_v2(db, "SELECT id FROM files WHERE path=?;", -1, &find, nullptr) != SQLITE_OK ||
+        sqlite3_prepare_v2(db, "DELETE FROM files WHERE id=?;", -1, &drop, nullptr) != SQLITE_OK) {
+        std::cerr << "Prepare removeFiles failed: " << sqlite3_errmsg(db) << "\n";
+        sqlite3_finalize(find);
+        return 0;
+    }
+    int removed = 0;
+    for (const auto& path : paths) {
+        sqlite3_bind_text(find, 1, path.c_str(), -1, SQLITE_TRANSIENT);
+        const long long id = sqlite3_step(find) == SQLITE_ROW ? sqlite3_column_int64(find, 0) : -1;
+        sqlite3_reset(find);
+        if (id < 0) continue;
+
+        // embeddings and buckets go with the row (ON DELETE CASCADE), files_fts by trigger
+        if (!promoteFollower(db, id)) {
+            std::cerr << "removeFiles could not regroup " << path << ": " << sqlite3_errmsg(db) << "\n";
+            continue;
+        }
+        sqlite3_bind_int64(drop, 1, id);
+        if (step_done(drop)) ++removed;
+        else std::cerr << "removeFiles failed for " << path << ": " << sqlite3_errmsg(db) << "\n";
+        sqlite3_reset(drop);
+    }
+    sqlite3_finalize(find);
+    sqlite3_finalize(drop);
+    return removed;
+}
+
+// ─────────────────────────────────────────────────────────────────────────────
+// Near-duplicate signatures
+// - Only group representatives are in simhash_buckets, so a lookup never returns a
+//   file that itself borrowed its embedding and groups stay one level deep.
+// ─────────────────────────────────────────────────────────────────────────────
+
+std::vector<SignatureMatch> DatabaseManager::findSignatureMatches(uint64_t simhash) {
+    std::vector<SignatureMatch> out;
+    if (!writer_ || simhash == 0) return out;
+    Connection db(*this, Connection::Read);
+
+    const char* sql =
+        "SELECT DISTINCT f.id, f.path, f.simhash FROM simhash_buckets b "
+        "JOIN files f ON f.id = b.file_id WHERE b.bucket IN (?, ?, ?, ?);";
+    sqlite3_stmt* st = nullptr;
+    if (sqlite3_prepare_v2(db, sql, -1, &st, nullptr) != SQLITE_OK) {
+        std::cerr << "Prepare findSignatureMatches failed: " << sqlite3_errmsg(db) << "\n";
+        return out;
+    }
+    const auto buckets = NearDuplicate::buckets(simhash);
+    for (int band = 0; band < NearDuplicate::kBands; ++band) sqlite3_bind_int64(st, band + 1, buckets[band]);
+    while (sqlite3_step(st) == SQLITE_ROW)
+        out.push_back({sqlite3_column_int64(st, 0), reinterpret_cast<const char*>(sqlite3_column_text(st, 1)),
+                       static_cast<uint64_t>(sqlite3_column_int64(st, 2))});
     sqlite3_finalize(st);
     return out;
 }
 
+bool DatabaseManager::setSignature(const std::string& path, uint64_t simhash, long long representative) {
+    if (!writer_) return false;
+    Connection db(*this, Connection::Write);
+
+    long long id = -1;
+    uint64_t previous = 0;
+    sqlite3_stmt* st = nullptr;
+    if (sqlite3_prepare_v2(db, "SELECT id, simhash FROM files WHERE path=?;", -1, &st, nullptr) != SQLITE_OK) return false;
+    sqlite3_bind_text(st, 1, path.c_str(), -1, SQLITE_TRANSIENT);
+    if (sqlite3_step(st) == SQLITE_ROW) {
+        id = sqlite3_column_int64(st, 0);
+        previous = static_cast<uint64_t>(sqlite3_column_int64(st, 1));
+    }
+    sqlite3_finalize(st);
+    if (id < 0) return false;
+
+    if (sqlite3_prepare_v2(db, "UPDATE files SET simhash=?, duplicate_of=? WHERE id=?;", -1, &st, nullptr) != SQLITE_OK) {
+        std::cerr << "Prepare setSignature failed: " << sqlite3_errmsg(db) << "\n";
+        return false;
+    }
+    sqlite3_bind_int64(st, 1, static_cast<sqlite3_int64>(simhash));
+    if (representative > 0) sqlite3_bind_int64(st, 2, representative);
+    else sqlite3_bind_null(st, 2);
+    sqlite3_bind_int64(st, 3, id);
+    bool ok = step_done(st);
+    sqlite3_finalize(st);
+
+    // files that borrowed this one's embedding stay a group under one of them
+    if (ok && (previous != simhash || representative > 0)) ok = promoteFollower(db, id);
+    if (ok) {
+        ok = sqlite3_prepare_v2(db, "DELETE FROM simhash_buckets WHERE file_id=?;", -1, &st, nullptr) == SQLITE_OK;
+        if (ok) {
+            sqlite3_bind_int64(st, 1, id);
+            ok = step_done(st);
+            sqlite3_finalize(st);
+        }
+    }
+    if (ok && representative <= 0) ok = insertBuckets(db, id, simhash);
+    if (!ok) std::cerr << "setSignature failed: " << sqlite3_errmsg(db) << "\n";
+    return ok;
+}
+
 std::vector<FileRow> DatabaseManager::listFiles(int limit){
     std::vector<FileRow> out;
-    if (!db) return out;
+    if (!writer_) return out;
+    Connection db(*this, Connection::Read);
     
     std::string sql =
         "SELECT id, path, name, extension, last_modified "
@@ -363,4 +903,433 @@ std::vector<FileRow> DatabaseManager::listFiles(int limit){
     }
     sqlite3_finalize(st);
     return out;
-}
\ No newline at end of file
+}
+
+// ─────────────────────────────────────────────────────────────────────────────
+// File browser paging
+// - Keyset pagination on the UNIQUE path index: "path > last seen" instead of
+//   OFFSET, so every page costs the same wherever it is in the list.
+// - `match` is a substring of name or path. 3+ characters go through the trigram
+//   index; shorter needles (or no fts5) use LIKE, still bounded by LIMIT.
+// ─────────────────────────────────────────────────────────────────────────────
+
+static std::string likePattern(const std::string& match){
+    std::string out = "%";
+    for (char c : match) {
+        if (c == '%' || c == '_' || c == '\\') out += '\\';
+        out += c;
+    }
+    return out + "%";
+}
+
+static std::string ftsPhrase(const std::string& match){
+    std::string out = "\"";
+    for (char c : match) {
+        if (c == '"') out += '"';
+        out += c;
+    }
+    return out + "\"";
+}
+
+// WHERE clause for `match`; bindMatch() binds its parameters in the same order.
+std::string DatabaseManager::matchClause(const std::string& match) const{
+    if (match.empty()) return " WHERE 1";
+    if (hasFts_ && match.size() >= 3)
+        return " WHERE f.id IN (SELECT rowid FROM files_fts WHERE files_fts MATCH ?)";
+    return " WHERE (f.name LIKE ? ESCAPE '\\' OR f.path LIKE ? ESCAPE '\\')";
+}
+
+int DatabaseManager::bindMatch(sqlite3_stmt* st, const std::string& match) const{
+    int bind = 1;
+    if (match.empty()) return bind;
+    if (hasFts_ && match.size() >= 3) {
+        sqlite3_bind_text(st, bind++, ftsPhrase(match).c_str(), -1, SQLITE_TRANSIENT);
+    } else {
+        std::string pat = likePattern(match);
+        sqlite3_bind_text(st, bind++, pat.c_str(), -1, SQLITE_TRANSIENT);
+        sqlite3_bind_text(st, bind++, pat.c_str(), -1, SQLITE_TRANSIENT);
+    }
+    return bind;
+}
+
+long long DatabaseManager::countFiles(const std::string& match){
+    if (!writer_) return 0;
+    Connection db(*this, Connection::Read);
+    std::string sql = "SELECT COUNT(*) FROM files f" + matchClause(match) + ";";
+
+    sqlite3_stmt* st = nullptr;
+    if (sqlite3_prepare_v2(db, sql.c_str(), -1, &st, nullptr) != SQLITE_OK) {
+        std::cerr << "Prepare countFiles failed: " << sqlite3_errmsg(db) << "\n";
+        return 0;
+    }
+    bindMatch(st, match);
+    long long n = 0;
+    if (sqlite3_step(st) == SQLITE_ROW) n = sqlite3_column_int64(st, 0);
+    sqlite3_finalize(st);
+    return n;
+}
+
+std::vector<FileRow> DatabaseManager::listFilesAfter(const std::string& afterPath, int limit,
+                                                     const std::string& match){
+    STAGE_TIMER("db.list_page");
+    std::vector<FileRow> out;
+    if (!writer_ || limit <= 0) return out;
+    Connection db(*this, Connection::Read);
+
+    std::string sql =
+        "SELECT f.id, f.path, f.name, f.extension, f.last_modified FROM files f" +
+        matchClause(match) + " AND f.path > ? ORDER BY f.path LIMIT ?;";
+
+    sqlite3_stmt* st = nullptr;
+    if (sqlite3_prepare_v2(db, sql.c_str(), -1, &st, nullptr) != SQLITE_OK) {
+        std::cerr << "Prepare listFilesAfter failed: " << sqlite3_errmsg(db) << "\n";
+        return out;
+    }
+    int bind = bindMatch(st, match);
+    sqlite3_bind_text(st, bind++, afterPath.c_str(), -1, SQLITE_TRANSIENT);
+    sqlite3_bind_int(st, bind++, limit);
+
+    out.reserve(static_cast<size_t>(limit));
+    while (sqlite3_step(st) == SQLITE_ROW) {
+        const unsigned char* ext = sqlite3_column_text(st, 3);
+        FileRow r;
+        r.id            = sqlite3_column_int64(st, 0);
+        r.path          = reinterpret_cast<const char*>(sqlite3_column_text(st, 1));
+        r.name          = reinterpret_cast<const char*>(sqlite3_column_text(st, 2));
+        r.extension     = ext ? reinterpret_cast<const char*>(ext) : "";
+        r.last_modified = sqlite3_column_int64(st, 4);
+        out.emplace_back(std::move(r));
+    }
+    sqlite3_finalize(st);
+    return out;
+}
+
+std::string DatabaseManager::pathAtOffset(long long offset, const std::string& match){
+    if (!writer_ || offset < 0) return "";
+    Connection db(*this, Connection::Read);
+    std::string sql = "SELECT f.path FROM files f" + matchClause(match) +
+                      " ORDER BY f.path LIMIT 1 OFFSET ?;";
+
+    sqlite3_stmt* st = nullptr;
+    if (sqlite3_prepare_v2(db, sql.c_str(), -1, &st, nullptr) != SQLITE_OK) {
+        std::cerr << "Prepare pathAtOffset failed: " << sqlite3_errmsg(db) << "\n";
+        return "";
+    }
+    int bind = bindMatch(st, match);
+    sqlite3_bind_int64(st, bind, offset);
+    std::string path;
+    if (sqlite3_step(st) == SQLITE_ROW) path = reinterpret_cast<const char*>(sqlite3_column_text(st, 0));
+    sqlite3_finalize(st);
+    return path;
+}
+
+void DatabaseManager::forEachEmbedding(const std::function<void(const FileRow&, const float*, size_t)>& visit){
+    STAGE_TIMER("db.load_vectors");
+    if (!writer_) return;
+    Connection db(*this, Connection::Read);
+
+    const char* sql =
+        "SELECT f.id, f.path, f.name, f.extension, f.last_modified, e.vector, COALESCE(f.duplicate_of, f.id), COALESCE(f.simhash, 0) "
+        "FROM files f JOIN embeddings e ON e.file_id = f.id "
+        "ORDER BY f.path;";
+
+    sqlite3_stmt* st = nullptr;
+    if (sqlite3_prepare_v2(db, sql, -1, &st, nullptr) != SQLITE_OK) {
+        std::cerr << "Prepare forEachEmbedding failed: " << sqlite3_errmsg(db) << "\n";
+        return;
+    }
+
+    FileRow r;
+    while (sqlite3_step(st) == SQLITE_ROW) {
+        const void* blob = sqlite3_column_blob(st, 5);
+        int bytes = sqlite3_column_bytes(st, 5);
+        if (!blob || bytes <= 0 || bytes % sizeof(float) != 0) continue;
+
+        const unsigned char* ext = sqlite3_column_text(st, 3);
+        r.id            = sqlite3_column_int64(st, 0);
+        r.path          = reinterpret_cast<const char*>(sqlite3_column_text(st, 1));
+        r.name          = reinterpret_cast<const char*>(sqlite3_column_text(st, 2));
+        r.extension     = ext ? reinterpret_cast<const char*>(ext) : "";
+        r.last_modified = sqlite3_column_int64(st, 4);
+        r.group         = sqlite3_column_int64(st, 6);
+        r.simhash       = static_cast<uint64_t>(sqlite3_column_int64(st, 7));
+
+        // blob memory stays valid until the next step, so no copy is needed here
+        visit(r, static_cast<const float*>(blob), static_cast<size_t>(bytes) / sizeof(float));
+    }
+    sqlite3_finalize(st);
+}
+
+// ─────────────────────────────────────────────────────────────────────────────
+// Index journal
+// - One row per planned file, in scan order (seq); `done` flips inside the batch
+//   transaction that stored the file, `attempts` is committed before work starts.
+// - A finished run's rows are deleted; only the run row is kept.
+// ─────────────────────────────────────────────────────────────────────────────
+
+static bool execSql(sqlite3* db, const char* sql, const char* what) {
+    char* err = nullptr;
+    if (sqlite3_exec(db, sql, nullptr, nullptr, &err) != SQLITE_OK) {
+        std::cerr << what << " failed: " << (err ? err : "unknown") << "\n";
+        sqlite3_free(err);
+        return false;
+    }
+    return true;
+}
+
+long long DatabaseManager::openIndexRun(const std::string& root, bool resume, bool& resumed) {
+    resumed = false;
+    if (!writer_) return 0;
+    Connection db(*this, Connection::Write);
+
+    long long open = 0;
+    sqlite3_stmt* st = nullptr;
+    if (sqlite3_prepare_v2(db, "SELECT id FROM index_runs WHERE root=? AND finished IS NULL ORDER BY id DESC LIMIT 1;",
+                           -1, &st, nullptr) != SQLITE_OK) {
+        std::cerr << "Prepare index run lookup failed: " << sqlite3_errmsg(db) << "\n";
+        return 0;
+    }
+    sqlite3_bind_text(st, 1, root.c_str(), -1, SQLITE_TRANSIENT);
+    if (sqlite3_step(st) == SQLITE_ROW) open = sqlite3_column_int64(st, 0);
+    sqlite3_finalize(st);
+
+    if (open && resume) {
+        resumed = true;
+        return open;
+    }
+    if (open) finishIndexRun(open);   // a fresh scan replaces the old plan
+
+    if (sqlite3_prepare_v2(db, "INSERT INTO index_runs(root, started) VALUES(?, strftime('%s','now'));",
+                           -1, &st, nullptr) != SQLITE_OK) {
+        std::cerr << "Prepare index run insert failed: " << sqlite3_errmsg(db) << "\n";
+        return 0;
+    }
+    sqlite3_bind_text(st, 1, root.c_str(), -1, SQLITE_TRANSIENT);
+    bool ok = step_done(st);
+    sqlite3_finalize(st);
+    return ok ? sqlite3_last_insert_rowid(db) : 0;
+}
+
+bool DatabaseManager::planIndexRun(long long run, const std::vector<JournalEntry>& files) {
+    if (!writer_ || !beginBatch()) return false;
+    Connection db(*this, Connection::Write);
+    sqlite3_stmt* st = nullptr;
+    if (sqlite3_prepare_v2(db, "INSERT INTO index_journal(run_id, seq, path, name, extension) VALUES(?, ?, ?, ?, ?);",
+                           -1, &st, nullptr) != SQLITE_OK) {
+        std::cerr << "Prepare journal plan failed: " << sqlite3_errmsg(db) << "\n";
+        rollbackBatch();
+        return false;
+    }
+    bool ok = true;
+    for (size_t i = 0; i < files.size() && ok; ++i) {
+        sqlite3_bind_int64(st, 1, run);
+        sqlite3_bind_int64(st, 2, static_cast<sqlite3_int64>(i));
+        sqlite3_bind_text(st, 3, files[i].path.c_str(), -1, SQLITE_TRANSIENT);
+        sqlite3_bind_text(st, 4, files[i].name.c_str(), -1, SQLITE_TRANSIENT);
+        sqlite3_bind_text(st, 5, files[i].extension.c_str(), -1, SQLITE_TRANSIENT);
+        ok = step_done(st);
+        sqlite3_reset(st);
+    }
+    sqlite3_finalize(st);
+    if (!ok) {
+        std::cerr << "Writing the index plan failed: " << sqlite3_errmsg(db) << "\n";
+        rollbackBatch();
+        return false;
+    }
+    return commitBatch();
+}
+
+std::vector<JournalEntry> DatabaseManager::pendingIndexFiles(long long run) {
+    std::vector<JournalEntry> out;
+    if (!writer_) return out;
+    Connection db(*this, Connection::Read);
+    sqlite3_stmt* st = nullptr;
+    if (sqlite3_prepare_v2(db, "SELECT path, name, extension, attempts FROM index_journal "
+                               "WHERE run_id=? AND done=0 ORDER BY seq;", -1, &st, nullptr) != SQLITE_OK) {
+        std::cerr << "Prepare journal read failed: " << sqlite3_errmsg(db) << "\n";
+        return out;
+    }
+    sqlite3_bind_int64(st, 1, run);
+    while (sqlite3_step(st) == SQLITE_ROW) {
+        const unsigned char* ext = sqlite3_column_text(st, 2);
+        JournalEntry e;
+        e.path      = reinterpret_cast<const char*>(sqlite3_column_text(st, 0));
+        e.name      = reinterpret_cast<const char*>(sqlite3_column_text(st, 1));
+        e.extension = ext ? reinterpret_cast<const char*>(ext) : "";
+        e.attempts  = sqlite3_column_int(st, 3);
+        out.push_back(std::move(e));
+    }
+    sqlite3_finalize(st);
+    return out;
+}
+
+bool DatabaseManager::markIndexAttempt(long long run, const std::vector<std::string>& paths) {
+    if (!writer_ || !beginBatch()) return false;
+    Connection db(*this, Connection::Write);
+    sqlite3_stmt* st = nullptr;
+    if (sqlite3_prepare_v2(db, "UPDATE index_journal SET attempts=attempts+1 WHERE run_id=? AND path=?;",
+                           -1, &st, nullptr) != SQLITE_OK) {
+        std::cerr << "Prepare journal attempt failed: " << sqlite3_errmsg(db) << "\n";
+        rollbackBatch();
+        return false;
+    }
+    for (const auto& path : paths) {
+        sqlite3_bind_int64(st, 1, run);
+        sqlite3_bind_text(st, 2, path.c_str(), -1, SQLITE_TRANSIENT);
+        step_done(st);
+        sqlite3_reset(st);
+    }
+    sqlite3_finalize(st);
+    return commitBatch();
+}
+
+bool DatabaseManager::markIndexDone(long long run, const std::string& path) {
+    if (!writer_) return false;
+    Connection db(*this, Connection::Write);
+    sqlite3_stmt* st = nullptr;
+    if (sqlite3_prepare_v2(db, "UPDATE index_journal SET done=1 WHERE run_id=? AND path=?;",
+                           -1, &st, nullptr) != SQLITE_OK) {
+        std::cerr << "Prepare journal done failed: " << sqlite3_errmsg(db) << "\n";
+        return false;
+    }
+    sqlite3_bind_int64(st, 1, run);
+    sqlite3_bind_text(st, 2, path.c_str(), -1, SQLITE_TRANSIENT);
+    bool ok = step_done(st);
+    sqlite3_finalize(st);
+    return ok;
+}
+
+bool DatabaseManager::finishIndexRun(long long run) {
+    if (!writer_ || !beginBatch()) return false;
+    Connection db(*this, Connection::Write);
+    sqlite3_stmt* st = nullptr;
+    bool ok = true;
+    for (const char* sql : {"DELETE FROM index_journal WHERE run_id=?;",
+                            "UPDATE index_runs SET finished=strftime('%s','now') WHERE id=?;"}) {
+        if (sqlite3_prepare_v2(db, sql, -1, &st, nullptr) != SQLITE_OK) { ok = false; break; }
+        sqlite3_bind_int64(st, 1, run);
+        ok = step_done(st);
+        sqlite3_finalize(st);
+        if (!ok) break;
+    }
+    if (!ok) {
+        std::cerr << "Closing index run failed: " << sqlite3_errmsg(db) << "\n";
+        rollbackBatch();
+        return false;
+    }
+    return commitBatch();
+}
+
+// the writer stays locked from BEGIN to COMMIT/ROLLBACK, so no other thread's write
+// lands inside this thread's batch
+bool DatabaseManager::beginBatch() {
+    if (!writer_) return false;
+    lockWriter();
+    if (!execSql(writer_, "BEGIN IMMEDIATE;", "BEGIN")) {
+        unlockWriter();
+        return false;
+    }
+    ++openBatches_;
+    return true;
+}
+
+bool DatabaseManager::commitBatch() {
+    if (!writer_ || !holdsWriter() || openBatches_ == 0) return false;
+    bool ok = execSql(writer_, "COMMIT;", "COMMIT");
+    // a failed COMMIT can leave the transaction open; don't keep the writer locked on it
+    if (!ok && !sqlite3_get_autocommit(writer_)) execSql(writer_, "ROLLBACK;", "ROLLBACK");
+    --openBatches_;
+    unlockWriter();
+    return ok;
+}
+
+void DatabaseManager::rollbackBatch() {
+    if (!writer_ || !holdsWriter() || openBatches_ == 0) return;
+    execSql(writer_, "ROLLBACK;", "ROLLBACK");
+    --openBatches_;
+    unlockWriter();
+}
+
+// ─────────────────────────────────────────────────────────────────────────────
+// Quarantine
+// ─────────────────────────────────────────────────────────────────────────────
+
+bool DatabaseManager::strikeFile(const std::string& path, long long lastModified, int strikes,
+                                 const std::string& reason) {
+    if (!writer_) return false;
+    Connection db(*this, Connection::Write);
+    // a new last_modified means the file changed: its old strikes no longer count
+    const char* sql =
+        "INSERT INTO quarantine(path, last_modified, strikes, reason, since) "
+        "VALUES(?1, ?2, ?3, ?4, strftime('%s','now')) "
+        "ON CONFLICT(path) DO UPDATE SET "
+        "  strikes = CASE WHEN last_modified = excluded.last_modified THEN strikes + excluded.strikes"
+        "                 ELSE excluded.strikes END,"
+        "  last_modified = excluded.last_modified, reason = excluded.reason;";
+    sqlite3_stmt* st = nullptr;
+    if (sqlite3_prepare_v2(db, sql, -1, &st, nullptr) != SQLITE_OK) {
+        std::cerr << "Prepare quarantine failed: " << sqlite3_errmsg(db) << "\n";
+        return false;
+    }
+    sqlite3_bind_text(st, 1, path.c_str(), -1, SQLITE_TRANSIENT);
+    sqlite3_bind_int64(st, 2, lastModified);
+    sqlite3_bind_int(st, 3, strikes);
+    sqlite3_bind_text(st, 4, reason.c_str(), -1, SQLITE_TRANSIENT);
+    bool ok = step_done(st);
+    sqlite3_finalize(st);
+    return ok;
+}
+
+bool DatabaseManager::isQuarantined(const std::string& path, long long lastModified, int maxStrikes) {
+    if (!writer_) return false;
+    Connection db(*this, Connection::Read);
+    sqlite3_stmt* st = nullptr;
+    if (sqlite3_prepare_v2(db, "SELECT 1 FROM quarantine WHERE path=? AND last_modified=? AND strikes>=?;",
+                           -1, &st, nullptr) != SQLITE_OK) {
+        std::cerr << "Prepare quarantine check failed: " << sqlite3_errmsg(db) << "\n";
+        return false;
+    }
+    sqlite3_bind_text(st, 1, path.c_str(), -1, SQLITE_TRANSIENT);
+    sqlite3_bind_int64(st, 2, lastModified);
+    sqlite3_bind_int(st, 3, maxStrikes);
+    bool quarantined = (sqlite3_step(st) == SQLITE_ROW);
+    sqlite3_finalize(st);
+    return quarantined;
+}
+
+std::vector<QuarantineEntry> DatabaseManager::listQuarantine() {
+    std::vector<QuarantineEntry> out;
+    if (!writer_) return out;
+    Connection db(*this, Connection::Read);
+    sqlite3_stmt* st = nullptr;
+    if (sqlite3_prepare_v2(db, "SELECT path, last_modified, strikes, reason FROM quarantine ORDER BY path;",
+                           -1, &st, nullptr) != SQLITE_OK) {
+        std::cerr << "Prepare quarantine list failed: " << sqlite3_errmsg(db) << "\n";
+        return out;
+    }
+    while (sqlite3_step(st) == SQLITE_ROW) {
+        const unsigned char* reason = sqlite3_column_text(st, 3);
+        QuarantineEntry q;
+        q.path          = reinterpret_cast<const char*>(sqlite3_column_text(st, 0));
+        q.last_modified = sqlite3_column_int64(st, 1);
+        q.strikes       = sqlite3_column_int(st, 2);
+        q.reason        = reason ? reinterpret_cast<const char*>(reason) : "";
+        out.push_back(std::move(q));
+    }
+    sqlite3_finalize(st);
+    return out;
+}
+
+bool DatabaseManager::releaseQuarantine(const std::string& path) {
+    if (!writer_) return false;
+    Connection db(*this, Connection::Write);
+    sqlite3_stmt* st = nullptr;
+    if (sqlite3_prepare_v2(db, "DELETE FROM quarantine WHERE path=?;", -1, &st, nullptr) != SQLITE_OK) {
+        std::cerr << "Prepare quarantine release failed: " << sqlite3_errmsg(db) << "\n";
+        return false;
+    }
+    sqlite3_bind_text(st, 1, path.c_str(), -1, SQLITE_TRANSIENT);
+    bool ok = step_done(st) && sqlite3_changes(db) > 0;
+    sqlite3_finalize(st);
+    return ok;
+}
@@ -0,0 +1,121 @@
+/*Embedding batcher
+--submit appends to one queue and updates the arrival gap (EWMA, 1/8 weight)
+--a runner waits for the first request, then until the batch is full, the oldest
+  request's window has passed or no request came for two gaps; takes up to maxBatch
+  and embeds them unlocked
+--promises are always fulfilled, with an empty vector when the backend came up short*/
+
+#include "EmbeddingBatcher.hpp"
+#include "Metrics.hpp"
+
+#include <algorithm>
+#include <exception>
+#include <iostream>
+
+EmbeddingBatcher::EmbeddingBatcher(Embedder& backend, const BatcherConfig& config)
+    : backend_(backend), config_(config)
+{
+    backend_.reserveBatch(config_.maxBatch);
+    for (int i = 0; i < std::max(1, config_.runners); ++i)
+        runners_.emplace_back(&EmbeddingBatcher::runLoop, this);
+}
+
+EmbeddingBatcher::~EmbeddingBatcher(){
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stopping_ = true;
+    }
+    queued_.notify_all();
+    for (auto& t : runners_) t.join();
+}
+
+std::future<std::vector<float>> EmbeddingBatcher::submit(std::string text){
+    Request request;
+    request.text = std::move(text);
+    std::future<std::vector<float>> result = request.result.get_future();
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        const Clock::time_point now = Clock::now();
+        if (lastArrival_ != Clock::time_point()) {
+            const double gap = std::chrono::duration<double, std::micro>(now - lastArrival_).count();
+            gapMicros_ += (gap - gapMicros_) / 8.0;
+            lastGapMicros_ = gap;
+        }
+        lastArrival_ = now;
+        request.arrived = now;
+        queue_.push_back(std::move(request));
+    }
+    queued_.notify_one();
+    return result;
+}
+
+std::chrono::microseconds EmbeddingBatcher::window() const{
+    // nobody else expected within the window: waiting would only add latency
+    const double maxWindow = static_cast<double>(config_.maxWindow.count());
+    if (gapMicros_ >= maxWindow || queue_.size() >= config_.maxBatch) return std::chrono::microseconds(0);
+    if (queue_.size() == 1 && lastGapMicros_ >= maxWindow) return std::chrono::microseconds(0);
+    // otherwise wait about as long as the rest of the batch takes to arrive
+    const double fill = gapMicros_ * static_cast<double>(config_.maxBatch - queue_.size());
+    return std::chrono::microseconds(static_cast<long long>(std::min(maxWindow, fill)));
+}
+
+void EmbeddingBatcher::runLoop(){
+    static Counter&   batches = Metrics::instance().counter("embed.batches");
+    static Counter&   batched = Metrics::instance().counter("embed.batched_queries");
+    static Histogram& waited  = Metrics::instance().histogram("embed.batch_wait");
+
+    std::unique_lock<std::mutex> lock(mutex_);
+    for (;;) {
+        queued_.wait(lock, [&] { return stopping_ || !queue_.empty(); });
+        if (queue_.empty()) return;   // stopping and drained
+
+        // re-evaluated on every wake-up: arrivals both fill the batch and shrink the gap
+        while (!stopping_ && !queue_.empty() && queue_.size() < config_.maxBatch) {
+            // stop early once arrivals stall: with every client already queued or in
+            // a batch, nothing else is coming however long the window is
+            const auto stall = std::chrono::microseconds(static_cast<long long>(2.0 * gapMicros_));
+            const Clock::time_point deadline = std::min(queue_.front().arrived + window(), lastArrival_ + stall);
+            if (Clock::now() >= deadline) break;
+            queued_.wait_until(lock, deadline);
+        }
+        if (queue_.empty()) continue;   // another runner took them
+
+        std::vector<Request> batch;
+        const size_t n = std::min(queue_.size(), config_.maxBatch);
+        batch.reserve(n);
+        for (size_t i = 0; i < n; ++i) {
+            batch.push_back(std::move(queue_.front()));
+            queue_.pop_front();
+        }
+        stats_.requests += n;
+        stats_.batches  += 1;
+        stats_.largestBatch = std::max(stats_.largestBatch, n);
+        if (!queue_.empty()) queued_.notify_one();   // the rest is another runner's batch
+        lock.unlock();
+
+        const Clock::time_point start = Clock::now();
+        waited.record(static_cast<uint64_t>(
+            std::chrono::duration_cast<std::chrono::nanoseconds>(start - batch.front().arrived).count()));
+        batches.add();
+        batched.add(n);
+
+        std::vector<std::string> texts;
+        texts.reserve(n);
+        for (auto& r : batch) texts.push_back(std::move(r.text));
+        std::vector<std::vector<float>> vectors;
+        try {
+            vectors = backend_.createEmbeddings(texts);
+        } catch (const std::exception& e) {
+            std::cerr << "[batch] Embedding " << n << " queries failed: " << e.what() << "\n";
+        }
+        for (size_t i = 0; i < n; ++i)
+            batch[i].result.set_value(i < vectors.size() ? std::move(vectors[i]) : std::vector<float>());
+
+        lock.lock();
+    }
+}
+
+BatcherStats EmbeddingBatcher::stats() const{
+    std::lock_guard<std::mutex> lock(mutex_);
+    return stats_;
+}
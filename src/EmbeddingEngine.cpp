@@ -1,8 +1,18 @@
 /*Now generate an embedding based on the actual inputs of the file contents*/
 
 #include "EmbeddingEngine.hpp"
+#include "VectorMath.hpp"
+#include "Metrics.hpp"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
 #include <iostream>
+#include <stdexcept>
 #include <vector>
+#include <unistd.h>
 
 
 //opening up the downloaded ai to access the model and create embeddings using such model
@@ -12,15 +22,171 @@ EmbeddingEngine::EmbeddingEngine(const std::string& onnxModelPath,
                                  const std::string& pythonExe,
                                  const std::string& tokenizerScript,
                                  const std::string& tokenizerJson,
-                                 size_t maxSeqLen)
-: env(ORT_LOGGING_LEVEL_WARNING, "embed"),
+                                 size_t maxSeqLen,
+                                 const std::string& variant)
+: env(nullptr),
   session(nullptr),
+  modelPath_(variantModelPath(onnxModelPath, variant)),
+  variant_(variant),
+  pythonExe_(pythonExe),
+  tokenizerScript_(tokenizerScript),
+  tokenizerJson_(tokenizerJson),
   maxSeqLen_(maxSeqLen)
 {
+    // Nothing heavy here: commands that never embed (stats, listing, daemon
+    // hand-off) shouldn't pay for loading and optimizing the graph.
+}
+
+// Everything one Run touches, allocated once at [1, maxSeqLen] and bound by name,
+// so ORT reads the inputs from and writes last_hidden_state into these buffers.
+struct EmbeddingEngine::InferenceContext {
+    std::vector<int64_t> inputIds;
+    std::vector<int64_t> attentionMask;
+    std::vector<int64_t> tokenTypeIds;   // always zero (single segment)
+    std::vector<float>   hiddenStates;   // [maxSeqLen, hidden]
+
+    Ort::Value idsT{nullptr}, maskT{nullptr}, typesT{nullptr}, hiddenT{nullptr};
+    Ort::IoBinding binding;
+    Ort::RunOptions runOptions{nullptr};
+
+    explicit InferenceContext(Ort::Session& session) : binding(session) {}
+};
+
+// Buffers of one batched Run, allocated once for [rows, maxSeqLen]. The shape of a batch
+// changes from call to call, so only the tensor headers are made per Run, over the front
+// of these buffers.
+struct EmbeddingEngine::BatchContext {
+    size_t rows = 0;
+    std::vector<int64_t> inputIds;
+    std::vector<int64_t> attentionMask;
+    std::vector<int64_t> tokenTypeIds;   // always zero (single segment)
+    std::vector<float>   hiddenStates;   // [rows, maxSeqLen, hidden]
+};
+
+EmbeddingEngine::~EmbeddingEngine() = default;
+
+bool EmbeddingEngine::isKnownVariant(const std::string& variant) {
+    return variant == "fp32" || variant == "int8" || variant == "fp16" || variant == "static";
+}
+
+std::string EmbeddingEngine::variantModelPath(const std::string& fp32ModelPath, const std::string& variant) {
+    if (variant == "fp32") return fp32ModelPath;
+    std::filesystem::path p(fp32ModelPath);
+    if (variant == "static") return (p.parent_path() / (p.stem().string() + ".static.bin")).string();
+    return (p.parent_path() / (p.stem().string() + "." + variant + p.extension().string())).string();
+}
+
+// every ONNX variant is an export of the same model (tools/quantize.py)
+static const char* kOnnxModelName = "all-MiniLM-L6-v2-ONNX";
+static constexpr size_t kOnnxDimension = 384;
+
+std::string EmbeddingEngine::modelName() const {
+    if (variant_ == "static") return "static:" + std::filesystem::path(modelPath_).filename().string();
+    return kOnnxModelName;
+}
+
+size_t EmbeddingEngine::modelDimension() const {
+    if (hiddenDim_) return hiddenDim_;
+    return variant_ == "static" ? StaticEmbedding::readDimension(modelPath_) : kOnnxDimension;
+}
+
+// FNV-1a over the model bytes; cheap next to graph optimization and it
+// catches a model swapped in place under the same name.
+static uint64_t hashFile(const std::string& path) {
+    std::ifstream in(path, std::ios::binary);
+    uint64_t h = 1469598103934665603ull;
+    std::vector<char> buf(1 << 20);
+    while (in) {
+        in.read(buf.data(), static_cast<std::streamsize>(buf.size()));
+        std::streamsize n = in.gcount();
+        for (std::streamsize i = 0; i < n; ++i) {
+            h ^= static_cast<unsigned char>(buf[static_cast<size_t>(i)]);
+            h *= 1099511628211ull;
+        }
+    }
+    return h;
+}
+
+std::string EmbeddingEngine::optimizedModelPath() const {
+    namespace fs = std::filesystem;
+    fs::path model(modelPath_);
+    fs::path cacheDir = model.parent_path() / ".ort_cache";
+
+    // Re-hashing ~90MB every launch would eat into the start-up we're saving,
+    // so the hash is remembered next to the cache and reused while the model's
+    // size and mtime are unchanged.
+    std::error_code ec;
+    unsigned long long size  = static_cast<unsigned long long>(fs::file_size(model, ec));
+    long long          mtime = static_cast<long long>(fs::last_write_time(model, ec).time_since_epoch().count());
+    fs::path keyFile = cacheDir / (model.stem().string() + ".hash");
+
+    unsigned long long modelHash = 0, keySize = 0;
+    long long keyMtime = 0;
+    std::ifstream key(keyFile);
+    if (!(key >> keySize >> keyMtime >> std::hex >> modelHash) || keySize != size || keyMtime != mtime) {
+        modelHash = hashFile(modelPath_);
+        fs::create_directories(cacheDir, ec);
+        std::ofstream(keyFile) << size << " " << mtime << " " << std::hex << modelHash << "\n";
+    }
+
+    char hash[17];
+    std::snprintf(hash, sizeof(hash), "%016llx", modelHash);
+
+    std::string ortVersion = OrtGetApiBase()->GetVersionString();
+    return (cacheDir /
+            (model.stem().string() + "." + hash + ".ort" + ortVersion + ".onnx")).string();
+}
+
+void EmbeddingEngine::initialize() {
+    namespace fs = std::filesystem;
+    STAGE_TIMER("embed.session_init");
+    auto t0 = std::chrono::steady_clock::now();
+
+    if (variant_ == "static") {
+        static_ = StaticEmbedding::load(modelPath_);
+        if (!static_) throw std::runtime_error("no usable static embedding table");
+        hiddenDim_ = static_->dimension();
+        auto ms = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - t0).count();
+        std::cerr << "[static] " << static_->vocabularySize() << " tokens x " << hiddenDim_
+                  << " dims loaded in " << ms << " ms" << std::endl;
+        ready_ = true;
+        return;
+    }
+
+    env = Ort::Env(ORT_LOGGING_LEVEL_WARNING, "embed");
     sessionOptions.SetIntraOpNumThreads(1);
-    sessionOptions.SetGraphOptimizationLevel(GraphOptimizationLevel::ORT_ENABLE_EXTENDED);
 
-    session = Ort::Session(env, onnxModelPath.c_str(), sessionOptions);
+    // Graph optimization is the bulk of session start-up, so it runs once per
+    // (model hash, ORT version) and the result is loaded as-is afterwards.
+    std::string cached = optimizedModelPath();
+    bool fromCache = false;
+    if (fs::exists(cached)) {
+        try {
+            Ort::SessionOptions cachedOpts;
+            cachedOpts.SetIntraOpNumThreads(1);
+            cachedOpts.SetGraphOptimizationLevel(GraphOptimizationLevel::ORT_DISABLE_ALL);
+            session = Ort::Session(env, cached.c_str(), cachedOpts);
+            fromCache = true;
+        } catch (const Ort::Exception& e) {
+            std::cerr << "[ONNX] Ignoring unreadable cached graph " << cached << ": " << e.what() << "\n";
+            std::error_code ec;
+            fs::remove(cached, ec);
+        }
+    }
+    if (!fromCache) {
+        // write to a temp name and rename so a concurrent/killed run never
+        // leaves a half-written graph behind
+        std::error_code ec;
+        fs::create_directories(fs::path(cached).parent_path(), ec);
+        std::string tmp = cached + ".tmp" + std::to_string(static_cast<long long>(::getpid()));
+
+        sessionOptions.SetGraphOptimizationLevel(GraphOptimizationLevel::ORT_ENABLE_EXTENDED);
+        if (!ec) sessionOptions.SetOptimizedModelFilePath(tmp.c_str());
+        session = Ort::Session(env, modelPath_.c_str(), sessionOptions);
+
+        if (!ec && fs::exists(tmp)) fs::rename(tmp, cached, ec);
+        if (ec) fs::remove(tmp, ec);
+    }
 
     // cache input/output names (we’ll match by substring)
     Ort::AllocatorWithDefaultOptions alloc;
@@ -37,86 +203,254 @@ EmbeddingEngine::EmbeddingEngine(const std::string& onnxModelPath,
         Ort::AllocatedStringPtr name = session.GetOutputNameAllocated(i, alloc);
         outputNamesOwned_.emplace_back(name.get());
     }
+    // hidden size from the first output ([batch, seq, hidden]); the last dim is
+    // fixed in every sentence-transformer export we ship
+    Ort::TypeInfo outType = session.GetOutputTypeInfo(0);   // outInfo is a view into it
+    auto outInfo = outType.GetTensorTypeAndShapeInfo();
+    std::vector<int64_t> outShape = outInfo.GetShape();
+    if (outShape.size() != 3 || outShape[2] <= 0)
+        throw std::runtime_error("expected a [batch, seq, hidden] first output with a fixed hidden size");
+    // quantized exports keep float32 inputs/outputs (tools/quantize.py --keep-io-types)
+    if (outInfo.GetElementType() != ONNX_TENSOR_ELEMENT_DATA_TYPE_FLOAT)
+        throw std::runtime_error("model output is not float32; re-export the " + variant_ +
+                                 " variant with float32 I/O");
+    hiddenDim_ = static_cast<size_t>(outShape[2]);
+    idleContexts_.push_back(makeContext());
+
     // create the tokenizer bridge (python helper)
-    tok_ = std::make_unique<TokenizerClient>(pythonExe, tokenizerScript, tokenizerJson, (int)maxSeqLen_);
+    tok_ = std::make_unique<TokenizerClient>(pythonExe_, tokenizerScript_, tokenizerJson_, (int)maxSeqLen_);
 
     // (optional) log names once
     std::cerr << "[ONNX] Inputs:";
     for (auto n : inputNamesOwned_) std::cerr << " " << n;
     std::cerr << "\n[ONNX] Outputs:";
     for (auto n : outputNamesOwned_) std::cerr << " " << n;
-    std::cerr << std::endl;
+    auto ms = std::chrono::duration_cast<std::chrono::milliseconds>(
+        std::chrono::steady_clock::now() - t0).count();
+    std::cerr << "\n[ONNX] " << variant_ << " session ready in " << ms << " ms ("
+              << (fromCache ? "cached optimized graph" : "optimized and cached") << ")" << std::endl;
+    ready_ = true;
+}
+
+bool EmbeddingEngine::warmUp() {
+    try {
+        std::call_once(initOnce_, [this] { initialize(); });
+    } catch (const std::exception& e) {
+        // call_once stays unset after a throw, so the next call retries
+        std::cerr << "[ONNX] Failed to load " << modelPath_ << ": " << e.what() << std::endl;
+        return false;
+    }
+    return ready_;
+}
+
+std::unique_ptr<EmbeddingEngine::InferenceContext> EmbeddingEngine::makeContext() {
+    auto ctx = std::make_unique<InferenceContext>(session);
+    const size_t seq = maxSeqLen_;
+    ctx->inputIds.assign(seq, 0);
+    ctx->attentionMask.assign(seq, 0);
+    ctx->tokenTypeIds.assign(seq, 0);
+    ctx->hiddenStates.assign(seq * hiddenDim_, 0.0f);
+
+    Ort::MemoryInfo mem = Ort::MemoryInfo::CreateCpu(OrtArenaAllocator, OrtMemTypeDefault);
+    const int64_t inShape[2]  = {1, static_cast<int64_t>(seq)};
+    const int64_t outShape[3] = {1, static_cast<int64_t>(seq), static_cast<int64_t>(hiddenDim_)};
+    ctx->idsT    = Ort::Value::CreateTensor<int64_t>(mem, ctx->inputIds.data(), seq, inShape, 2);
+    ctx->maskT   = Ort::Value::CreateTensor<int64_t>(mem, ctx->attentionMask.data(), seq, inShape, 2);
+    ctx->typesT  = Ort::Value::CreateTensor<int64_t>(mem, ctx->tokenTypeIds.data(), seq, inShape, 2);
+    ctx->hiddenT = Ort::Value::CreateTensor<float>(mem, ctx->hiddenStates.data(), ctx->hiddenStates.size(), outShape, 3);
+
+    // bind by name (robust to different input ordering)
+    for (auto& n : inputNamesOwned_) {
+        if (n.find("input_ids") != std::string::npos)           ctx->binding.BindInput(n.c_str(), ctx->idsT);
+        else if (n.find("attention_mask") != std::string::npos) ctx->binding.BindInput(n.c_str(), ctx->maskT);
+        else if (n.find("token_type_ids") != std::string::npos) ctx->binding.BindInput(n.c_str(), ctx->typesT);
+    }
+    ctx->binding.BindOutput(outputNamesOwned_[0].c_str(), ctx->hiddenT);
+    return ctx;
+}
+
+std::unique_ptr<EmbeddingEngine::InferenceContext> EmbeddingEngine::acquireContext() {
+    {
+        std::lock_guard<std::mutex> lock(contextMutex_);
+        if (!idleContexts_.empty()) {
+            auto ctx = std::move(idleContexts_.back());
+            idleContexts_.pop_back();
+            return ctx;
+        }
+    }
+    // first time this many threads embed at once
+    return makeContext();
+}
+
+void EmbeddingEngine::releaseContext(std::unique_ptr<InferenceContext> ctx) {
+    std::lock_guard<std::mutex> lock(contextMutex_);
+    idleContexts_.push_back(std::move(ctx));
+}
+
+void EmbeddingEngine::reserveBatch(size_t maxBatch) {
+    std::lock_guard<std::mutex> lock(contextMutex_);
+    maxBatch_ = std::max<size_t>(1, maxBatch);
+    idleBatches_.clear();   // sized for the old maximum
+}
+
+std::unique_ptr<EmbeddingEngine::BatchContext> EmbeddingEngine::acquireBatch() {
+    size_t rows = 0;
+    {
+        std::lock_guard<std::mutex> lock(contextMutex_);
+        if (!idleBatches_.empty()) {
+            auto ctx = std::move(idleBatches_.back());
+            idleBatches_.pop_back();
+            return ctx;
+        }
+        rows = maxBatch_;
+    }
+    auto ctx = std::make_unique<BatchContext>();
+    ctx->rows = rows;
+    ctx->inputIds.assign(rows * maxSeqLen_, 0);
+    ctx->attentionMask.assign(rows * maxSeqLen_, 0);
+    ctx->tokenTypeIds.assign(rows * maxSeqLen_, 0);
+    ctx->hiddenStates.assign(rows * maxSeqLen_ * hiddenDim_, 0.0f);
+    return ctx;
+}
+
+void EmbeddingEngine::releaseBatch(std::unique_ptr<BatchContext> ctx) {
+    std::lock_guard<std::mutex> lock(contextMutex_);
+    if (ctx->rows == maxBatch_) idleBatches_.push_back(std::move(ctx));
+}
+
+bool EmbeddingEngine::embedTokens(const int64_t* inputIds, const int64_t* attentionMask,
+                                  size_t seq, float* out) {
+    if (!warmUp() || static_ || seq > maxSeqLen_) return false;
+
+    std::unique_ptr<InferenceContext> ctx = acquireContext();
+    // hand the context back even if Run throws
+    struct Lease {
+        EmbeddingEngine& engine;
+        std::unique_ptr<InferenceContext>& ctx;
+        ~Lease() { engine.releaseContext(std::move(ctx)); }
+    } lease{*this, ctx};
+
+    std::copy(inputIds, inputIds + seq, ctx->inputIds.begin());
+    std::copy(attentionMask, attentionMask + seq, ctx->attentionMask.begin());
+    std::fill(ctx->inputIds.begin() + static_cast<long>(seq), ctx->inputIds.end(), 0);
+    std::fill(ctx->attentionMask.begin() + static_cast<long>(seq), ctx->attentionMask.end(), 0);
+
+    {
+        STAGE_TIMER("embed.onnx_run");
+        session.Run(ctx->runOptions, ctx->binding);
+    }
+
+    STAGE_TIMER("embed.pooling");
+    VectorMath::maskedMeanPoolNormalize(ctx->hiddenStates.data(), ctx->attentionMask.data(),
+                                        maxSeqLen_, hiddenDim_, out);
+    return true;
 }
 
 std::vector<float> EmbeddingEngine::createEmbedding(const std::string& text) {
+    if (!warmUp()) return {};
+    STAGE_TIMER("embed");
+
+    if (static_) {
+        std::vector<float> pooled(hiddenDim_);
+        if (!static_->embed(text, pooled.data())) return {};
+        return pooled;
+    }
     if (!tok_) return {};
 
-    // 1) tokenize
     auto T = tok_->encode(text);
     if (!T) return {};
 
-    const int64_t seq = (int64_t)T->input_ids.size(); // 256
-    // 2) build ONNX tensors
-    Ort::MemoryInfo mem = Ort::MemoryInfo::CreateCpu(OrtArenaAllocator, OrtMemTypeDefault);
-    std::vector<int64_t> shape{1, seq};
+    std::vector<float> pooled(hiddenDim_);
+    if (!embedTokens(T->input_ids.data(), T->attention_mask.data(), T->input_ids.size(), pooled.data()))
+        return {};
+    return pooled; // length should be 384
+}
 
-    std::vector<int64_t> input_ids = T->input_ids;
-    std::vector<int64_t> attention_mask = T->attention_mask;
-    std::vector<int64_t> token_type_ids(seq, 0);
+bool EmbeddingEngine::embedTokensBatch(const int64_t* inputIds, const int64_t* attentionMask,
+                                       size_t batch, size_t maxLen, size_t seq, float* out) {
+    if (!warmUp() || static_ || seq == 0 || seq > maxLen || seq > maxSeqLen_) return false;
+    STAGE_TIMER("embed.batch_run");
 
-    Ort::Value idsT  = Ort::Value::CreateTensor<int64_t>(mem, input_ids.data(), input_ids.size(), shape.data(), shape.size());
-    Ort::Value masT  = Ort::Value::CreateTensor<int64_t>(mem, attention_mask.data(), attention_mask.size(), shape.data(), shape.size());
-    Ort::Value ttiT  = Ort::Value::CreateTensor<int64_t>(mem, token_type_ids.data(), token_type_ids.size(), shape.data(), shape.size());
+    std::unique_ptr<BatchContext> ctx = acquireBatch();
+    struct Lease {
+        EmbeddingEngine& engine;
+        std::unique_ptr<BatchContext>& ctx;
+        ~Lease() { engine.releaseBatch(std::move(ctx)); }
+    } lease{*this, ctx};
 
-    // 3) map names -> tensors (robust to different ordering)
+    Ort::MemoryInfo mem = Ort::MemoryInfo::CreateCpu(OrtArenaAllocator, OrtMemTypeDefault);
+    const char* outName = outputNamesOwned_[0].c_str();
     std::vector<const char*> inNames;
-    std::vector<Ort::Value>  inVals;
-    for (auto& n : inputNamesOwned_) {
-        if (n.find("input_ids") != std::string::npos) {
-            inNames.push_back(n.c_str());
-            inVals.emplace_back(std::move(idsT));
-        } else if (n.find("attention_mask") != std::string::npos) {
-            inNames.push_back(n.c_str());
-            inVals.emplace_back(std::move(masT));
-        } else if (n.find("token_type_ids") != std::string::npos) {
+    std::vector<Ort::Value> inValues;
+
+    // a batch larger than the buffers runs ctx->rows at a time
+    for (size_t first = 0; first < batch; first += ctx->rows) {
+        const size_t rows = std::min(ctx->rows, batch - first);
+        const size_t count = rows * seq;
+        for (size_t b = 0; b < rows; ++b) {
+            const size_t row = (first + b) * maxLen;
+            std::copy(inputIds + row, inputIds + row + seq, ctx->inputIds.begin() + static_cast<long>(b * seq));
+            std::copy(attentionMask + row, attentionMask + row + seq, ctx->attentionMask.begin() + static_cast<long>(b * seq));
+        }
+
+        const int64_t inShape[2]  = {static_cast<int64_t>(rows), static_cast<int64_t>(seq)};
+        const int64_t outShape[3] = {static_cast<int64_t>(rows), static_cast<int64_t>(seq), static_cast<int64_t>(hiddenDim_)};
+        inNames.clear();
+        inValues.clear();
+        for (auto& n : inputNamesOwned_) {
+            std::vector<int64_t>* src = nullptr;
+            if (n.find("input_ids") != std::string::npos)           src = &ctx->inputIds;
+            else if (n.find("attention_mask") != std::string::npos) src = &ctx->attentionMask;
+            else if (n.find("token_type_ids") != std::string::npos) src = &ctx->tokenTypeIds;
+            if (!src) continue;
             inNames.push_back(n.c_str());
-            inVals.emplace_back(std::move(ttiT));
+            inValues.push_back(Ort::Value::CreateTensor<int64_t>(mem, src->data(), count, inShape, 2));
+        }
+        Ort::Value hiddenT = Ort::Value::CreateTensor<float>(mem, ctx->hiddenStates.data(), count * hiddenDim_, outShape, 3);
+
+        try {
+            session.Run(Ort::RunOptions{nullptr}, inNames.data(), inValues.data(), inValues.size(),
+                        &outName, &hiddenT, 1);
+        } catch (const Ort::Exception& e) {
+            std::cerr << "[ONNX] Batch of " << rows << " failed: " << e.what() << std::endl;
+            return false;
         }
-    }   
-    std::vector<const char*> outNames;
-    outNames.reserve(outputNamesOwned_.size());
-    for (auto& n : outputNamesOwned_) outNames.push_back(n.c_str());
-
-    // 4) run
-    auto outs = session.Run(Ort::RunOptions{nullptr},
-                            inNames.data(), inVals.data(), inVals.size(),
-                            outNames.data(), outNames.size());
-
-    // 5) expect last_hidden_state [1, seq, 384] → masked mean‑pool
-    auto& out = outs[0];
-    auto info = out.GetTensorTypeAndShapeInfo();
-    auto shp  = info.GetShape(); // [1, seq, hidden]
-    if (shp.size() != 3 || shp[0] != 1) return {};
-    const int64_t hidden = shp[2];
-
-    const float* H = out.GetTensorData<float>(); // size seq*hidden
-    std::vector<float> pooled(hidden, 0.0f);
-    double denom = 0.0;
-
-    for (int64_t t = 0; t < seq; ++t) {
-        if (attention_mask[t] == 0) continue;
-        const float* row = H + t * hidden;
-        for (int64_t h = 0; h < hidden; ++h) pooled[h] += row[h];
-        denom += 1.0;
+
+        for (size_t b = 0; b < rows; ++b)
+            VectorMath::maskedMeanPoolNormalize(ctx->hiddenStates.data() + b * seq * hiddenDim_,
+                                                ctx->attentionMask.data() + b * seq,
+                                                seq, hiddenDim_, out + (first + b) * hiddenDim_);
     }
-    if (denom < 1e-6) denom = 1.0;
-    for (int64_t h = 0; h < hidden; ++h) pooled[h] = static_cast<float>(pooled[h] / denom);
+    return true;
+}
 
-    // 6) L2‑normalize
-    double norm = 0.0;
-    for (float v : pooled) norm += double(v) * double(v);
-    norm = std::sqrt(std::max(norm, 1e-12));
-    for (auto& v : pooled) v = float(v / norm);
+std::vector<std::vector<float>> EmbeddingEngine::createEmbeddings(const std::vector<std::string>& texts) {
+    // the static table is a lookup per token, there is no pass to share
+    if (texts.size() <= 1 || !warmUp() || !tok_) return Embedder::createEmbeddings(texts);
+    STAGE_TIMER("embed.batch");
 
-    return pooled; // length should be 384
-}
\ No newline at end of file
+    auto T = tok_->encodeBatch(texts);
+    if (!T) return Embedder::createEmbeddings(texts);   // one bad text shouldn't sink the others
+
+    // every row comes back padded to maxSeqLen_; the model only needs the longest real one
+    const size_t batch = texts.size();
+    std::vector<int64_t> ids(batch * maxSeqLen_), mask(batch * maxSeqLen_);
+    size_t seq = 1;
+    for (size_t b = 0; b < batch; ++b) {
+        const auto& r = (*T)[b];
+        std::copy(r.input_ids.begin(), r.input_ids.end(), ids.begin() + static_cast<long>(b * maxSeqLen_));
+        std::copy(r.attention_mask.begin(), r.attention_mask.end(), mask.begin() + static_cast<long>(b * maxSeqLen_));
+        for (size_t i = r.attention_mask.size(); i > seq; --i)
+            if (r.attention_mask[i - 1]) { seq = i; break; }
+    }
+
+    std::vector<float> pooled(batch * hiddenDim_);
+    if (!embedTokensBatch(ids.data(), mask.data(), batch, maxSeqLen_, seq, pooled.data()))
+        return Embedder::createEmbeddings(texts);
+
+    std::vector<std::vector<float>> out(batch);
+    for (size_t b = 0; b < batch; ++b)
+        out[b].assign(pooled.begin() + static_cast<long>(b * hiddenDim_),
+                      pooled.begin() + static_cast<long>((b + 1) * hiddenDim_));
+    return out;
+}
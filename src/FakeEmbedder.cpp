@@ -0,0 +1,40 @@
+#include "FakeEmbedder.hpp"
+#include "VectorMath.hpp"
+
+#include <cctype>
+#include <cstdint>
+
+FakeEmbedder::FakeEmbedder(size_t dimension)
+    : dim_(dimension) {}
+
+std::vector<float> FakeEmbedder::createEmbedding(const std::string& text){
+    std::vector<float> v(dim_, 0.0f);
+    if (dim_ == 0) return v;
+
+    // every word adds +-1 to three buckets picked from its FNV-1a hash
+    auto addWord = [&](uint64_t h){
+        for (int k = 0; k < 3; ++k) {
+            v[h % dim_] += (h & (uint64_t(1) << 63)) ? -1.0f : 1.0f;
+            h = h * 6364136223846793005ull + 1442695040888963407ull;
+        }
+    };
+
+    uint64_t h = 1469598103934665603ull;
+    bool inWord = false;
+    for (char c : text) {
+        unsigned char u = static_cast<unsigned char>(c);
+        if (std::isalnum(u)) {
+            h ^= static_cast<uint64_t>(std::tolower(u));
+            h *= 1099511628211ull;
+            inWord = true;
+        } else if (inWord) {
+            addWord(h);
+            h = 1469598103934665603ull;
+            inWord = false;
+        }
+    }
+    if (inWord) addWord(h);
+
+    VectorMath::l2Normalize(v.data(), v.size());
+    return v;
+}
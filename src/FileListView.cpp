@@ -0,0 +1,57 @@
+/*Paged file list
+--page p starts right after the last path of page p-1; when that page is not cached
+  (scrollbar jump) the start key is looked up once by offset, then paging is keyset again
+--cache keeps at most maxPages pages, dropping the ones farthest from the current page*/
+
+#include "FileListView.hpp"
+
+#include <cstdlib>
+#include <iterator>
+
+FileListView::FileListView(DatabaseManager& manager, int pageSize, size_t maxPages)
+    : manager(manager), pageSize(pageSize), maxPages(maxPages)
+{
+    refresh();
+}
+
+void FileListView::setFilter(const std::string& match){
+    if (match == match_) return;
+    match_ = match;
+    refresh();
+}
+
+void FileListView::refresh(){
+    pages_.clear();
+    total_ = manager.countFiles(match_);
+}
+
+const FileRow* FileListView::row(long long i){
+    if (i < 0 || i >= total_) return nullptr;
+    const auto& rows = page(i / pageSize);
+    size_t at = static_cast<size_t>(i % pageSize);
+    return at < rows.size() ? &rows[at] : nullptr;
+}
+
+const std::vector<FileRow>& FileListView::page(long long p){
+    auto it = pages_.find(p);
+    if (it != pages_.end()) return it->second;
+
+    std::string after;
+    if (p > 0) {
+        auto prev = pages_.find(p - 1);
+        if (prev != pages_.end() && !prev->second.empty()) after = prev->second.back().path;
+        else after = manager.pathAtOffset(p * pageSize - 1, match_);
+    }
+
+    evictAround(p);
+    if (p > 0 && after.empty()) return pages_[p]; //rows went away since the count
+    return pages_[p] = manager.listFilesAfter(after, pageSize, match_);
+}
+
+void FileListView::evictAround(long long p){
+    while (pages_.size() >= maxPages) {
+        auto lo = pages_.begin();
+        auto hi = std::prev(pages_.end());
+        pages_.erase(std::llabs(lo->first - p) >= std::llabs(hi->first - p) ? lo : hi);
+    }
+}
@@ -3,11 +3,15 @@
 //including the file scanner and the file system 
 //Filesystem gives a standerdized way of interacting with the files using paths
 #include "FileScanner.hpp"
+#include "Metrics.hpp"
 #include <filesystem>
 
 namespace fs = std::filesystem;
 
 std::vector<FileInfo> FileScanner::scanDirectory(const std::string& directoryPath){
+    STAGE_TIMER("scan");
+    static Counter& scanned = Metrics::instance().counter("scan.files");
+
     //define the array for files 
     std::vector<FileInfo> files;
 
@@ -26,5 +30,6 @@ std::vector<FileInfo> FileScanner::scanDirectory(const std::string& directoryPat
         }
     }
 
+    scanned.add(files.size());
     return files;
 }
\ No newline at end of file
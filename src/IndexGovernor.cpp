@@ -0,0 +1,304 @@
+/*Index governor
+--sample(): process CPU (self + reaped children from getrusage + live descendants from
+  /proc, or one core per busy worker where there is no /proc) over the interval,
+  load average minus our own smoothed use, resident size; then at most one change:
+  memory over -> one worker less, CPU over -> one worker less (or a longer gap at one),
+  CPU well under -> shorter gap, then one worker more once all allowed ones are busy
+--admit(): waits on the same condition variable the sampler and released tickets
+  signal; waits are capped at one interval so a set stop flag is seen promptly
+--I/O: token bucket of one second's budget; a file bigger than the bucket is let
+  through on a full bucket and leaves it in debt*/
+
+#include "IndexGovernor.hpp"
+#include "Metrics.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <cctype>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <unordered_map>
+#include <vector>
+#include <sys/resource.h>
+#include <unistd.h>
+#ifdef __APPLE__
+#include <mach/mach.h>
+#include <pthread.h>
+#else
+#include <sys/syscall.h>
+#endif
+
+// CPU seconds of our live descendants (pdftotext, tesseract, ImageMagick and the shells
+// around them): RUSAGE_CHILDREN only has a child once it is reaped, so a running OCR job
+// would otherwise look like another process's load. -1 where /proc is not available
+static double liveChildCpuSeconds(){
+#ifdef __linux__
+    const pid_t self = ::getpid();
+    std::unordered_map<pid_t, std::vector<pid_t>> children;
+    std::unordered_map<pid_t, unsigned long long> ticks;
+    std::error_code ec;
+    for (const auto& entry : std::filesystem::directory_iterator("/proc", ec)) {
+        const std::string name = entry.path().filename().string();
+        if (name.empty() || !std::isdigit(static_cast<unsigned char>(name[0]))) continue;
+        std::ifstream in(entry.path() / "stat");
+        std::string stat;
+        if (!std::getline(in, stat)) continue;
+        // the command name is in parentheses and may hold spaces; fields resume after ')'
+        const size_t close = stat.rfind(')');
+        if (close == std::string::npos) continue;
+        std::istringstream fields(stat.substr(close + 1));
+        std::string state;
+        long long ppid = 0;
+        unsigned long long skip = 0, utime = 0, stime = 0, cutime = 0, cstime = 0;
+        fields >> state >> ppid;
+        for (int i = 0; i < 9; ++i) fields >> skip;   // pgrp .. cmajflt
+        if (!(fields >> utime >> stime >> cutime >> cstime)) continue;
+        const pid_t pid = static_cast<pid_t>(std::stol(name));
+        children[static_cast<pid_t>(ppid)].push_back(pid);
+        // cutime/cstime: descendants that process already reaped, gone from the tree
+        ticks[pid] = utime + stime + cutime + cstime;
+    }
+    if (ec) return -1.0;
+
+    unsigned long long total = 0;
+    std::vector<pid_t> stack(children[self].begin(), children[self].end());
+    while (!stack.empty()) {
+        const pid_t pid = stack.back();
+        stack.pop_back();
+        total += ticks[pid];
+        auto it = children.find(pid);
+        if (it != children.end()) stack.insert(stack.end(), it->second.begin(), it->second.end());
+    }
+    return static_cast<double>(total) / static_cast<double>(::sysconf(_SC_CLK_TCK));
+#else
+    return -1.0;
+#endif
+}
+
+// self + reaped children + live descendants; live is false when the last part is unknown
+static double processCpuSeconds(bool& live){
+    rusage self{}, children{};
+    ::getrusage(RUSAGE_SELF, &self);
+    ::getrusage(RUSAGE_CHILDREN, &children);
+    auto seconds = [](const timeval& t) { return static_cast<double>(t.tv_sec) + static_cast<double>(t.tv_usec) / 1e6; };
+    const double running = liveChildCpuSeconds();
+    live = running >= 0.0;
+    return seconds(self.ru_utime) + seconds(self.ru_stime) + seconds(children.ru_utime) + seconds(children.ru_stime) +
+           std::max(0.0, running);
+}
+
+static size_t residentMb(){
+#ifdef __APPLE__
+    mach_task_basic_info info;
+    mach_msg_type_number_t count = MACH_TASK_BASIC_INFO_COUNT;
+    if (task_info(mach_task_self(), MACH_TASK_BASIC_INFO, reinterpret_cast<task_info_t>(&info), &count) != KERN_SUCCESS)
+        return 0;
+    return static_cast<size_t>(info.resident_size >> 20);
+#else
+    std::ifstream statm("/proc/self/statm");
+    size_t pages = 0, resident = 0;
+    if (!(statm >> pages >> resident)) return 0;
+    return (resident * static_cast<size_t>(::sysconf(_SC_PAGESIZE))) >> 20;
+#endif
+}
+
+IndexGovernor::IndexGovernor(const GovernorLimits& limits)
+    : limits_(limits),
+      maxWorkers_(limits.maxWorkers > 0 ? limits.maxWorkers
+                                        : std::max(1, static_cast<int>(std::thread::hardware_concurrency() / 2))),
+      cores_(std::max(1u, std::thread::hardware_concurrency()))
+{
+    // with a CPU share, start at the worker count that share roughly pays for
+    allowed_ = maxWorkers_;
+    if (limits_.cpuShare > 0.0)
+        allowed_ = std::clamp(static_cast<int>(std::ceil(limits_.cpuShare * cores_)), 1, maxWorkers_);
+    Metrics::instance().gauge("index.workers_allowed").set(allowed_);
+
+    ioCredit_   = limits_.ioMBps * 1048576.0;
+    ioRefilled_ = sampledAt_ = Clock::now();
+    bool live = false;
+    cpuSeconds_ = processCpuSeconds(live);
+
+    sampler_ = std::thread([this] {
+        std::unique_lock<std::mutex> lock(mutex_);
+        while (!stopping_) {
+            changed_.wait_for(lock, kInterval, [this] { return stopping_.load(); });
+            if (stopping_) break;
+            lock.unlock();
+            sample();
+            lock.lock();
+        }
+    });
+}
+
+IndexGovernor::~IndexGovernor(){
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stopping_ = true;
+    }
+    changed_.notify_all();
+    sampler_.join();
+}
+
+IndexGovernor::Ticket& IndexGovernor::Ticket::operator=(Ticket&& other) noexcept{
+    if (this != &other) {
+        release();
+        owner_ = other.owner_;
+        other.owner_ = nullptr;
+    }
+    return *this;
+}
+
+void IndexGovernor::Ticket::release(){
+    if (owner_) owner_->releaseTicket();
+    owner_ = nullptr;
+}
+
+void IndexGovernor::releaseTicket(){
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        --busy_;
+    }
+    changed_.notify_all();
+}
+
+IndexGovernor::Ticket IndexGovernor::admit(uint64_t bytes, const std::atomic<bool>& stop){
+    const double rate = limits_.ioMBps * 1048576.0;
+    std::unique_lock<std::mutex> lock(mutex_);
+    for (;;) {
+        if (stop.load() || stopping_) return Ticket();
+        const Clock::time_point now = Clock::now();
+        if (rate > 0.0) {
+            ioCredit_ = std::min(rate, ioCredit_ + rate * std::chrono::duration<double>(now - ioRefilled_).count());
+            ioRefilled_ = now;
+        }
+
+        Clock::time_point until = now + kInterval;
+        bool throttled = false;
+        if (!paused_ && busy_ < allowed_) {
+            if (now < nextStart_) {
+                until = std::min(until, nextStart_);
+                throttled = true;
+            } else if (rate > 0.0 && ioCredit_ < 0.0) {
+                until = std::min(until, now + std::chrono::microseconds(static_cast<long long>(-ioCredit_ / rate * 1e6)));
+                throttled = true;
+            } else {
+                ++busy_;
+                if (rate > 0.0) ioCredit_ -= static_cast<double>(bytes);
+                nextStart_ = now + gap_;
+                return Ticket(this);
+            }
+        }
+        changed_.wait_until(lock, until);
+        if (throttled) stats_.throttledSeconds += std::chrono::duration<double>(Clock::now() - now).count();
+    }
+}
+
+void IndexGovernor::enterWorker() const{
+    if (!limits_.lowPriority) return;
+#ifdef __APPLE__
+    // per-thread QoS and disk policy; children get taskpolicy -b through commandPrefix()
+    pthread_set_qos_class_self_np(QOS_CLASS_UTILITY, 0);
+    setiopolicy_np(IOPOL_TYPE_DISK, IOPOL_SCOPE_THREAD, IOPOL_THROTTLE);
+#else
+    // nice and I/O priority are per thread on Linux and inherited by the processes it starts
+    const int tid = static_cast<int>(::syscall(SYS_gettid));
+    ::setpriority(PRIO_PROCESS, static_cast<id_t>(tid), 10);
+    // IOPRIO_WHO_PROCESS, best-effort class (2 << IOPRIO_CLASS_SHIFT) at its lowest level (7)
+    ::syscall(SYS_ioprio_set, 1, tid, (2 << 13) | 7);
+#endif
+}
+
+std::string IndexGovernor::commandPrefix(const GovernorLimits& limits){
+#ifdef __APPLE__
+    return limits.lowPriority ? "taskpolicy -b " : "";
+#else
+    (void)limits;
+    return "";
+#endif
+}
+
+int IndexGovernor::allowed() const{
+    std::lock_guard<std::mutex> lock(mutex_);
+    return allowed_;
+}
+
+GovernorStats IndexGovernor::stats() const{
+    std::lock_guard<std::mutex> lock(mutex_);
+    GovernorStats s = stats_;
+    s.workers = maxWorkers_;
+    s.allowed = allowed_;
+    s.paused  = paused_;
+    if (paused_) s.pausedSeconds += std::chrono::duration<double>(Clock::now() - pausedSince_).count();
+    return s;
+}
+
+void IndexGovernor::setAllowed(int allowed){
+    if (allowed == allowed_) return;
+    allowed_ = allowed;
+    ++stats_.adjustments;
+    Metrics::instance().gauge("index.workers_allowed").set(allowed_);
+}
+
+void IndexGovernor::sample(){
+    const Clock::time_point now = Clock::now();
+    bool live = false;
+    const double cpu = processCpuSeconds(live);
+    const double dt = std::chrono::duration<double>(now - sampledAt_).count();
+    if (dt <= 0.0) return;
+    const double cores = (cpu - cpuSeconds_) / dt;
+    const size_t rss = residentMb();
+
+    double load[1] = {0.0};
+    const bool haveLoad = ::getloadavg(load, 1) == 1;
+
+    bool wake = false;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        sampledAt_  = now;
+        cpuSeconds_ = cpu;
+        // the load average is a one minute exponential average; smooth our own use the same way
+        ownCores_ += (cores - ownCores_) * (1.0 - std::exp(-dt / 60.0));
+        const double share = cores / cores_;
+        // without live child accounting, count every busy worker's extractor as ours
+        const double ownLoad = ownCores_ + (live ? 0.0 : static_cast<double>(busy_));
+        const double other = haveLoad ? std::max(0.0, load[0] - ownLoad) / cores_ : 0.0;
+        stats_.cpuShare  = share;
+        stats_.otherLoad = other;
+        stats_.rssMb     = rss;
+
+        if (limits_.pauseLoad > 0.0) {
+            if (!paused_ && other > limits_.pauseLoad) {
+                paused_ = true;
+                pausedSince_ = now;
+                std::cerr << "[governor] pausing indexing: other processes keep " << other << " of each core busy\n";
+            } else if (paused_ && other < limits_.pauseLoad * 0.7) {
+                paused_ = false;
+                stats_.pausedSeconds += std::chrono::duration<double>(now - pausedSince_).count();
+                std::cerr << "[governor] resuming indexing\n";
+                wake = true;
+            }
+        }
+
+        const bool overMemory = limits_.maxRssMb && rss > limits_.maxRssMb;
+        const bool nearMemory = limits_.maxRssMb && rss * 10 > limits_.maxRssMb * 9;
+        const bool overCpu    = limits_.cpuShare > 0.0 && share > limits_.cpuShare;
+        const bool underCpu   = limits_.cpuShare <= 0.0 || share < limits_.cpuShare * 0.8;
+        if (overMemory && allowed_ > 1) {
+            setAllowed(allowed_ - 1);
+        } else if (overCpu) {
+            if (allowed_ > 1) setAllowed(allowed_ - 1);
+            else gap_ = std::min<std::chrono::microseconds>(std::chrono::seconds(2),
+                                                            std::max<std::chrono::microseconds>(std::chrono::milliseconds(50), gap_ * 2));
+        } else if (underCpu && gap_.count() > 0) {
+            gap_ = gap_.count() < 20000 ? std::chrono::microseconds(0) : gap_ / 2;
+        } else if (underCpu && !nearMemory && allowed_ < maxWorkers_ && busy_ >= allowed_) {
+            setAllowed(allowed_ + 1);
+            wake = true;
+        }
+    }
+    if (wake) changed_.notify_all();
+}
@@ -0,0 +1,330 @@
+/*Indexing loop (was duplicated in main.cpp and gui_main.cpp)
+--scan, filter by extension, extract, embed, insert
+--reports every file through onFile so callers decide what to print
+--with a scheduler, each file takes a Background slot after extraction and yields it
+  to queued queries between the embedding and the insert
+--with a journal: the plan is stored first, every batch bumps its files' attempts in
+  one commit and stores them plus their "done" rows in the next. A file that was in
+  flight when a run died is retried on its own, and quarantined once it has been
+  started maxStrikes times without finishing
+--with a governor, a batch's texts are extracted on its worker threads while this thread
+  embeds and stores them in plan order
+--before embedding, the text's SimHash is looked up in the file's database; the closest
+  representative within duplicateDistance lends its stored vector, so no model run*/
+
+#include "Indexer.hpp"
+#include "Metrics.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <exception>
+#include <filesystem>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <utility>
+#include <vector>
+
+Indexer::Indexer(DatabaseManager& manager, ContextExtractor& extractor, Embedder& embedder)
+    : journal(&manager), route([&manager](const FileInfo&) { return &manager; }),
+      extractor(extractor), embedder(embedder) {}
+
+Indexer::Indexer(Router route, ContextExtractor& extractor, Embedder& embedder)
+    : route(std::move(route)), extractor(extractor), embedder(embedder) {}
+
+// Extraction of one batch on the governor's workers. Files are started in plan order and
+// at most two per worker ahead of the one being stored, so finished texts don't pile up
+// while the embedding catches up.
+class Indexer::ParallelExtraction{
+    public:
+        ParallelExtraction(Indexer& indexer, const std::vector<FileInfo>& files)
+            : indexer_(indexer), files_(files), results_(files.size()),
+              errors_(files.size()), ready_(files.size(), false)
+        {
+            const int workers = std::min(indexer.governor->maxWorkers(), static_cast<int>(files.size()));
+            for (int w = 0; w < workers; ++w) threads_.emplace_back([this] { run(); });
+        }
+
+        ~ParallelExtraction(){
+            {
+                std::lock_guard<std::mutex> lock(mutex_);
+                stop_ = true;
+            }
+            changed_.notify_all();
+            for (auto& t : threads_) t.join();
+        }
+
+        //blocks until file i is extracted; rethrows what its extraction threw
+        Extraction take(size_t i){
+            std::unique_lock<std::mutex> lock(mutex_);
+            wanted_ = i;
+            changed_.notify_all();
+            changed_.wait(lock, [&] { return ready_[i]; });
+            if (errors_[i]) std::rethrow_exception(errors_[i]);
+            return std::move(results_[i]);
+        }
+
+    private:
+        Indexer& indexer_;
+        const std::vector<FileInfo>& files_;
+        std::vector<Extraction> results_;
+        std::vector<std::exception_ptr> errors_;
+        std::vector<bool> ready_;
+
+        std::mutex mutex_;
+        std::condition_variable changed_;
+        size_t next_ = 0;     //next file a worker picks up
+        size_t wanted_ = 0;   //file the indexing thread waits for
+        std::atomic<bool> stop_{false};
+        std::vector<std::thread> threads_;
+
+        void run(){
+            IndexGovernor& governor = *indexer_.governor;
+            governor.enterWorker();
+            const size_t ahead = 2 * static_cast<size_t>(governor.maxWorkers());
+            for (;;) {
+                size_t i = 0;
+                {
+                    std::unique_lock<std::mutex> lock(mutex_);
+                    changed_.wait(lock, [&] { return stop_ || next_ >= files_.size() || next_ < wanted_ + ahead; });
+                    if (stop_ || next_ >= files_.size()) return;
+                    i = next_++;
+                }
+
+                std::error_code ec;
+                const uintmax_t bytes = std::filesystem::file_size(files_[i].path, ec);
+                IndexGovernor::Ticket ticket = governor.admit(ec ? 0 : static_cast<uint64_t>(bytes), stop_);
+                if (!ticket.held()) return;   // stopping
+
+                Extraction result;
+                std::exception_ptr error;
+                try {
+                    result = indexer_.extract(files_[i]);
+                } catch (...) {
+                    error = std::current_exception();
+                }
+                ticket.release();
+
+                {
+                    std::lock_guard<std::mutex> lock(mutex_);
+                    results_[i] = std::move(result);
+                    errors_[i]  = error;
+                    ready_[i]   = true;
+                }
+                changed_.notify_all();
+            }
+        }
+};
+
+int Indexer::indexDirectory(const std::string& directoryPath){
+    Metrics& metrics = Metrics::instance();
+    Counter& indexed     = metrics.counter("index.files_indexed");
+    Counter& unchanged   = metrics.counter("index.files_unchanged");
+    Counter& noText      = metrics.counter("index.files_no_text");
+    Counter& failed      = metrics.counter("index.files_embed_failed");
+    Counter& quarantined = metrics.counter("index.files_quarantined");
+
+    // the plan: what is left of an interrupted run, or a fresh scan
+    long long run = 0;
+    bool resumed = false;
+    std::vector<JournalEntry> plan;
+    if (journal) {
+        const std::string root = std::filesystem::absolute(directoryPath).lexically_normal().string();
+        run = journal->openIndexRun(root, resume, resumed);
+    }
+    if (resumed) {
+        plan = journal->pendingIndexFiles(run);
+        std::cerr << "[index] resuming an interrupted run: " << plan.size() << " files left\n";
+    } else {
+        FileScanner scanner;
+        for (auto& file : scanner.scanDirectory(directoryPath))
+            if (isCorrectFileType(file.extension))
+                plan.push_back({std::move(file.path), std::move(file.name), std::move(file.extension), 0});
+        if (run && !journal->planIndexRun(run, plan)) run = 0;   // no journal, still index
+    }
+    if (onDiscovered) onDiscovered(static_cast<int>(plan.size()));
+
+    int indexCount = 0;
+    const size_t batch = static_cast<size_t>(std::max(1, batchSize));
+    for (size_t i = 0; i < plan.size();) {
+        // files that were in flight when a run died go one at a time, so a repeat crash
+        // is pinned on the file that caused it
+        size_t end = i + 1;
+        if (plan[i].attempts == 0)
+            while (end < plan.size() && end - i < batch && plan[end].attempts == 0) ++end;
+
+        if (run) {
+            std::vector<std::string> paths;
+            for (size_t j = i; j < end; ++j) paths.push_back(plan[j].path);
+            journal->markIndexAttempt(run, paths);   // durable before any of them is touched
+        }
+
+        std::vector<Pending> pending;
+        bool batchOpen = false;
+        try {
+            // on this thread first: everything that needs the database but not the text
+            std::vector<FileInfo> toExtract;
+            for (size_t j = i; j < end; ++j) {
+                const JournalEntry& entry = plan[j];
+                Pending p;
+                p.file = FileInfo{entry.name, entry.extension, entry.path};
+                p.manager = route(p.file);
+                p.lastModified = getLastModified(p.file.path);
+                if (!p.manager || p.lastModified == 0) {   // routed elsewhere, or gone since the scan
+                    p.manager = nullptr;
+                } else if (run && entry.attempts >= maxStrikes) {
+                    p.manager->strikeFile(p.file.path, p.lastModified, maxStrikes, "indexing crashed or was killed " +
+                                          std::to_string(entry.attempts) + " times");
+                    p.outcome = IndexOutcome::Quarantined;
+                } else if (p.manager->isQuarantined(p.file.path, p.lastModified, maxStrikes)) {
+                    p.outcome = IndexOutcome::Quarantined;
+                } else if (!p.manager->isUpToDate(p.file.path, static_cast<long>(p.lastModified))) {
+                    // unchanged files are skipped before the expensive part
+                    p.extraction = static_cast<int>(toExtract.size());
+                    toExtract.push_back(p.file);
+                }
+                pending.push_back(std::move(p));
+            }
+
+            // extraction, OCR, embedding and governor pauses all happen before the batch
+            // opens, so other writers (and other processes) only wait for the inserts
+            std::unique_ptr<ParallelExtraction> parallel;
+            if (governor && !toExtract.empty()) parallel = std::make_unique<ParallelExtraction>(*this, toExtract);
+            for (size_t k = 0; k < pending.size(); ++k) {
+                Pending& p = pending[k];
+                if (!p.manager || p.extraction < 0) continue;
+                STAGE_TIMER("index.file");
+                Extraction text = parallel ? parallel->take(static_cast<size_t>(p.extraction)) : extract(p.file);
+                prepare(pending, k, text);
+            }
+
+            if (run) batchOpen = journal->beginBatch();
+            for (size_t k = 0; k < pending.size(); ++k) {
+                if (pending[k].manager && pending[k].extraction >= 0) pending[k].outcome = store(pending, k);
+                if (run) journal->markIndexDone(run, pending[k].file.path);
+            }
+            i = end;
+        } catch (...) {
+            // the attempts are already committed; the next --resume retries these files alone
+            if (batchOpen) journal->rollbackBatch();
+            throw;
+        }
+        if (batchOpen) journal->commitBatch();
+
+        for (const auto& p : pending) {
+            if (!p.manager) continue;
+            switch (p.outcome) {
+                case IndexOutcome::Indexed:         ++indexCount; indexed.add(); break;
+                case IndexOutcome::Unchanged:       unchanged.add(); break;
+                case IndexOutcome::NoText:          noText.add(); break;
+                case IndexOutcome::EmbeddingFailed: failed.add(); break;
+                case IndexOutcome::Quarantined:     quarantined.add(); break;
+            }
+            if (onFile) onFile(p.file, p.outcome);
+        }
+    }
+
+    if (run) journal->finishIndexRun(run);
+    return indexCount;
+}
+
+Indexer::Extraction Indexer::extract(const FileInfo& file){
+    Extraction extracted;
+    auto started = std::chrono::steady_clock::now();
+    extracted.text = extractor.extractText(file.path);
+    extracted.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - started).count();
+    return extracted;
+}
+
+void Indexer::prepare(std::vector<Pending>& batch, size_t at, const Extraction& extracted){
+    Pending& p = batch[at];
+    DatabaseManager& manager = *p.manager;
+    if (extracted.seconds > slowFileSeconds)
+        manager.strikeFile(p.file.path, p.lastModified, 1, "extraction took " + std::to_string(static_cast<int>(extracted.seconds)) + " s");
+    if (extracted.text.empty()) {
+        p.outcome = IndexOutcome::NoText;
+        return;
+    }
+
+    p.signature = NearDuplicate::simhash(extracted.text);
+    if (duplicateDistance >= 0) {
+        int closest = duplicateDistance + 1;
+        std::string from;
+        for (const auto& match : manager.findSignatureMatches(p.signature)) {
+            const int d = NearDuplicate::distance(p.signature, match.simhash);
+            if (d < closest && match.path != p.file.path) {
+                closest = d;
+                p.representative = match.id;
+                from = match.path;
+            }
+        }
+        // files earlier in this batch are not stored yet; the ones that will represent a
+        // group count as well
+        for (size_t k = 0; k < at; ++k) {
+            const Pending& earlier = batch[k];
+            if (earlier.manager != p.manager || earlier.embedding.empty() || earlier.representative || earlier.sameBatch >= 0)
+                continue;
+            const int d = NearDuplicate::distance(p.signature, earlier.signature);
+            if (d < closest) {
+                closest = d;
+                p.sameBatch = static_cast<int>(k);
+            }
+        }
+        if (p.sameBatch >= 0) {
+            p.representative = 0;
+            p.embedding = batch[static_cast<size_t>(p.sameBatch)].embedding;
+        } else if (p.representative) {
+            p.embedding = manager.getEmbedding(from);
+            if (p.embedding.empty()) p.representative = 0;
+        }
+    }
+
+    if (!p.embedding.empty()) {
+        static Counter& reused = Metrics::instance().counter("index.embeddings_reused");
+        reused.add();
+        return;
+    }
+    TaskScheduler::Slot slot;
+    if (scheduler) slot = scheduler->acquire(TaskScheduler::Priority::Background);
+    p.embedding = embedder.createEmbedding(extracted.text);
+    if (p.embedding.empty()) p.outcome = IndexOutcome::EmbeddingFailed;
+}
+
+IndexOutcome Indexer::store(std::vector<Pending>& batch, size_t at){
+    Pending& p = batch[at];
+    if (p.embedding.empty()) return p.outcome;   // no text, or the embedding failed
+
+    TaskScheduler::Slot slot;
+    if (scheduler) slot = scheduler->acquire(TaskScheduler::Priority::Background);
+    if (!p.manager->insertFile(p.file.path, p.file.name, p.file.extension, p.embedding, p.lastModified))
+        return IndexOutcome::Unchanged;
+
+    // a representative from this batch has its row (and id) only now
+    if (p.sameBatch >= 0) {
+        const Pending& from = batch[static_cast<size_t>(p.sameBatch)];
+        for (const auto& match : p.manager->findSignatureMatches(from.signature))
+            if (match.path == from.file.path) p.representative = match.id;
+    }
+    p.manager->setSignature(p.file.path, p.signature, p.representative);
+    return IndexOutcome::Indexed;
+}
+
+bool Indexer::isCorrectFileType(const std::string& extension) {
+    return (extension == ".txt" || extension == ".pdf" || extension == ".png" ||
+            extension == ".jpg" || extension == ".jpeg");
+}
+
+// 0 when the file can't be stat'ed (e.g. deleted since the scan)
+std::time_t Indexer::getLastModified(const std::string& filePath) {
+    std::error_code ec;
+    auto ftime = std::filesystem::last_write_time(filePath, ec);
+    if (ec) return 0;
+    auto sctp = std::chrono::time_point_cast<std::chrono::system_clock::duration>(
+        ftime - std::filesystem::file_time_type::clock::now()
+        + std::chrono::system_clock::now()
+    );
+    return std::chrono::system_clock::to_time_t(sctp);
+}
@@ -0,0 +1,152 @@
+/*Metrics registry
+--instruments are created on first lookup and never freed, so references stay valid
+--histogram bucket = exponent * 4 + the two bits after the leading one
+--trace events are only collected while tracing is on*/
+
+#include "Metrics.hpp"
+
+#include <fstream>
+#include <functional>
+#include <thread>
+#include <unistd.h>
+
+// ─────────────────────────────────────────────────────────────────────────────
+// Histogram
+// ─────────────────────────────────────────────────────────────────────────────
+
+int Histogram::bucketFor(uint64_t nanos){
+    if (nanos < 4) return static_cast<int>(nanos);
+    int e = 63 - __builtin_clzll(nanos);
+    int sub = static_cast<int>((nanos >> (e - 2)) & 3);
+    return e * kSubBuckets + sub;
+}
+
+double Histogram::bucketMid(int bucket){
+    if (bucket < 4) return static_cast<double>(bucket);
+    int e = bucket / kSubBuckets;
+    int sub = bucket % kSubBuckets;
+    double lo = static_cast<double>(4 + sub) * static_cast<double>(uint64_t(1) << (e - 2));
+    double hi = static_cast<double>(5 + sub) * static_cast<double>(uint64_t(1) << (e - 2));
+    return (lo + hi) / 2.0;
+}
+
+void Histogram::record(uint64_t nanos){
+    buckets_[bucketFor(nanos)].fetch_add(1, std::memory_order_relaxed);
+    count_.fetch_add(1, std::memory_order_relaxed);
+    sum_.fetch_add(nanos, std::memory_order_relaxed);
+}
+
+double Histogram::percentile(double p) const{
+    uint64_t total = count();
+    if (total == 0) return 0.0;
+    uint64_t rank = static_cast<uint64_t>(p * static_cast<double>(total - 1)) + 1;
+
+    uint64_t seen = 0;
+    for (int b = 0; b < kBuckets; ++b) {
+        seen += buckets_[b].load(std::memory_order_relaxed);
+        if (seen >= rank) return bucketMid(b);
+    }
+    return bucketMid(kBuckets - 1);
+}
+
+// ─────────────────────────────────────────────────────────────────────────────
+// Registry
+// ─────────────────────────────────────────────────────────────────────────────
+
+Metrics::Metrics()
+    : origin_(std::chrono::steady_clock::now()) {}
+
+Metrics& Metrics::instance(){
+    static Metrics metrics;
+    return metrics;
+}
+
+template <class T>
+static T& lookup(std::map<std::string, std::unique_ptr<T>>& m, const std::string& name){
+    auto& slot = m[name];
+    if (!slot) slot = std::make_unique<T>();
+    return *slot;
+}
+
+Counter& Metrics::counter(const std::string& name){
+    std::lock_guard<std::mutex> lock(mutex_);
+    return lookup(counters_, name);
+}
+
+Gauge& Metrics::gauge(const std::string& name){
+    std::lock_guard<std::mutex> lock(mutex_);
+    return lookup(gauges_, name);
+}
+
+Histogram& Metrics::histogram(const std::string& name){
+    std::lock_guard<std::mutex> lock(mutex_);
+    return lookup(histograms_, name);
+}
+
+nlohmann::json Metrics::toJson() const{
+    std::lock_guard<std::mutex> lock(mutex_);
+    nlohmann::json out;
+    out["counters"] = nlohmann::json::object();
+    out["gauges"]   = nlohmann::json::object();
+    out["stages"]   = nlohmann::json::object();
+
+    for (const auto& [name, c] : counters_) out["counters"][name] = c->value();
+    for (const auto& [name, g] : gauges_)   out["gauges"][name]   = g->value();
+    for (const auto& [name, h] : histograms_) {
+        uint64_t n = h->count();
+        if (n == 0) continue;
+        out["stages"][name] = {
+            {"count",    n},
+            {"p50_ms",   h->percentile(0.50) / 1e6},
+            {"p95_ms",   h->percentile(0.95) / 1e6},
+            {"p99_ms",   h->percentile(0.99) / 1e6},
+            {"mean_ms",  static_cast<double>(h->sumNanos()) / static_cast<double>(n) / 1e6},
+            {"total_ms", static_cast<double>(h->sumNanos()) / 1e6},
+        };
+    }
+    return out;
+}
+
+bool Metrics::writeJson(const std::string& path) const{
+    std::ofstream out(path);
+    if (!out) return false;
+    out << toJson().dump(2) << "\n";
+    return static_cast<bool>(out);
+}
+
+void Metrics::traceEvent(const char* name, std::chrono::steady_clock::time_point start,
+                         std::chrono::steady_clock::time_point end){
+    using us = std::chrono::microseconds;
+    nlohmann::json ev = {
+        {"name", name},
+        {"cat",  "cortex"},
+        {"ph",   "X"},
+        {"ts",   std::chrono::duration_cast<us>(start - origin_).count()},
+        {"dur",  std::chrono::duration_cast<us>(end - start).count()},
+        {"pid",  static_cast<long long>(::getpid())},
+        {"tid",  static_cast<unsigned long long>(std::hash<std::thread::id>{}(std::this_thread::get_id()) & 0xffffff)},
+    };
+    std::lock_guard<std::mutex> lock(traceMutex_);
+    traceEvents_.push_back(std::move(ev));
+}
+
+bool Metrics::writeTrace(const std::string& path) const{
+    std::ofstream out(path);
+    if (!out) return false;
+    std::lock_guard<std::mutex> lock(traceMutex_);
+    out << nlohmann::json{{"traceEvents", traceEvents_}, {"displayTimeUnit", "ms"}}.dump() << "\n";
+    return static_cast<bool>(out);
+}
+
+// ─────────────────────────────────────────────────────────────────────────────
+// ScopedTimer
+// ─────────────────────────────────────────────────────────────────────────────
+
+ScopedTimer::~ScopedTimer(){
+    auto end = std::chrono::steady_clock::now();
+    auto ns = std::chrono::duration_cast<std::chrono::nanoseconds>(end - start_).count();
+    histogram_.record(ns > 0 ? static_cast<uint64_t>(ns) : 0);
+
+    Metrics& m = Metrics::instance();
+    if (m.tracing()) m.traceEvent(name_, start_, end);
+}
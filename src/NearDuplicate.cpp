@@ -0,0 +1,64 @@
+/*SimHash
+--words are runs of ASCII letters/digits (lowercased) or non-ASCII bytes; everything
+  else separates them, so reflowed or re-punctuated copies hash the same
+--each shingle of three consecutive words is hashed (FNV-1a, then a finalizer so
+  nearby shingles don't share bit patterns) and votes +1/-1 on every bit
+--texts shorter than three words are a single shingle of what there is*/
+
+#include "NearDuplicate.hpp"
+#include "Metrics.hpp"
+
+#include <cctype>
+#include <vector>
+
+static uint64_t mix(uint64_t h){
+    // splitmix64 finalizer
+    h ^= h >> 30; h *= 0xbf58476d1ce4e5b9ull;
+    h ^= h >> 27; h *= 0x94d049bb133111ebull;
+    return h ^ (h >> 31);
+}
+
+uint64_t NearDuplicate::simhash(const std::string& text){
+    STAGE_TIMER("index.simhash");
+    std::vector<uint64_t> words;
+    words.reserve(text.size() / 6);
+    uint64_t h = 0;
+    bool inWord = false;
+    for (char ch : text) {
+        const unsigned char c = static_cast<unsigned char>(ch);
+        if (c >= 0x80 || std::isalnum(c)) {
+            if (!inWord) { h = 1469598103934665603ull; inWord = true; }
+            h = (h ^ static_cast<unsigned char>(c < 0x80 ? std::tolower(c) : c)) * 1099511628211ull;
+        } else if (inWord) {
+            words.push_back(h);
+            inWord = false;
+        }
+    }
+    if (inWord) words.push_back(h);
+    if (words.empty()) return 0;
+
+    int votes[64] = {};
+    auto vote = [&](uint64_t shingle) {
+        for (int bit = 0; bit < 64; ++bit) votes[bit] += ((shingle >> bit) & 1) ? 1 : -1;
+    };
+    const size_t width = 3;
+    if (words.size() < width) {
+        uint64_t shingle = 0;
+        for (uint64_t w : words) shingle = mix(shingle ^ w);
+        vote(shingle);
+    }
+    for (size_t i = 0; i + width <= words.size(); ++i)
+        vote(mix(mix(mix(words[i]) ^ words[i + 1]) ^ words[i + 2]));
+
+    uint64_t signature = 0;
+    for (int bit = 0; bit < 64; ++bit)
+        if (votes[bit] > 0) signature |= uint64_t(1) << bit;
+    return signature;
+}
+
+std::array<int64_t, NearDuplicate::kBands> NearDuplicate::buckets(uint64_t signature){
+    std::array<int64_t, kBands> out{};
+    for (int band = 0; band < kBands; ++band)
+        out[band] = (static_cast<int64_t>(band) << 16) | static_cast<int64_t>((signature >> (16 * band)) & 0xffff);
+    return out;
+}
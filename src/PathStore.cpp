@@ -0,0 +1,129 @@
+/*Path store
+--add splits the path at '/': every component but the last is looked up (parent id +
+  component) in dirLookup_, so a directory's name is stored once; the last component
+  is the file's own name
+--paths are rebuilt by walking the parent chain, so "/a/b/c.txt", "a/b" and even
+  doubled slashes come back byte for byte
+--lowerBound compares rebuilt paths, log2(rows) of them per lookup*/
+
+#include "PathStore.hpp"
+
+#include <cctype>
+#include <cstring>
+
+std::string PathStore::lowerExtension(const std::string& ext){
+    std::string out = ext;
+    for (auto& c : out) c = static_cast<char>(std::tolower(static_cast<unsigned char>(c)));
+    if (!out.empty() && out[0] != '.') out = "." + out;
+    return out;
+}
+
+uint32_t PathStore::appendChars(const char* s, size_t n){
+    const uint32_t offset = static_cast<uint32_t>(chars_.size());
+    chars_.append(s, n);
+    return offset;
+}
+
+uint32_t PathStore::directory(uint32_t parent, const char* s, size_t n){
+    std::string key(reinterpret_cast<const char*>(&parent), sizeof(parent));
+    key.append(s, n);
+    auto it = dirLookup_.find(key);
+    if (it != dirLookup_.end()) return it->second;
+
+    const uint32_t id = static_cast<uint32_t>(dirs_.size());
+    dirs_.push_back({parent, appendChars(s, n), static_cast<uint32_t>(n)});
+    dirLookup_.emplace(std::move(key), id);
+    return id;
+}
+
+size_t PathStore::add(const std::string& path, const std::string& name, const std::string& extension){
+    uint32_t dir = kNoDir;
+    size_t start = 0;
+    for (size_t slash = path.find('/'); slash != std::string::npos; slash = path.find('/', start)) {
+        dir = directory(dir, path.data() + start, slash - start);
+        start = slash + 1;
+    }
+    const char* leaf = path.data() + start;
+    size_t leafLength = path.size() - start;
+
+    auto it = extLookup_.find(extension);
+    if (it == extLookup_.end()) {
+        it = extLookup_.emplace(extension, static_cast<uint16_t>(extensions_.size())).first;
+        extensions_.push_back(extension);
+        extensionKeys_.push_back(lowerExtension(extension));
+    }
+
+    // "report.pdf" is kept as "report" when ".pdf" puts it back exactly
+    uint16_t flags = 0;
+    if (!extension.empty() && leafLength > extension.size() &&
+        std::memcmp(leaf + leafLength - extension.size(), extension.data(), extension.size()) == 0) {
+        leafLength -= extension.size();
+        flags = kExtCut;
+    }
+
+    const size_t row = files_.size();
+    files_.push_back({dir, appendChars(leaf, leafLength), static_cast<uint16_t>(leafLength | flags), it->second});
+    if (name.compare(0, std::string::npos, path, start, std::string::npos) != 0)
+        otherNames_.emplace(static_cast<uint32_t>(row), name);
+    return row;
+}
+
+void PathStore::seal(){
+    dirLookup_ = {};
+    chars_.shrink_to_fit();
+    dirs_.shrink_to_fit();
+    files_.shrink_to_fit();
+}
+
+void PathStore::appendDir(uint32_t dir, std::string& out) const{
+    if (dir == kNoDir) return;
+    const Dir& d = dirs_[dir];
+    appendDir(d.parent, out);
+    out.append(chars_, d.offset, d.length);
+    out.push_back('/');
+}
+
+void PathStore::appendLeaf(const File& f, std::string& out) const{
+    out.append(chars_, f.leafOffset, f.leafLength & ~kExtCut);
+    if (f.leafLength & kExtCut) out += extensions_[f.ext];
+}
+
+std::string PathStore::path(size_t row) const{
+    std::string out;
+    out.reserve(64);
+    appendDir(files_[row].dir, out);
+    appendLeaf(files_[row], out);
+    return out;
+}
+
+std::string PathStore::name(size_t row) const{
+    if (!otherNames_.empty()) {
+        auto it = otherNames_.find(static_cast<uint32_t>(row));
+        if (it != otherNames_.end()) return it->second;
+    }
+    std::string out;
+    appendLeaf(files_[row], out);
+    return out;
+}
+
+size_t PathStore::lowerBound(const std::string& path) const{
+    size_t lo = 0, hi = files_.size();
+    std::string probe;
+    while (lo < hi) {
+        const size_t mid = lo + (hi - lo) / 2;
+        probe.clear();
+        appendDir(files_[mid].dir, probe);
+        appendLeaf(files_[mid], probe);
+        if (probe < path) lo = mid + 1;
+        else hi = mid;
+    }
+    return lo;
+}
+
+size_t PathStore::bytes() const{
+    size_t total = chars_.capacity() + dirs_.capacity() * sizeof(Dir) + files_.capacity() * sizeof(File);
+    for (const auto& e : extensions_) total += sizeof(e) + e.capacity();
+    for (const auto& e : extensionKeys_) total += sizeof(e) + e.capacity();
+    for (const auto& [row, name] : otherNames_) total += sizeof(row) + sizeof(name) + name.capacity() + 16;
+    return total;
+}
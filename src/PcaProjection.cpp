@@ -0,0 +1,173 @@
+/*PCA projection
+--train: strided sample -> mean -> covariance (upper triangle, rank-1 updates) ->
+  subspace iteration with Gram-Schmidt for the top components
+--stored as one JSON value under metadata key "pca_projection"
+--the drift check reuses the training sample logic on the current rows*/
+
+#include "PcaProjection.hpp"
+#include "VectorIndex.hpp"
+#include "VectorMath.hpp"
+#include "Metrics.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <iostream>
+#include <nlohmann/json.hpp>
+
+using nlohmann::json;
+
+static const char* kMetadataKey = "pca_projection";
+static const int kIterations = 40;
+
+// rows picked with a fixed stride so the sample is spread over the whole (path sorted) corpus
+static size_t sampleStride(size_t count, size_t maxSamples){
+    return (maxSamples == 0 || count <= maxSamples) ? 1 : (count + maxSamples - 1) / maxSamples;
+}
+
+std::shared_ptr<PcaProjection> PcaProjection::train(const float* rows, size_t count, size_t dim,
+                                                    size_t outDim, size_t maxSamples){
+    if (count < 2 || dim == 0 || outDim == 0 || outDim > dim) return nullptr;
+    STAGE_TIMER("pca.train");
+
+    const size_t stride = sampleStride(count, maxSamples);
+    size_t samples = 0;
+
+    std::vector<float> mean(dim, 0.0f);
+    for (size_t r = 0; r < count; r += stride, ++samples) VectorMath::axpy(1.0f, rows + r * dim, mean.data(), dim);
+    for (auto& m : mean) m /= static_cast<float>(samples);
+
+    // covariance, upper triangle only; mirrored afterwards
+    std::vector<float> cov(dim * dim, 0.0f), centered(dim);
+    for (size_t r = 0; r < count; r += stride) {
+        const float* x = rows + r * dim;
+        for (size_t i = 0; i < dim; ++i) centered[i] = x[i] - mean[i];
+        for (size_t i = 0; i < dim; ++i)
+            VectorMath::axpy(centered[i], centered.data() + i, cov.data() + i * dim + i, dim - i);
+    }
+    for (size_t i = 0; i < dim; ++i)
+        for (size_t j = i + 1; j < dim; ++j) cov[j * dim + i] = cov[i * dim + j];
+
+    // subspace iteration: Q <- orth(C Q), starting from a fixed pseudo-random basis
+    std::vector<float> q(outDim * dim), next(outDim * dim);
+    uint32_t seed = 2463534242u;
+    for (auto& v : q) {
+        seed ^= seed << 13; seed ^= seed >> 17; seed ^= seed << 5;
+        v = static_cast<float>(seed) / 4294967296.0f - 0.5f;
+    }
+    for (int it = 0; it <= kIterations; ++it) {
+        if (it > 0) {
+            for (size_t c = 0; c < outDim; ++c)
+                for (size_t i = 0; i < dim; ++i)
+                    next[c * dim + i] = VectorMath::dot(cov.data() + i * dim, q.data() + c * dim, dim);
+            q.swap(next);
+        }
+        // modified Gram-Schmidt over the rows
+        for (size_t c = 0; c < outDim; ++c) {
+            float* row = q.data() + c * dim;
+            for (size_t p = 0; p < c; ++p) {
+                const float* prev = q.data() + p * dim;
+                VectorMath::axpy(-VectorMath::dot(row, prev, dim), prev, row, dim);
+            }
+            VectorMath::l2Normalize(row, dim);
+        }
+    }
+
+    auto pca = std::make_shared<PcaProjection>();
+    pca->inputDim_    = dim;
+    pca->outputDim_   = outDim;
+    pca->trainedRows_ = count;
+    pca->mean_        = std::move(mean);
+    pca->components_  = std::move(q);
+    pca->finish();
+    pca->trainedVariance_ = pca->retainedVariance(rows, count, maxSamples);
+    return pca;
+}
+
+std::shared_ptr<PcaProjection> PcaProjection::train(const VectorIndex& index, size_t outDim){
+    size_t dim = 0;
+    std::vector<float> rows = index.sampleRows(8192, dim);
+    if (dim == 0) return nullptr;
+    auto pca = train(rows.data(), rows.size() / dim, dim, outDim, 0);
+    if (pca) pca->trainedRows_ = index.size();   // drift is measured against the whole corpus
+    return pca;
+}
+
+void PcaProjection::project(const float* in, float* out) const{
+    // dot(c, in - mean) = dot(c, in) - dot(c, mean), the second term is precomputed
+    for (size_t c = 0; c < outputDim_; ++c)
+        out[c] = VectorMath::dot(components_.data() + c * inputDim_, in, inputDim_) - meanProjected_[c];
+}
+
+void PcaProjection::finish(){
+    meanProjected_.resize(outputDim_);
+    for (size_t c = 0; c < outputDim_; ++c)
+        meanProjected_[c] = VectorMath::dot(components_.data() + c * inputDim_, mean_.data(), inputDim_);
+    meanSquaredNorm_ = VectorMath::squaredNorm(mean_.data(), inputDim_);
+}
+
+float PcaProjection::meanDot(const float* v) const{
+    return VectorMath::dot(mean_.data(), v, inputDim_);
+}
+
+float PcaProjection::retainedVariance(const float* rows, size_t count, size_t maxSamples) const{
+    double total = 0.0, kept = 0.0;
+    std::vector<float> centered(inputDim_), reduced(outputDim_);
+    const size_t stride = sampleStride(count, maxSamples);
+    for (size_t r = 0; r < count; r += stride) {
+        const float* x = rows + r * inputDim_;
+        for (size_t i = 0; i < inputDim_; ++i) centered[i] = x[i] - mean_[i];
+        total += VectorMath::squaredNorm(centered.data(), inputDim_);
+        project(x, reduced.data());
+        kept += VectorMath::squaredNorm(reduced.data(), outputDim_);
+    }
+    return total > 0.0 ? static_cast<float>(kept / total) : 1.0f;
+}
+
+bool PcaProjection::stale(const VectorIndex& index) const{
+    const size_t rows = index.size();
+    if (index.dimension() != inputDim_) return true;
+    if (rows * 3 > trainedRows_ * 4 || rows * 3 < trainedRows_ * 2) return true;
+
+    size_t dim = 0;
+    std::vector<float> sample = index.sampleRows(2048, dim);
+    if (dim != inputDim_) return true;
+    // a shifted mean or new topics both show up as variance the components miss
+    return retainedVariance(sample.data(), sample.size() / dim, 0) < trainedVariance_ - 0.05f;
+}
+
+std::shared_ptr<PcaProjection> PcaProjection::load(DatabaseManager& manager){
+    std::string stored = manager.getMetadata(kMetadataKey);
+    if (stored.empty()) return nullptr;
+
+    json j = json::parse(stored, nullptr, false);
+    if (j.is_discarded()) {
+        std::cerr << "Ignoring unreadable " << kMetadataKey << " in metadata\n";
+        return nullptr;
+    }
+    auto pca = std::make_shared<PcaProjection>();
+    pca->inputDim_        = j.value("input_dim", size_t(0));
+    pca->outputDim_       = j.value("output_dim", size_t(0));
+    pca->trainedRows_     = j.value("trained_rows", size_t(0));
+    pca->trainedVariance_ = j.value("retained_variance", 0.0f);
+    pca->mean_            = j.value("mean", std::vector<float>{});
+    pca->components_      = j.value("components", std::vector<float>{});
+    if (pca->inputDim_ == 0 || pca->outputDim_ == 0 ||
+        pca->mean_.size() != pca->inputDim_ ||
+        pca->components_.size() != pca->inputDim_ * pca->outputDim_) {
+        std::cerr << "Ignoring malformed " << kMetadataKey << " in metadata\n";
+        return nullptr;
+    }
+    pca->finish();
+    return pca;
+}
+
+bool PcaProjection::save(DatabaseManager& manager) const{
+    json j = {{"input_dim", inputDim_},
+              {"output_dim", outputDim_},
+              {"trained_rows", trainedRows_},
+              {"retained_variance", trainedVariance_},
+              {"mean", mean_},
+              {"components", components_}};
+    return manager.setMetadata(kMetadataKey, j.dump());
+}
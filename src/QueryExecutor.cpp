@@ -0,0 +1,96 @@
+/*Background query executor
+--each submit gets its own cancel flag; submitting again sets the previous one,
+  which the scan loop in VectorIndex/SearchEngine polls
+--the worker only runs a query once no newer submit arrived for `debounce`
+--cancelled queries are dropped, never published
+--progress snapshots come from the scan itself (SearchOptions::onProgress), on this worker*/
+
+#include "QueryExecutor.hpp"
+
+QueryExecutor::QueryExecutor(SearchEngine& searcher, std::chrono::milliseconds debounce)
+    : searcher(searcher), debounce(debounce),
+      published_(std::make_shared<const QuerySnapshot>())
+{
+    worker_ = std::thread(&QueryExecutor::run, this);
+}
+
+QueryExecutor::~QueryExecutor(){
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stop_ = true;
+        if (newestCancel_) newestCancel_->store(true);
+    }
+    wake_.notify_all();
+    if (worker_.joinable()) worker_.join();
+}
+
+void QueryExecutor::submit(const std::string& query, const SearchOptions& options, bool immediate){
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (newestCancel_) newestCancel_->store(true);   // stale now, pending or in flight
+        newestCancel_ = std::make_shared<std::atomic<bool>>(false);
+
+        pendingQuery_   = query;
+        pendingOptions_ = options;
+        ++pendingGeneration_;
+        pendingAt_  = immediate ? std::chrono::steady_clock::now() - debounce
+                                : std::chrono::steady_clock::now();
+        hasPending_ = true;
+        busy_ = true;
+    }
+    wake_.notify_one();
+}
+
+std::shared_ptr<const QuerySnapshot> QueryExecutor::latest() const{
+    return std::atomic_load(&published_);
+}
+
+void QueryExecutor::publish(std::shared_ptr<const QuerySnapshot> snapshot){
+    std::atomic_store(&published_, std::move(snapshot));
+}
+
+void QueryExecutor::run(){
+    std::unique_lock<std::mutex> lock(mutex_);
+    while (true) {
+        wake_.wait(lock, [&]{ return stop_ || hasPending_; });
+        if (stop_) return;
+
+        // debounce: keep waiting while keystrokes keep pushing pendingAt_ forward
+        while (!stop_ && std::chrono::steady_clock::now() < pendingAt_ + debounce)
+            wake_.wait_until(lock, pendingAt_ + debounce);
+        if (stop_) return;
+
+        auto snapshot = std::make_shared<QuerySnapshot>();
+        snapshot->generation = pendingGeneration_;
+        snapshot->query      = pendingQuery_;
+        SearchOptions options = pendingOptions_;
+        std::shared_ptr<std::atomic<bool>> cancel = newestCancel_;
+        options.cancelled = cancel.get();
+        hasPending_ = false;
+        lock.unlock();
+
+        auto t0 = std::chrono::steady_clock::now();
+        auto elapsedMs = [&] {
+            return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - t0).count();
+        };
+        options.completeness = &snapshot->completeness;
+        options.onProgress = [&](const std::vector<SearchResult>& early, double share) {
+            if (cancel->load()) return;
+            auto partial = std::make_shared<QuerySnapshot>();
+            partial->generation   = snapshot->generation;
+            partial->query        = snapshot->query;
+            partial->results      = early;
+            partial->latencyMs    = elapsedMs();
+            partial->completeness = share;
+            publish(std::move(partial));
+        };
+        if (!snapshot->query.empty())
+            snapshot->results = searcher.search(snapshot->query, options);
+        snapshot->latencyMs = elapsedMs();
+
+        if (!cancel->load()) publish(std::move(snapshot));
+
+        lock.lock();
+        if (!hasPending_) busy_ = false;
+    }
+}
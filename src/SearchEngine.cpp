@@ -8,31 +8,84 @@
 --sort and return the top searchs*/
 
 #include "SearchEngine.hpp"
+#include "VectorMath.hpp"
+#include "Metrics.hpp"
 #include <cmath>
 #include <algorithm>
 #include <sstream>
 #include <sqlite3.h>
 #include <iostream>
 
-SearchEngine::SearchEngine(DatabaseManager& manager, EmbeddingEngine& embedder) 
+SearchEngine::SearchEngine(DatabaseManager& manager, Embedder& embedder) 
     : manager(manager), embedder(embedder) {}
 
+SearchEngine::SearchEngine(DatabaseManager& manager, Embedder& embedder, const VectorIndex& index)
+    : manager(manager), embedder(embedder), index(&index) {}
+
 std::vector<SearchResult> SearchEngine::search(const std::string& searchInput, int topK){
-    std::vector<SearchResult> results;
+    SearchOptions options;
+    options.topK = topK;
+    return search(searchInput, options);
+}
+
+std::vector<SearchResult> SearchEngine::search(const std::string& searchInput, const SearchOptions& options){
+    STAGE_TIMER("search");
+    TaskScheduler::Slot slot;
+    if (scheduler) slot = scheduler->acquire(TaskScheduler::Priority::Interactive);
+
     std::vector<float> searchInputVectorEmbedding = embedder.createEmbedding(searchInput);
+    if (options.isCancelled()) return {};
+    return rank(searchInputVectorEmbedding, options);
+}
 
-    //now use sqlite to go through all the files in database
-    std::vector<std::tuple<std::string, std::string, std::string, std::vector<float> >> files = manager.getAllFiles();
+std::vector<SearchResult> SearchEngine::searchByFile(const std::string& path, int topK){
+    SearchOptions options;
+    options.topK = topK;
+    return searchByFile(path, options);
+}
+
+std::vector<SearchResult> SearchEngine::searchByFile(const std::string& path, const SearchOptions& options){
+    STAGE_TIMER("search.by_file");
+    TaskScheduler::Slot slot;
+    if (scheduler) slot = scheduler->acquire(TaskScheduler::Priority::Interactive);
+
+    std::vector<float> stored = index ? index->vectorOf(path) : manager.getEmbedding(path);
+    if (stored.empty()) return {};
+
+    //one extra so the file itself (always the best match) can be dropped
+    SearchOptions withSelf = options;
+    withSelf.topK = options.topK + 1;
+    std::vector<SearchResult> results = rank(stored, withSelf);
+    results.erase(std::remove_if(results.begin(), results.end(),
+                                 [&](const SearchResult& r) { return r.path == path; }),
+                  results.end());
+    if (results.size() > static_cast<size_t>(std::max(0, options.topK))) results.resize(options.topK);
+    return results;
+}
+
+std::vector<SearchResult> SearchEngine::rank(const std::vector<float>& searchInputVectorEmbedding, const SearchOptions& options){
+    std::vector<SearchResult> results;
+    const int topK = options.topK;
+    if (index) return index->search(searchInputVectorEmbedding, options);
+
+    //now use sqlite to go through the files in database that pass the filter
+    std::vector<std::tuple<std::string, std::string, std::string, std::vector<float> >> files = manager.getFilteredFiles(options.filter);
 
     //loop through all the files and deserialize the numbers
+    STAGE_TIMER("search.scan");
+    //without the warm index there is no recency order: a deadline just cuts the list short
     for (const auto& [path, name, extension, serializedEmbedding] : files) {
-       
+        if (options.isCancelled()) return {};
+        if ((results.size() & 255) == 255 && options.pastDeadline()) break;
+
         // Similarity
         float score = cosineSimilarity(searchInputVectorEmbedding, serializedEmbedding);
     
         results.push_back({path, name, extension, score});
     }
 
+    options.reportCompleteness(files.empty() ? 1.0 : double(results.size()) / double(files.size()));
+
     std::sort(results.begin(), results.end(), [](const SearchResult& a, const SearchResult& b)
         {
         return a.score > b.score;
@@ -47,22 +100,7 @@ std::vector<SearchResult> SearchEngine::search(const std::string& searchInput, i
 
 }
 
-float SearchEngine::cosineSimilarity(const std::vector<float>& fileEmbeddingVector, const std::vector<float> searchEmbeddingVector){
-
-
+float SearchEngine::cosineSimilarity(const std::vector<float>& fileEmbeddingVector, const std::vector<float>& searchEmbeddingVector){
     if(fileEmbeddingVector.size() != searchEmbeddingVector.size()) return 0.0f;
-
-    float dotProduct = 0.0f;
-    float magA = 0.0f;
-    float magB = 0.0f;
-
-    for(size_t i = 0 ; i <fileEmbeddingVector.size(); ++i){
-        dotProduct += fileEmbeddingVector[i] * searchEmbeddingVector[i];
-        magA += fileEmbeddingVector[i] * fileEmbeddingVector[i];
-        magB += searchEmbeddingVector[i] * searchEmbeddingVector[i];
-    }
-
-    if (magA == 0.0f || magB == 0.0f) return 0.0f;
-    return dotProduct / (std::sqrt(magA) * std::sqrt(magB));
-
-}
\ No newline at end of file
+    return VectorMath::cosineSimilarity(fileEmbeddingVector.data(), searchEmbeddingVector.data(), fileEmbeddingVector.size());
+}
@@ -0,0 +1,514 @@
+/*Search daemon over a unix domain socket
+--run() binds the socket, loads the VectorIndex once and starts the worker pool
+--the accept loop hands connections to workers through a small queue
+--each worker reads newline delimited JSON requests and writes one JSON line back
+--index requests run the shared Indexer and then reload the warm index
+--the PCA projection for coarse search is loaded at start-up and retrained in the
+  background once the corpus drifts away from it*/
+
+#include "SearchServer.hpp"
+#include "Indexer.hpp"
+#include "SearchEngine.hpp"
+#include "Metrics.hpp"
+#include "PcaProjection.hpp"
+
+#include <csignal>
+#include <cstring>
+#include <filesystem>
+#include <iostream>
+#include <poll.h>
+#include <sys/resource.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+using nlohmann::json;
+
+#ifdef MSG_NOSIGNAL
+static const int kSendFlags = MSG_NOSIGNAL;
+#else
+static const int kSendFlags = 0;   // macOS: SIGPIPE is ignored in run() instead
+#endif
+
+static std::atomic<bool> g_stopRequested{false};
+
+static void onStopSignal(int) { g_stopRequested = true; }
+
+static bool fillAddress(const std::string& path, sockaddr_un& addr){
+    std::memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    if (path.size() >= sizeof(addr.sun_path)) return false;
+    std::strncpy(addr.sun_path, path.c_str(), sizeof(addr.sun_path) - 1);
+    return true;
+}
+
+// high-water resident set of this process; ru_maxrss is bytes on macOS, KB elsewhere
+static long long peakRssKb(){
+    rusage usage{};
+    if (::getrusage(RUSAGE_SELF, &usage) != 0) return 0;
+#ifdef __APPLE__
+    return static_cast<long long>(usage.ru_maxrss) / 1024;
+#else
+    return static_cast<long long>(usage.ru_maxrss);
+#endif
+}
+
+static bool writeAll(int fd, const std::string& data){
+    size_t off = 0;
+    while (off < data.size()) {
+        ssize_t n = ::send(fd, data.data() + off, data.size() - off, kSendFlags);
+        if (n <= 0) return false;
+        off += static_cast<size_t>(n);
+    }
+    return true;
+}
+
+// ─────────────────────────────────────────────────────────────────────────────
+// Wire format
+// ─────────────────────────────────────────────────────────────────────────────
+
+json filterToJson(const SearchFilter& filter){
+    json j = json::object();
+    if (!filter.extensions.empty()) j["ext"]    = filter.extensions;
+    if (!filter.underPath.empty())  j["under"]  = filter.underPath;
+    if (filter.modifiedSince  > 0)  j["since"]  = filter.modifiedSince;
+    if (filter.modifiedBefore > 0)  j["before"] = filter.modifiedBefore;
+    return j;
+}
+
+SearchFilter filterFromJson(const json& j){
+    SearchFilter filter;
+    if (j.contains("ext") && j["ext"].is_array())
+        filter.extensions = j["ext"].get<std::vector<std::string>>();
+    if (j.contains("under")) filter.underPath = j["under"].get<std::string>();
+    if (j.contains("since")) filter.modifiedSince = j["since"].get<long long>();
+    if (j.contains("before")) filter.modifiedBefore = j["before"].get<long long>();
+    return filter;
+}
+
+json limitsToJson(const GovernorLimits& limits){
+    const GovernorLimits defaults;
+    json j = json::object();
+    if (limits.maxWorkers != defaults.maxWorkers)   j["threads"]      = limits.maxWorkers;
+    if (limits.cpuShare != defaults.cpuShare)       j["cpu_share"]    = limits.cpuShare;
+    if (limits.ioMBps != defaults.ioMBps)           j["io_mbps"]      = limits.ioMBps;
+    if (limits.maxRssMb != defaults.maxRssMb)       j["max_rss_mb"]   = limits.maxRssMb;
+    if (limits.pauseLoad != defaults.pauseLoad)     j["pause_load"]   = limits.pauseLoad;
+    if (limits.lowPriority != defaults.lowPriority) j["low_priority"] = limits.lowPriority;
+    return j;
+}
+
+GovernorLimits limitsFromJson(const json& j, GovernorLimits base){
+    if (!j.is_object()) return base;
+    base.maxWorkers  = j.value("threads", base.maxWorkers);
+    base.cpuShare    = j.value("cpu_share", base.cpuShare);
+    base.ioMBps      = j.value("io_mbps", base.ioMBps);
+    base.maxRssMb    = j.value("max_rss_mb", base.maxRssMb);
+    base.pauseLoad   = j.value("pause_load", base.pauseLoad);
+    base.lowPriority = j.value("low_priority", base.lowPriority);
+    return base;
+}
+
+// ─────────────────────────────────────────────────────────────────────────────
+// Server
+// ─────────────────────────────────────────────────────────────────────────────
+
+SearchServer::SearchServer(DatabaseManager& manager, ContextExtractor& extractor,
+                           Embedder& embedder, const ServerConfig& config)
+    : manager(&manager), extractor(extractor), embedder(embedder), config(config),
+      scheduler(config.workers) {}
+
+SearchServer::SearchServer(ShardSet& shards, ContextExtractor& extractor,
+                           Embedder& embedder, const ServerConfig& config)
+    : shards(&shards), extractor(extractor), embedder(embedder), config(config),
+      scheduler(config.workers) {}
+
+SearchServer::~SearchServer(){
+    shutdown();
+}
+
+int SearchServer::run(){
+    // A socket file left by a crashed daemon would make bind fail; only remove it
+    // when nothing is answering on it.
+    if (std::filesystem::exists(config.socketPath)) {
+        if (SearchClient(config.socketPath).available()) {
+            std::cerr << "A daemon is already serving on " << config.socketPath << "\n";
+            return 1;
+        }
+        ::unlink(config.socketPath.c_str());
+    }
+
+    sockaddr_un addr;
+    if (!fillAddress(config.socketPath, addr)) {
+        std::cerr << "Socket path too long: " << config.socketPath << "\n";
+        return 1;
+    }
+    listenFd = ::socket(AF_UNIX, SOCK_STREAM, 0);
+    if (listenFd < 0 ||
+        ::bind(listenFd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) != 0 ||
+        ::listen(listenFd, 64) != 0) {
+        std::cerr << "Failed to listen on " << config.socketPath << ": " << std::strerror(errno) << "\n";
+        if (listenFd >= 0) ::close(listenFd);
+        listenFd = -1;
+        return 1;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(dbMutex);
+        if (manager) {
+            index.load(*manager);
+            modelVariant = manager->getMetadata("model_variant", "fp32");
+        } else {
+            modelVariant = shards->modelVariant();
+        }
+    }
+    maintainProjection();
+    // the engine is lazy; a daemon should pay for the session before the first query
+    embedder.warmUp();
+    if (config.batchMax > 1) {
+        BatcherConfig batching;
+        batching.maxBatch  = config.batchMax;
+        batching.maxWindow = std::chrono::microseconds(std::max(0, config.batchWindowUs));
+        batcher = std::make_unique<EmbeddingBatcher>(embedder, batching);
+    }
+    std::cerr << "[serve] " << (shards ? shards->size() : index.size()) << " vectors loaded, listening on "
+              << config.socketPath << " with " << config.workers << " workers\n";
+
+    std::signal(SIGINT, onStopSignal);
+    std::signal(SIGTERM, onStopSignal);
+    std::signal(SIGPIPE, SIG_IGN);
+
+    startedAt = std::chrono::steady_clock::now();
+    running = true;
+    for (int i = 0; i < std::max(1, config.workers); ++i)
+        workers.emplace_back(&SearchServer::workerLoop, this);
+
+    while (running && !g_stopRequested) {
+        pollfd p{listenFd, POLLIN, 0};
+        if (::poll(&p, 1, 250) <= 0) continue;   // timeout lets us notice stop requests
+        int fd = ::accept(listenFd, nullptr, nullptr);
+        if (fd < 0) continue;
+        {
+            std::lock_guard<std::mutex> lock(queueMutex);
+            pending.push_back(fd);
+        }
+        queueReady.notify_one();
+    }
+
+    shutdown();
+    std::cerr << "[serve] stopped\n";
+    return 0;
+}
+
+void SearchServer::stop(){
+    running = false;
+    queueReady.notify_all();
+}
+
+void SearchServer::shutdown(){
+    stop();
+    for (auto& t : workers)
+        if (t.joinable()) t.join();
+    workers.clear();
+    {
+        std::lock_guard<std::mutex> job(projectionMutex);
+        if (projectionJob.valid()) projectionJob.wait();
+    }
+    batcher.reset();   // no worker can submit any more
+
+    std::lock_guard<std::mutex> lock(queueMutex);
+    for (int fd : pending) ::close(fd);
+    pending.clear();
+    if (listenFd >= 0) {
+        ::close(listenFd);
+        listenFd = -1;
+        ::unlink(config.socketPath.c_str());
+    }
+}
+
+void SearchServer::workerLoop(){
+    while (true) {
+        int fd = -1;
+        {
+            std::unique_lock<std::mutex> lock(queueMutex);
+            queueReady.wait(lock, [&]{ return !running || !pending.empty(); });
+            if (!running) return;
+            fd = pending.front();
+            pending.pop_front();
+        }
+        serveConnection(fd);
+        ::close(fd);
+    }
+}
+
+void SearchServer::serveConnection(int fd){
+    std::string buffer;
+    char chunk[4096];
+
+    while (running) {
+        pollfd p{fd, POLLIN, 0};
+        int ready = ::poll(&p, 1, 250);
+        if (ready == 0) continue;
+        if (ready < 0) return;
+
+        ssize_t n = ::recv(fd, chunk, sizeof(chunk), 0);
+        if (n <= 0) return; // client closed
+        buffer.append(chunk, static_cast<size_t>(n));
+
+        size_t nl;
+        while ((nl = buffer.find('\n')) != std::string::npos) {
+            std::string line = buffer.substr(0, nl);
+            buffer.erase(0, nl + 1);
+            if (line.empty()) continue;
+
+            json reply;
+            json request = json::parse(line, nullptr, false);
+            if (request.is_discarded()) reply = {{"ok", false}, {"error", "invalid json"}};
+            else reply = handle(request);
+
+            if (!writeAll(fd, reply.dump() + "\n")) return;
+        }
+    }
+}
+
+json SearchServer::handle(const json& request){
+    ++requestsServed;
+    try {
+        const std::string op = request.value("op", "");
+        if (op == "search") return handleSearch(request);
+        if (op == "similar") return handleSimilar(request);
+        if (op == "index")  return handleIndex(request);
+        if (op == "stats")  return handleStats();
+        if (op == "attach" || op == "detach" || op == "rebuild" || op == "shards")
+            return handleShardOp(op, request);
+        return {{"ok", false}, {"error", "unknown op: " + op}};
+    } catch (const std::exception& e) {
+        return {{"ok", false}, {"error", e.what()}};
+    }
+}
+
+static SearchOptions optionsFromJson(const json& request){
+    SearchOptions options;
+    options.topK   = request.value("k", 5);
+    options.filter = filterFromJson(request);
+    options.coarse = request.value("coarse", false);
+    options.collapseDuplicates = request.value("collapse", false);
+    // the budget counts from the request's arrival, so embedding the query spends it too
+    const int budgetMs = request.value("budget_ms", 0);
+    if (budgetMs > 0) options.deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(budgetMs);
+    return options;
+}
+
+static json resultsToJson(const std::vector<SearchResult>& results, double completeness){
+    json out = json::array();
+    for (const auto& r : results) {
+        json hit = {{"path", r.path}, {"name", r.name}, {"extension", r.extension}, {"score", r.score}};
+        if (r.duplicates > 0) hit["duplicates"] = r.duplicates;
+        out.push_back(std::move(hit));
+    }
+    return {{"ok", true}, {"results", out}, {"completeness", completeness}};
+}
+
+json SearchServer::handleSearch(const json& request){
+    SearchOptions options = optionsFromJson(request);
+    double completeness = 1.0;
+    options.completeness = &completeness;
+
+    // Embedding runs outside any lock; the index takes its own shared lock
+    std::vector<SearchResult> results;
+    if (shards) {
+        STAGE_TIMER("search");
+        TaskScheduler::Slot slot = scheduler.acquire(TaskScheduler::Priority::Interactive);
+        std::vector<float> query = queryEmbedder().createEmbedding(request.value("query", ""));
+        results = shards->search(query, options);
+    } else {
+        SearchEngine searcher(*manager, queryEmbedder(), index);
+        searcher.scheduler = &scheduler;
+        results = searcher.search(request.value("query", ""), options);
+    }
+    return resultsToJson(results, completeness);
+}
+
+json SearchServer::handleSimilar(const json& request){
+    const std::string path = request.value("path", "");
+    SearchOptions options = optionsFromJson(request);
+    double completeness = 1.0;
+    options.completeness = &completeness;
+    if (path.empty()) return {{"ok", false}, {"error", "missing path"}};
+
+    // the stored vector is the query: nothing is extracted or embedded
+    std::vector<SearchResult> results;
+    if (shards) {
+        STAGE_TIMER("search.by_file");
+        TaskScheduler::Slot slot = scheduler.acquire(TaskScheduler::Priority::Interactive);
+        std::vector<float> stored = shards->vectorOf(path);
+        if (stored.empty()) return {{"ok", false}, {"error", "not indexed: " + path}};
+        SearchOptions withSelf = options;
+        withSelf.topK = options.topK + 1;
+        for (auto& r : shards->search(stored, withSelf))
+            if (r.path != path && results.size() < static_cast<size_t>(options.topK)) results.push_back(std::move(r));
+    } else {
+        if (index.vectorOf(path).empty()) return {{"ok", false}, {"error", "not indexed: " + path}};
+        SearchEngine searcher(*manager, embedder, index);
+        searcher.scheduler = &scheduler;
+        results = searcher.searchByFile(path, options);
+    }
+    return resultsToJson(results, completeness);
+}
+
+json SearchServer::handleIndex(const json& request){
+    const std::string path = request.value("path", "");
+    if (path.empty()) return {{"ok", false}, {"error", "missing path"}};
+    const GovernorLimits limits = limitsFromJson(request.value("limits", json::object()), config.indexLimits);
+
+    // shards lock per shard, so queries and other shards' writes keep going
+    if (shards) {
+        IndexGovernor governor(limits);
+        int indexed = shards->indexDirectory(path, extractor, embedder, &scheduler, &governor);
+        return {{"ok", true}, {"indexed", indexed}, {"files", shards->size()}};
+    }
+
+    int indexed = 0;
+    {
+        std::lock_guard<std::mutex> lock(dbMutex);
+        IndexGovernor governor(limits);
+        Indexer indexer(*manager, extractor, embedder);
+        indexer.scheduler = &scheduler;
+        indexer.governor = &governor;
+        indexer.resume = request.value("resume", false);
+        indexed = indexer.indexDirectory(path);
+        index.load(*manager);
+    }
+    maintainProjection();
+    return {{"ok", true}, {"indexed", indexed}, {"files", index.size()}};
+}
+
+json SearchServer::handleStats(){
+    auto uptime = std::chrono::duration_cast<std::chrono::seconds>(
+        std::chrono::steady_clock::now() - startedAt).count();
+    json out = {{"ok", true},
+                {"files", shards ? shards->size() : index.size()},
+                {"dimension", shards ? shards->dimension() : index.dimension()},
+                {"model_variant", modelVariant},
+                {"pca_dims", index.projection() ? index.projection()->outputDim() : 0},
+                {"pca_retraining", retraining.load()},
+                {"workers", config.workers},
+                {"requests", requestsServed.load()},
+                {"uptime_s", uptime},
+                {"peak_rss_kb", peakRssKb()},
+                {"metrics", Metrics::instance().toJson()}};
+    const OcrStats ocr = extractor.ocrStats();
+    out["ocr"] = {{"ocred", ocr.ocred}, {"skipped", ocr.skipped}, {"ocr_s", ocr.ocrSeconds},
+                  {"triage_s", ocr.triageSeconds}, {"saved_s", ocr.savedSeconds}};
+    if (batcher) {
+        const BatcherStats b = batcher->stats();
+        out["batching"] = {{"requests", b.requests}, {"batches", b.batches},
+                           {"mean_batch", b.meanBatch()}, {"largest_batch", b.largestBatch}};
+    }
+    if (shards) out["shards"] = handleShardOp("shards", json::object())["shards"];
+    return out;
+}
+
+void SearchServer::maintainProjection(){
+    if (!manager || config.pcaDims == 0) return;
+
+    std::shared_ptr<const PcaProjection> current = index.projection();
+    if (!current) {
+        std::shared_ptr<const PcaProjection> stored = PcaProjection::load(*manager);
+        if (stored && stored->outputDim() == config.pcaDims) index.setProjection(current = stored);
+    }
+    if (current && current->outputDim() == config.pcaDims && !current->stale(index)) return;
+    // a corpus this small scans in full faster than it trains
+    if (index.size() < 4 * config.pcaDims) return;
+
+    // the finished job may clear retraining before its launcher has stored the future,
+    // so the next launcher waits here rather than touch the future alongside it
+    std::lock_guard<std::mutex> job(projectionMutex);
+    bool idle = false;
+    if (!retraining.compare_exchange_strong(idle, true)) return;   // one job at a time
+    if (projectionJob.valid()) projectionJob.wait();               // already done, just reap it
+
+    // queries keep using the old projection (or the full scan) until the swap
+    projectionJob = std::async(std::launch::async, [this] {
+        std::shared_ptr<PcaProjection> pca = PcaProjection::train(index, config.pcaDims);
+        if (pca) {
+            pca->save(*manager);
+            index.setProjection(pca);
+            std::cerr << "[serve] PCA projection retrained: " << pca->inputDim() << " -> " << pca->outputDim()
+                      << " dims, " << static_cast<int>(pca->trainedVariance() * 100.0f) << "% variance kept\n";
+        }
+        retraining = false;
+    });
+}
+
+json SearchServer::handleShardOp(const std::string& op, const json& request){
+    if (!shards) return {{"ok", false}, {"error", op + " needs a sharded index (--shards <dir>)"}};
+    const std::string name = request.value("name", "");
+
+    if (op == "attach") {
+        if (!shards->attach(name, request.value("root", "")))
+            return {{"ok", false}, {"error", "could not attach shard " + name}};
+    } else if (op == "detach") {
+        if (!shards->detach(name)) return {{"ok", false}, {"error", "no shard " + name}};
+    } else if (op == "rebuild") {
+        IndexGovernor governor(config.indexLimits);
+        int indexed = shards->rebuild(name, extractor, embedder, &scheduler, &governor);
+        if (indexed < 0) return {{"ok", false}, {"error", "could not rebuild shard " + name + " (unknown, or its rebuilt database could not be swapped in)"}};
+        return {{"ok", true}, {"indexed", indexed}};
+    }
+
+    json list = json::array();
+    for (const auto& s : shards->list())
+        list.push_back({{"name", s.name}, {"root", s.root}, {"files", s.files}});
+    return {{"ok", true}, {"shards", list}};
+}
+
+// ─────────────────────────────────────────────────────────────────────────────
+// Client
+// ─────────────────────────────────────────────────────────────────────────────
+
+SearchClient::SearchClient(std::string socketPath)
+    : socketPath(std::move(socketPath)) {}
+
+static int connectTo(const std::string& path){
+    sockaddr_un addr;
+    if (!fillAddress(path, addr)) return -1;
+    int fd = ::socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd < 0) return -1;
+    if (::connect(fd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) != 0) {
+        ::close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+bool SearchClient::available() const{
+    if (!std::filesystem::exists(socketPath)) return false;
+    int fd = connectTo(socketPath);
+    if (fd < 0) return false;
+    ::close(fd);
+    return true;
+}
+
+std::optional<json> SearchClient::request(const json& request) const{
+    int fd = connectTo(socketPath);
+    if (fd < 0) return std::nullopt;
+
+    if (!writeAll(fd, request.dump() + "\n")) {
+        ::close(fd);
+        return std::nullopt;
+    }
+
+    std::string reply;
+    char chunk[4096];
+    while (reply.find('\n') == std::string::npos) {
+        ssize_t n = ::recv(fd, chunk, sizeof(chunk), 0);
+        if (n <= 0) break;
+        reply.append(chunk, static_cast<size_t>(n));
+    }
+    ::close(fd);
+
+    auto j = json::parse(reply.substr(0, reply.find('\n')), nullptr, false);
+    if (j.is_discarded()) return std::nullopt;
+    return j;
+}
@@ -0,0 +1,394 @@
+/*Sharded index
+--the shard list is copied under a shared lock before every fan-out, so attach/detach
+  only block for the pointer swap and a detached shard lives on until its last query ends
+--each shard's sqlite connection is only used under its writeMutex; queries never touch
+  sqlite, they read the shard's VectorIndex
+--rebuild writes <name>.rebuild.db, renames it over <name>.db and reloads the vectors
+--attach/detach change where files route (a deeper root, or another hash modulus among
+  same-root shards), so rehome moves every stored row that no longer routes to its shard
+  before the next index run can write a second copy elsewhere*/
+
+#include "ShardSet.hpp"
+#include "Indexer.hpp"
+#include "Metrics.hpp"
+
+#include <algorithm>
+#include <cctype>
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <future>
+#include <iostream>
+#include <map>
+#include <set>
+
+namespace fs = std::filesystem;
+using nlohmann::json;
+
+static std::string normalizeRoot(const std::string& dir){
+    std::string d = fs::absolute(dir).lexically_normal().string();
+    while (d.size() > 1 && d.back() == '/') d.pop_back();
+    return d;
+}
+
+// true when path is dir itself or lies below it
+static bool isUnder(const std::string& path, const std::string& dir){
+    if (dir == "/") return true;
+    return path.size() >= dir.size() && path.compare(0, dir.size(), dir) == 0 &&
+           (path.size() == dir.size() || path[dir.size()] == '/');
+}
+
+static bool validName(const std::string& name){
+    if (name.empty()) return false;
+    for (char c : name)
+        if (!std::isalnum(static_cast<unsigned char>(c)) && c != '-' && c != '_') return false;
+    return true;
+}
+
+// {"shards":[{"name":..,"root":..}]}; nullptr when missing or unreadable
+static json loadManifest(const std::string& directory){
+    std::ifstream in(fs::path(directory) / "shards.json");
+    json manifest = json::parse(in, nullptr, false);
+    if (manifest.is_discarded() || !manifest.contains("shards")) return nullptr;
+    return manifest;
+}
+
+static uint64_t fnv1a(const std::string& s){
+    uint64_t h = 1469598103934665603ull;
+    for (unsigned char c : s) { h ^= c; h *= 1099511628211ull; }
+    return h;
+}
+
+ShardSet::ShardSet(const std::string& directory, const std::string& modelVariant,
+                   const std::string& modelName, size_t dimension)
+    : directory_(directory), modelVariant_(modelVariant), modelName_(modelName), dimension_(dimension)
+{
+    std::error_code ec;
+    fs::create_directories(directory_, ec);
+
+    const json manifest = loadManifest(directory_);
+    if (manifest.is_null()) return;
+
+    for (const auto& entry : manifest["shards"]) {
+        auto shard = std::make_shared<Shard>();
+        shard->name = entry.value("name", "");
+        shard->root = entry.value("root", "");
+        if (!validName(shard->name) || shard->root.empty()) continue;
+        shard->db   = std::make_unique<DatabaseManager>(dbPath(shard->name));
+        if (!shard->db->useModelVariant(modelVariant_, modelName_, dimension_)) {
+            std::cerr << "Shard " << shard->name << " skipped\n";
+            continue;
+        }
+        shard->index.load(*shard->db);
+        shards_.push_back(std::move(shard));
+    }
+    std::sort(shards_.begin(), shards_.end(),
+              [](const std::shared_ptr<Shard>& a, const std::shared_ptr<Shard>& b) { return a->name < b->name; });
+}
+
+std::string ShardSet::dbPath(const std::string& name) const{
+    return (fs::path(directory_) / (name + ".db")).string();
+}
+
+bool ShardSet::saveManifest() const{
+    json list = json::array();
+    for (const auto& s : shards_) list.push_back({{"name", s->name}, {"root", s->root}});
+
+    // temp + rename: a crash never leaves a truncated shard list
+    fs::path path = fs::path(directory_) / "shards.json";
+    fs::path tmp  = path.string() + ".tmp";
+    {
+        std::ofstream out(tmp);
+        out << json{{"shards", list}}.dump(2) << "\n";
+        if (!out) return false;
+    }
+    std::error_code ec;
+    fs::rename(tmp, path, ec);
+    return !ec;
+}
+
+std::shared_ptr<ShardSet::Shard> ShardSet::find(const std::string& name) const{
+    std::shared_lock<std::shared_mutex> lock(mutex_);
+    for (const auto& s : shards_)
+        if (s->name == name) return s;
+    return nullptr;
+}
+
+std::vector<std::shared_ptr<ShardSet::Shard>> ShardSet::snapshot() const{
+    std::shared_lock<std::shared_mutex> lock(mutex_);
+    return shards_;
+}
+
+std::shared_ptr<ShardSet::Shard> ShardSet::route(const std::string& path) const{
+    std::shared_lock<std::shared_mutex> lock(mutex_);
+    size_t best = 0;
+    std::vector<const std::shared_ptr<Shard>*> candidates;
+    for (const auto& s : shards_) {
+        if (!isUnder(path, s->root)) continue;
+        size_t len = (s->root == "/") ? 0 : s->root.size();
+        if (candidates.empty() || len > best) { best = len; candidates.clear(); }
+        if (len == best) candidates.push_back(&s);
+    }
+    if (candidates.empty()) return nullptr;
+    // shards_ is kept sorted by name, so the hash split is stable across restarts
+    return *candidates[fnv1a(path) % candidates.size()];
+}
+
+bool ShardSet::storedModelVariant(const std::string& directory, std::string& variant){
+    variant.clear();
+    const json manifest = loadManifest(directory);
+    if (manifest.is_null()) return true;
+
+    std::string first;   // shard that set variant
+    for (const auto& entry : manifest["shards"]) {
+        const std::string name = entry.value("name", "");
+        const fs::path path = fs::path(directory) / (name + ".db");
+        if (!validName(name) || !fs::exists(path)) continue;
+        DatabaseManager db(path.string());
+        // an empty shard takes whichever variant is used with it
+        if (db.countFiles() == 0) continue;
+        const std::string stored = db.getMetadata("model_variant", "fp32");
+        if (variant.empty()) {
+            variant = stored;
+            first = name;
+        } else if (stored != variant) {
+            std::cerr << "Shards " << first << " (" << variant << ") and " << name << " (" << stored
+                      << ") were embedded with different model variants; rebuild one of them.\n";
+            return false;
+        }
+    }
+    return true;
+}
+
+bool ShardSet::attach(const std::string& name, const std::string& root){
+    if (!validName(name)) {
+        std::cerr << "Shard names may only use letters, digits, '-' and '_': " << name << "\n";
+        return false;
+    }
+    if (find(name)) {
+        std::cerr << "Shard " << name << " is already attached\n";
+        return false;
+    }
+
+    // open and load outside the list lock; queries keep running meanwhile
+    auto shard = std::make_shared<Shard>();
+    shard->name = name;
+    shard->root = normalizeRoot(root);
+    shard->db   = std::make_unique<DatabaseManager>(dbPath(name));
+    if (!shard->db->useModelVariant(modelVariant_, modelName_, dimension_)) return false;
+    shard->index.load(*shard->db);
+
+    std::unique_lock<std::shared_mutex> lock(mutex_);
+    auto at = std::lower_bound(shards_.begin(), shards_.end(), name,
+                               [](const std::shared_ptr<Shard>& s, const std::string& n) { return s->name < n; });
+    if (at != shards_.end() && (*at)->name == name) return false;   // lost a race with another attach
+    const std::string changed = shard->root;
+    shards_.insert(at, std::move(shard));
+    if (!saveManifest()) return false;
+    lock.unlock();
+
+    rehome(changed, find(name));
+    return true;
+}
+
+bool ShardSet::detach(const std::string& name){
+    std::shared_ptr<Shard> shard = find(name);
+    if (!shard) return false;
+
+    {
+        // let an index/rebuild of this shard finish before it disappears
+        std::lock_guard<std::mutex> writing(shard->writeMutex);
+        std::unique_lock<std::shared_mutex> lock(mutex_);
+        shards_.erase(std::remove(shards_.begin(), shards_.end(), shard), shards_.end());
+        if (!saveManifest()) return false;
+    }
+    // its rows stay in its .db; only same-root siblings split the files differently now
+    rehome(shard->root, nullptr);
+    return true;
+}
+
+void ShardSet::rehome(const std::string& root, const std::shared_ptr<Shard>& attached){
+    STAGE_TIMER("shard.rehome");
+    // rows can only have left same-root siblings (another modulus), shards above an
+    // attached root, and the attached shard itself (its .db may be from an earlier attach)
+    std::vector<std::shared_ptr<Shard>> affected;
+    for (auto& s : snapshot())
+        if (s == attached || s->root == root || (attached && isUnder(root, s->root))) affected.push_back(s);
+    if (affected.size() < 2 && !attached) return;
+
+    // same lock order as indexDirectory (name order), so neither can deadlock the other
+    std::vector<std::unique_lock<std::mutex>> locks;
+    for (auto& s : affected) locks.emplace_back(s->writeMutex);
+
+    // one source shard at a time, so only its leaving rows are held in memory
+    std::set<Shard*> changed;
+    for (auto& s : affected) {
+        std::vector<std::string> leaving;
+        std::map<Shard*, std::vector<std::pair<FileRow, std::vector<float>>>> moves;
+        s->db->forEachEmbedding([&](const FileRow& row, const float* v, size_t dim) {
+            std::shared_ptr<Shard> home = route(row.path);
+            if (home == s) return;
+            leaving.push_back(row.path);
+            // a destination outside the locked set re-indexes the file on its next run
+            if (home && std::find(affected.begin(), affected.end(), home) != affected.end())
+                moves[home.get()].emplace_back(row, std::vector<float>(v, v + dim));
+        });
+        if (leaving.empty()) continue;
+
+        // dropped before they are re-added: a crash in between costs a re-embed, never a duplicate
+        s->db->beginBatch();
+        const int removed = s->db->removeFiles(leaving);
+        s->db->commitBatch();
+        std::cerr << "Shard " << s->name << ": " << removed << " file(s) now route elsewhere\n";
+        changed.insert(s.get());
+
+        for (auto& [to, rows] : moves) {
+            to->db->beginBatch();
+            for (const auto& [row, vector] : rows) {
+                // false when the shard already holds the file as new or newer
+                if (to->db->insertFile(row.path, row.name, row.extension, vector, static_cast<long>(row.last_modified)) && row.simhash)
+                    to->db->setSignature(row.path, row.simhash, 0);
+            }
+            to->db->commitBatch();
+            changed.insert(to);
+        }
+    }
+    for (auto& s : affected)
+        if (changed.count(s.get())) s->index.load(*s->db);
+}
+
+int ShardSet::rebuild(const std::string& name, ContextExtractor& extractor, Embedder& embedder,
+                      TaskScheduler* scheduler, IndexGovernor* governor){
+    std::shared_ptr<Shard> shard = find(name);
+    if (!shard) return -1;
+    STAGE_TIMER("shard.rebuild");
+    std::lock_guard<std::mutex> writing(shard->writeMutex);
+
+    const std::string finalPath = dbPath(name);
+    const std::string tmpPath   = (fs::path(directory_) / (name + ".rebuild.db")).string();
+    std::error_code ec;
+    fs::remove(tmpPath, ec);
+
+    int indexed = 0;
+    {
+        DatabaseManager fresh(tmpPath);
+        fresh.useModelVariant(modelVariant_, modelName_, dimension_);
+        // same routing as indexDirectory, so hash-split siblings keep their files
+        Indexer indexer([&](const FileInfo& file) -> DatabaseManager* {
+            return route(file.path) == shard ? &fresh : nullptr;
+        }, extractor, embedder);
+        indexer.scheduler = scheduler;
+        indexer.governor = governor;
+        indexed = indexer.indexDirectory(shard->root);
+    }
+
+    // the old connection goes first so nothing writes to the file being replaced
+    shard->db.reset();
+    fs::rename(tmpPath, finalPath, ec);
+    shard->db = std::make_unique<DatabaseManager>(finalPath);
+    if (ec) {
+        // the shard keeps serving its old data; the rebuilt copy is left for a manual swap
+        std::cerr << "Could not replace " << finalPath << ": " << ec.message()
+                  << "; the rebuilt database is kept as " << tmpPath << "\n";
+        return -1;
+    }
+    shard->index.load(*shard->db);   // swaps under the index lock; queries see old or new
+    return indexed;
+}
+
+int ShardSet::indexDirectory(const std::string& directory, ContextExtractor& extractor, Embedder& embedder,
+                             TaskScheduler* scheduler, IndexGovernor* governor){
+    const std::string dir = normalizeRoot(directory);
+
+    // lock every shard the directory can route to, in name order (shards_ order)
+    std::vector<std::shared_ptr<Shard>> targets;
+    for (auto& s : snapshot())
+        if (isUnder(s->root, dir) || isUnder(dir, s->root)) targets.push_back(s);
+    if (targets.empty()) {
+        std::cerr << "No shard covers " << dir << "; attach one first\n";
+        return 0;
+    }
+    std::vector<std::unique_lock<std::mutex>> locks;
+    for (auto& s : targets) locks.emplace_back(s->writeMutex);
+
+    std::set<Shard*> touched;
+    Indexer indexer([&](const FileInfo& file) -> DatabaseManager* {
+        std::shared_ptr<Shard> s = route(file.path);
+        // attached after we locked: leave it for the next run
+        if (!s || std::find(targets.begin(), targets.end(), s) == targets.end()) return nullptr;
+        touched.insert(s.get());
+        return s->db.get();
+    }, extractor, embedder);
+    indexer.scheduler = scheduler;
+    indexer.governor = governor;
+    int indexed = indexer.indexDirectory(dir);
+
+    for (auto& s : targets)
+        if (touched.count(s.get())) s->index.load(*s->db);
+    return indexed;
+}
+
+std::vector<SearchResult> ShardSet::search(const std::vector<float>& query, const SearchOptions& options) const{
+    STAGE_TIMER("search.fanout");
+    // a directory filter rules out shards whose root can't contain it
+    const std::string under = options.filter.underPath.empty() ? "" : normalizeRoot(options.filter.underPath);
+    std::vector<std::shared_ptr<Shard>> shards;
+    for (auto& s : snapshot())
+        if (under.empty() || isUnder(under, s->root) || isUnder(s->root, under)) shards.push_back(s);
+
+    std::vector<SearchResult> merged;
+    options.reportCompleteness(1.0);
+    if (shards.size() == 1) return shards[0]->index.search(query, options);
+
+    // each shard reports its own completeness; progress callbacks would race, so they are
+    // dropped, while the shared deadline bounds every shard's scan the same way
+    std::vector<double> shares(shards.size(), 1.0);
+    std::vector<std::future<std::vector<SearchResult>>> parts;
+    parts.reserve(shards.size());
+    for (size_t i = 0; i < shards.size(); ++i) {
+        SearchOptions own = options;
+        own.onProgress   = nullptr;
+        own.completeness = &shares[i];
+        parts.push_back(std::async(std::launch::async, [&query, own, s = shards[i]] {
+            return s->index.search(query, own);
+        }));
+    }
+    double scored = 0.0, rows = 0.0;
+    for (size_t i = 0; i < parts.size(); ++i) {
+        std::vector<SearchResult> r = parts[i].get();
+        merged.insert(merged.end(), std::make_move_iterator(r.begin()), std::make_move_iterator(r.end()));
+        const double n = static_cast<double>(shards[i]->index.size());
+        scored += shares[i] * n;
+        rows   += n;
+    }
+    options.reportCompleteness(rows > 0.0 ? scored / rows : 1.0);
+
+    const size_t k = std::min(merged.size(), static_cast<size_t>(std::max(0, options.topK)));
+    std::partial_sort(merged.begin(), merged.begin() + static_cast<long>(k), merged.end(),
+                      [](const SearchResult& a, const SearchResult& b) { return a.score > b.score; });
+    merged.resize(k);
+    return merged;
+}
+
+std::vector<float> ShardSet::vectorOf(const std::string& path) const{
+    std::shared_ptr<Shard> shard = route(path);
+    return shard ? shard->index.vectorOf(path) : std::vector<float>();
+}
+
+std::vector<ShardInfo> ShardSet::list() const{
+    std::vector<ShardInfo> out;
+    for (auto& s : snapshot()) out.push_back({s->name, s->root, s->index.size()});
+    return out;
+}
+
+size_t ShardSet::size() const{
+    size_t n = 0;
+    for (auto& s : snapshot()) n += s->index.size();
+    return n;
+}
+
+size_t ShardSet::dimension() const{
+    for (auto& s : snapshot())
+        if (s->index.dimension()) return s->index.dimension();
+    return 0;
+}
@@ -0,0 +1,165 @@
+/*Static embedding table
+--load reads the header, the vocabulary and the weights, then the rows; f16 rows are
+  widened once here so embedding never converts
+--tokenize is the BERT basic tokenizer (ASCII lowercase, punctuation split) plus
+  WordPiece over the table's own vocabulary; non-ASCII bytes are kept as they are
+--embed accumulates weight * row with VectorMath::axpy and normalizes; the 1/sum of
+  weights cancels under normalization so it is never applied*/
+
+#include "StaticEmbedding.hpp"
+#include "VectorMath.hpp"
+#include "Metrics.hpp"
+
+#include <algorithm>
+#include <cctype>
+#include <cmath>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+
+// IEEE half -> float (subnormals included, no hardware conversion needed)
+static float halfToFloat(uint16_t h){
+    const uint32_t sign = static_cast<uint32_t>(h & 0x8000) << 16;
+    uint32_t exponent = (h >> 10) & 0x1f;
+    uint32_t mantissa = h & 0x3ff;
+    uint32_t bits;
+    if (exponent == 0x1f) {
+        bits = sign | 0x7f800000u | (mantissa << 13);
+    } else if (exponent != 0) {
+        bits = sign | ((exponent + 112) << 23) | (mantissa << 13);
+    } else if (mantissa == 0) {
+        bits = sign;
+    } else {
+        // subnormal: shift the mantissa up until its leading bit becomes implicit
+        exponent = 113;
+        while (!(mantissa & 0x400)) { mantissa <<= 1; --exponent; }
+        bits = sign | (exponent << 23) | ((mantissa & 0x3ff) << 13);
+    }
+    float f;
+    std::memcpy(&f, &bits, sizeof(f));
+    return f;
+}
+
+template <typename T>
+static bool readValue(std::ifstream& in, T& value){
+    return static_cast<bool>(in.read(reinterpret_cast<char*>(&value), sizeof(T)));
+}
+
+std::unique_ptr<StaticEmbedding> StaticEmbedding::load(const std::string& path){
+    STAGE_TIMER("embed.static_load");
+    std::ifstream in(path, std::ios::binary);
+    if (!in) {
+        std::cerr << "[static] Cannot open " << path << " (tools/export_static.py writes it)\n";
+        return nullptr;
+    }
+
+    char magic[8];
+    uint32_t version = 0, vocab = 0, dim = 0, unk = 0, flags = 0;
+    if (!in.read(magic, sizeof(magic)) || std::memcmp(magic, "CXSTATIC", 8) != 0 ||
+        !readValue(in, version) || !readValue(in, vocab) || !readValue(in, dim) ||
+        !readValue(in, unk) || !readValue(in, flags) || version != 1 || vocab == 0 || dim == 0) {
+        std::cerr << "[static] " << path << " is not a version 1 static embedding file\n";
+        return nullptr;
+    }
+
+    auto table = std::make_unique<StaticEmbedding>();
+    table->dim_ = dim;
+    table->unkId_ = unk < vocab ? static_cast<int32_t>(unk) : -1;
+    table->vocab_.reserve(vocab);
+    std::string token;
+    for (uint32_t i = 0; i < vocab; ++i) {
+        uint16_t length = 0;
+        if (!readValue(in, length)) break;
+        token.resize(length);
+        if (length && !in.read(&token[0], length)) break;
+        table->vocab_.emplace(token, static_cast<int32_t>(i));
+    }
+
+    table->weights_.resize(vocab);
+    in.read(reinterpret_cast<char*>(table->weights_.data()), static_cast<std::streamsize>(vocab * sizeof(float)));
+
+    const size_t values = static_cast<size_t>(vocab) * dim;
+    table->rows_.resize(values);
+    if (flags & 1) {
+        std::vector<uint16_t> half(values);
+        in.read(reinterpret_cast<char*>(half.data()), static_cast<std::streamsize>(values * sizeof(uint16_t)));
+        for (size_t i = 0; i < values; ++i) table->rows_[i] = halfToFloat(half[i]);
+    } else {
+        in.read(reinterpret_cast<char*>(table->rows_.data()), static_cast<std::streamsize>(values * sizeof(float)));
+    }
+    if (!in) {
+        std::cerr << "[static] " << path << " is truncated\n";
+        return nullptr;
+    }
+    return table;
+}
+
+size_t StaticEmbedding::readDimension(const std::string& path){
+    std::ifstream in(path, std::ios::binary);
+    char magic[8];
+    uint32_t version = 0, vocab = 0, dim = 0;
+    if (!in.read(magic, sizeof(magic)) || std::memcmp(magic, "CXSTATIC", 8) != 0 ||
+        !readValue(in, version) || !readValue(in, vocab) || !readValue(in, dim) || version != 1)
+        return 0;
+    return dim;
+}
+
+void StaticEmbedding::wordPiece(const std::string& word, std::string& probe, std::vector<int32_t>& ids) const{
+    // words this long are noise (hashes, base64); BERT maps them to [UNK] as well
+    if (word.size() > 100) return;
+    const size_t mark = ids.size();
+    size_t start = 0;
+    while (start < word.size()) {
+        size_t end = word.size();
+        int32_t found = -1;
+        for (; end > start; --end) {
+            probe.assign(start > 0 ? "##" : "");
+            probe.append(word, start, end - start);
+            auto it = vocab_.find(probe);
+            if (it != vocab_.end()) { found = it->second; break; }
+        }
+        if (found < 0) {   // no piece matches: the whole word is unknown
+            ids.resize(mark);
+            return;
+        }
+        ids.push_back(found);
+        start = end;
+    }
+}
+
+std::vector<int32_t> StaticEmbedding::tokenize(const std::string& text) const{
+    std::vector<int32_t> ids;
+    ids.reserve(text.size() / 4);
+    std::string word, probe;
+    auto flush = [&] {
+        if (!word.empty()) wordPiece(word, probe, ids);
+        word.clear();
+    };
+    for (char ch : text) {
+        const unsigned char c = static_cast<unsigned char>(ch);
+        if (c < 0x80 && (std::isspace(c) || std::iscntrl(c))) {
+            flush();
+        } else if (c < 0x80 && std::ispunct(c)) {
+            flush();
+            word.push_back(ch);
+            flush();
+        } else {
+            word.push_back(c < 0x80 ? static_cast<char>(std::tolower(c)) : ch);
+        }
+    }
+    flush();
+    return ids;
+}
+
+bool StaticEmbedding::embed(const std::string& text, float* out) const{
+    std::fill(out, out + dim_, 0.0f);
+    bool any = false;
+    for (int32_t id : tokenize(text)) {
+        if (id == unkId_) continue;
+        VectorMath::axpy(weights_[static_cast<size_t>(id)], rows_.data() + static_cast<size_t>(id) * dim_, out, dim_);
+        any = true;
+    }
+    if (!any) return false;
+    VectorMath::l2Normalize(out, dim_);
+    return true;
+}
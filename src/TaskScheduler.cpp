@@ -0,0 +1,81 @@
+/*Priority gate
+--one mutex + condition variable; slots are a counter, not threads
+--interactive waiters are counted so background acquire() can step aside for them
+--wait times go to the "sched.wait.*" histograms, yields to "sched.yields"*/
+
+#include "TaskScheduler.hpp"
+#include "Metrics.hpp"
+
+#include <algorithm>
+#include <chrono>
+
+TaskScheduler::TaskScheduler(int slots) : slots_(std::max(1, slots)) {}
+
+TaskScheduler::Slot TaskScheduler::acquire(Priority priority){
+    static Histogram& interactiveWait = Metrics::instance().histogram("sched.wait.interactive");
+    static Histogram& backgroundWait  = Metrics::instance().histogram("sched.wait.background");
+    const auto start = std::chrono::steady_clock::now();
+
+    std::unique_lock<std::mutex> lock(mutex_);
+    if (priority == Priority::Interactive) {
+        ++interactiveQueued_;
+        changed_.wait(lock, [&]{ return inUse_ < slots_; });
+        --interactiveQueued_;
+    } else {
+        changed_.wait(lock, [&]{ return inUse_ < slots_ && interactiveQueued_ == 0; });
+    }
+    ++inUse_;
+    lock.unlock();
+
+    const auto waited = std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now() - start).count();
+    (priority == Priority::Interactive ? interactiveWait : backgroundWait).record(static_cast<uint64_t>(waited));
+    return Slot(this, priority);
+}
+
+bool TaskScheduler::yield(Slot& slot){
+    if (!slot.held() || slot.priority_ != Priority::Background || !interactiveWaiting()) return false;
+    static Counter& yields = Metrics::instance().counter("sched.yields");
+    yields.add();
+    slot.release();
+    slot = acquire(Priority::Background);   // queued queries get in first
+    return true;
+}
+
+bool TaskScheduler::interactiveWaiting() const{
+    std::lock_guard<std::mutex> lock(mutex_);
+    return interactiveQueued_ > 0;
+}
+
+void TaskScheduler::releaseSlot(){
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        --inUse_;
+    }
+    // waiters of both kinds re-check; interactive ones win since background ones see the queue
+    changed_.notify_all();
+}
+
+// ─────────────────────────────────────────────────────────────────────────────
+// Slot
+// ─────────────────────────────────────────────────────────────────────────────
+
+TaskScheduler::Slot::Slot(Slot&& other) noexcept
+    : owner_(other.owner_), priority_(other.priority_) {
+    other.owner_ = nullptr;
+}
+
+TaskScheduler::Slot& TaskScheduler::Slot::operator=(Slot&& other) noexcept{
+    if (this != &other) {
+        release();
+        owner_ = other.owner_;
+        priority_ = other.priority_;
+        other.owner_ = nullptr;
+    }
+    return *this;
+}
+
+void TaskScheduler::Slot::release(){
+    if (owner_) owner_->releaseSlot();
+    owner_ = nullptr;
+}
@@ -1,4 +1,5 @@
 #include "TokenizerClient.hpp"
+#include "Metrics.hpp"
 #include <cstdio>
 #include <array>
 #include <sstream>
@@ -20,6 +21,7 @@ static std::string sh_escape(const std::string& s){
 }
 
 std::optional<TokenizerResults> TokenizerClient::encode(const std::string& text) const {
+  STAGE_TIMER("tokenize");
   // Build: <venv-python> tools/tokenize.py --tokenizer-json models/tokenizer.json --text "..."
   std::ostringstream cmd;
   cmd << sh_escape(py_) << " "
@@ -46,4 +48,39 @@ std::optional<TokenizerResults> TokenizerClient::encode(const std::string& text)
      return std::nullopt;
 
   return r;
-}
\ No newline at end of file
+}
+
+std::optional<std::vector<TokenizerResults>> TokenizerClient::encodeBatch(const std::vector<std::string>& texts) const {
+  STAGE_TIMER("tokenize.batch");
+  // one python start-up for the whole batch: --text is repeated, one JSON line comes back per text
+  std::ostringstream cmd;
+  cmd << sh_escape(py_) << " "
+      << sh_escape(script_) << " --tokenizer-json " << sh_escape(tokjson_);
+  for (const auto& t : texts) cmd << " --text " << sh_escape(t);
+  cmd << " --max-len " << maxLen_;
+
+  std::array<char, 4096> buf{};
+  std::string out;
+  FILE* pipe = popen(cmd.str().c_str(), "r");
+  if (!pipe) return std::nullopt;
+  while (fgets(buf.data(), (int)buf.size(), pipe)) out += buf.data();
+  int rc = pclose(pipe);
+  if (rc != 0) return std::nullopt;
+
+  std::vector<TokenizerResults> results;
+  std::istringstream lines(out);
+  std::string line;
+  while (std::getline(lines, line)) {
+    auto j = nlohmann::json::parse(line, nullptr, false);
+    if (j.is_discarded() || !j.contains("input_ids") || !j.contains("attention_mask"))
+      return std::nullopt;
+    TokenizerResults r;
+    r.input_ids      = j["input_ids"].get<std::vector<int64_t>>();
+    r.attention_mask = j["attention_mask"].get<std::vector<int64_t>>();
+    if (r.input_ids.size() != (size_t)maxLen_ || r.attention_mask.size() != (size_t)maxLen_)
+      return std::nullopt;
+    results.push_back(std::move(r));
+  }
+  if (results.size() != texts.size()) return std::nullopt;
+  return results;
+}
@@ -0,0 +1,409 @@
+/*Warm vector index
+--load pulls every (row, vector) out of sqlite once into flat arrays
+--search turns the filter into a row range (path prefix) plus a bitmap (extension, mtime)
+--only rows with their bit set are scored, the best topK are kept in a small heap
+--coarse search scores the reduced rows instead and rescores the heap on the full rows
+--collapsed search keeps grouped rows out of the heap: each group keeps its best row
+  (and a count) in a small map that is merged into the heap when results are built
+--anytime search walks newestSegments_, checking cancel, deadline and the progress
+  interval every 16 runs; completeness is rows scored over rows the filter lets through
+--allNeighbours scores tiles of rows against the whole index, one tile per worker at a time*/
+
+#include "VectorIndex.hpp"
+#include "VectorMath.hpp"
+#include "Metrics.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <mutex>
+#include <queue>
+#include <thread>
+
+// reduced rows plus dot(mean, row), the term the centered projection leaves out
+static void projectRows(const PcaProjection& pca, const std::vector<float>& vectors, size_t dim,
+                        std::vector<float>& reduced, std::vector<float>& meanDots){
+    const size_t rows = dim ? vectors.size() / dim : 0;
+    const size_t r = pca.outputDim();
+    reduced.assign(rows * r, 0.0f);
+    meanDots.assign(rows, 0.0f);
+    if (pca.inputDim() != dim) { reduced.clear(); meanDots.clear(); return; }
+    STAGE_TIMER("index.project");
+    for (size_t row = 0; row < rows; ++row) {
+        pca.project(vectors.data() + row * dim, reduced.data() + row * r);
+        meanDots[row] = pca.meanDot(vectors.data() + row * dim);
+    }
+}
+
+void VectorIndex::load(DatabaseManager& manager){
+    load([&](const RowVisitor& visit){ manager.forEachEmbedding(visit); });
+}
+
+void VectorIndex::load(const std::function<void(const RowVisitor&)>& source){
+    std::lock_guard<std::mutex> writing(writeMutex_);   // pca_ can't change under us
+    size_t dim = 0;
+    std::vector<float> vectors, norms;
+    PathStore files;
+    std::vector<long long> modified;
+    std::vector<long long> ids;
+    std::vector<std::pair<uint32_t, long long>> members;   //rows that borrowed a representative's vector
+
+    source([&](const FileRow& row, const float* vec, size_t n){
+        if (dim == 0) dim = n;
+        if (n != dim) return; //mixed dimensions can't be compared, keep the first seen
+
+        size_t at = vectors.size();
+        vectors.resize(at + n);
+        std::memcpy(vectors.data() + at, vec, n * sizeof(float));
+
+        norms.push_back(std::sqrt(VectorMath::squaredNorm(vectors.data() + at, n)));
+
+        if (row.group != 0 && row.group != row.id)
+            members.emplace_back(static_cast<uint32_t>(modified.size()), row.group);
+        ids.push_back(row.id);
+        files.add(row.path, row.name, row.extension);
+        modified.push_back(row.last_modified);
+    });
+    files.seal();
+
+    // a group is keyed by its representative's row, or by its first member's when the
+    // representative has no vector here
+    std::vector<uint64_t> grouped;
+    std::unordered_map<uint32_t, uint32_t> groupOf;
+    if (!members.empty()) {
+        std::unordered_map<long long, uint32_t> keyRow;
+        for (const auto& [row, group] : members) keyRow.emplace(group, row);
+        grouped.assign((ids.size() + 63) / 64, 0);
+        for (size_t row = 0; row < ids.size(); ++row) {
+            auto it = keyRow.find(ids[row]);
+            if (it == keyRow.end()) continue;
+            it->second = static_cast<uint32_t>(row);
+            groupOf[static_cast<uint32_t>(row)] = static_cast<uint32_t>(row);
+            grouped[row / 64] |= uint64_t(1) << (row % 64);
+        }
+        for (const auto& [row, group] : members) {
+            groupOf[row] = keyRow[group];
+            grouped[row / 64] |= uint64_t(1) << (row % 64);
+        }
+    }
+
+    // files in one directory are adjacent and tend to change together, so a run's newest
+    // file stands for the run
+    const size_t runs = (modified.size() + kSegmentRows - 1) / kSegmentRows;
+    std::vector<long long> newest(runs, 0);
+    for (size_t row = 0; row < modified.size(); ++row)
+        newest[row / kSegmentRows] = std::max(newest[row / kSegmentRows], modified[row]);
+    std::vector<uint32_t> newestSegments(runs);
+    for (size_t i = 0; i < runs; ++i) newestSegments[i] = static_cast<uint32_t>(i * kSegmentRows);
+    std::stable_sort(newestSegments.begin(), newestSegments.end(),
+                     [&](uint32_t a, uint32_t b) { return newest[a / kSegmentRows] > newest[b / kSegmentRows]; });
+
+    std::vector<float> reduced, meanDots;
+    if (pca_) projectRows(*pca_, vectors, dim, reduced, meanDots);
+
+    std::unique_lock<std::shared_mutex> lock(mutex_);
+    dim_      = dim;
+    vectors_  = std::move(vectors);
+    norms_    = std::move(norms);
+    files_    = std::move(files);
+    modified_ = std::move(modified);
+    newestSegments_ = std::move(newestSegments);
+    grouped_  = std::move(grouped);
+    groupOf_  = std::move(groupOf);
+    reduced_  = std::move(reduced);
+    meanDots_ = std::move(meanDots);
+}
+
+void VectorIndex::setProjection(std::shared_ptr<const PcaProjection> pca){
+    std::lock_guard<std::mutex> writing(writeMutex_);   // rows can't change under us
+    std::vector<float> reduced, meanDots;
+    if (pca) {
+        std::shared_lock<std::shared_mutex> lock(mutex_);
+        projectRows(*pca, vectors_, dim_, reduced, meanDots);
+    }
+    std::unique_lock<std::shared_mutex> lock(mutex_);
+    pca_      = std::move(pca);
+    reduced_  = std::move(reduced);
+    meanDots_ = std::move(meanDots);
+}
+
+std::shared_ptr<const PcaProjection> VectorIndex::projection() const{
+    std::shared_lock<std::shared_mutex> lock(mutex_);
+    return pca_;
+}
+
+std::vector<float> VectorIndex::sampleRows(size_t maxRows, size_t& dim) const{
+    std::shared_lock<std::shared_mutex> lock(mutex_);
+    dim = dim_;
+    const size_t rows = files_.size();
+    if (rows == 0 || maxRows == 0) return {};
+    const size_t stride = (rows + maxRows - 1) / maxRows;
+
+    std::vector<float> out;
+    out.reserve(((rows + stride - 1) / stride) * dim_);
+    for (size_t row = 0; row < rows; row += stride)
+        out.insert(out.end(), vectors_.begin() + row * dim_, vectors_.begin() + (row + 1) * dim_);
+    return out;
+}
+
+size_t VectorIndex::size() const{
+    std::shared_lock<std::shared_mutex> lock(mutex_);
+    return files_.size();
+}
+
+size_t VectorIndex::dimension() const{
+    std::shared_lock<std::shared_mutex> lock(mutex_);
+    return dim_;
+}
+
+size_t VectorIndex::metadataBytes() const{
+    std::shared_lock<std::shared_mutex> lock(mutex_);
+    return files_.bytes() + modified_.capacity() * sizeof(long long) + newestSegments_.capacity() * sizeof(uint32_t)
+         + grouped_.capacity() * sizeof(uint64_t) + groupOf_.size() * (2 * sizeof(uint32_t) + 16);
+}
+
+void VectorIndex::pathRange(const std::string& dir, size_t& first, size_t& last) const{
+    // same half-open range the sqlite pushdown uses: "/a/b/" <= path < "/a/b0"
+    std::string d = dir;
+    while (d.size() > 1 && d.back() == '/') d.pop_back();
+    std::string lo = (d == "/") ? d : d + "/";
+    std::string hi = lo;
+    hi.back() = '/' + 1;
+
+    first = files_.lowerBound(lo);
+    last  = files_.lowerBound(hi);
+}
+
+std::vector<uint64_t> VectorIndex::filterBitmap(const SearchFilter& filter, size_t first, size_t last) const{
+    const size_t n = last - first;
+    std::vector<uint64_t> bits((n + 63) / 64, ~uint64_t(0));
+    if (n % 64) bits.back() = (uint64_t(1) << (n % 64)) - 1;
+
+    if (!filter.extensions.empty()) {
+        // case-insensitive: ".md" selects README.MD too
+        const std::vector<std::string>& extKeys = files_.extensionKeys();
+        std::vector<bool> wanted(extKeys.size(), false);
+        for (const auto& e : filter.extensions) {
+            const std::string key = PathStore::lowerExtension(e);
+            for (size_t id = 0; id < extKeys.size(); ++id)
+                if (extKeys[id] == key) wanted[id] = true;
+        }
+        for (size_t i = 0; i < n; ++i)
+            if (!wanted[files_.extensionId(first + i)]) bits[i / 64] &= ~(uint64_t(1) << (i % 64));
+    }
+    if (filter.modifiedSince > 0 || filter.modifiedBefore > 0) {
+        for (size_t i = 0; i < n; ++i) {
+            long long m = modified_[first + i];
+            bool keep = (filter.modifiedSince  <= 0 || m >= filter.modifiedSince) &&
+                        (filter.modifiedBefore <= 0 || m <  filter.modifiedBefore);
+            if (!keep) bits[i / 64] &= ~(uint64_t(1) << (i % 64));
+        }
+    }
+    return bits;
+}
+
+std::vector<SearchResult> VectorIndex::search(const std::vector<float>& query, const SearchOptions& options) const{
+    STAGE_TIMER("search.scan");
+    std::vector<SearchResult> results;
+    options.reportCompleteness(1.0);
+    if (options.topK <= 0) return results;
+
+    std::shared_lock<std::shared_mutex> lock(mutex_);
+    if (query.size() != dim_ || files_.empty()) return results;
+
+    double qsq = 0.0;
+    for (float v : query) qsq += double(v) * double(v);
+    const float qnorm = static_cast<float>(std::sqrt(qsq));
+    if (qnorm == 0.0f) return results;
+
+    size_t first = 0, last = files_.size();
+    if (!options.filter.underPath.empty()) pathRange(options.filter.underPath, first, last);
+    if (first >= last) return results;
+    std::vector<uint64_t> bits = filterBitmap(options.filter, first, last);
+
+    // coarse: the heap holds a shortlist ranked on the reduced rows, with
+    // dot(x, q) ~ dot(Px, Pq) + dot(mean, x) + dot(mean, q) - |mean|^2
+    // exact up to the variance the projection dropped
+    const bool coarse = options.coarse && !reduced_.empty();
+    const size_t k = static_cast<size_t>(options.topK);
+    const size_t keep = !coarse ? k
+        : std::max(k, options.shortlist > 0 ? static_cast<size_t>(options.shortlist) : std::max<size_t>(20 * k, 200));
+    const size_t r = coarse ? pca_->outputDim() : 0;
+    std::vector<float> reducedQuery(r);
+    float queryOffset = 0.0f;
+    if (coarse) {
+        pca_->project(query.data(), reducedQuery.data());
+        queryOffset = pca_->meanDot(query.data()) - pca_->meanSquaredNorm();
+    }
+
+    // min-heap on score keeps the current best rows
+    using Entry = std::pair<float, size_t>;
+    using Heap = std::priority_queue<Entry, std::vector<Entry>, std::greater<Entry>>;
+    Heap best;
+    size_t scored = 0;
+
+    struct GroupBest{ float score; size_t row; int members; };
+    const bool collapse = options.collapseDuplicates && !groupOf_.empty();
+    std::unordered_map<uint32_t, GroupBest> groups;   //representative row -> best row so far
+
+    auto consider = [&](size_t row) {
+        float dot = coarse
+            ? VectorMath::dot(reduced_.data() + row * r, reducedQuery.data(), r) + meanDots_[row] + queryOffset
+            : VectorMath::dot(vectors_.data() + row * dim_, query.data(), dim_);
+        float score = (norms_[row] == 0.0f) ? 0.0f : dot / (norms_[row] * qnorm);
+        ++scored;
+
+        if (collapse && (grouped_[row / 64] >> (row % 64) & 1)) {
+            const uint32_t key = groupOf_.at(static_cast<uint32_t>(row));
+            auto [it, added] = groups.try_emplace(key, GroupBest{score, row, 1});
+            if (added) return;
+            ++it->second.members;
+            if (score > it->second.score || (score == it->second.score && row == key))
+                it->second = {score, row, it->second.members};
+            return;
+        }
+        if (best.size() < keep) best.emplace(score, row);
+        else if (score > best.top().first) { best.pop(); best.emplace(score, row); }
+    };
+
+    // the heap as results: each group's best row joins it, and the coarse shortlist is
+    // rescored on the full rows
+    auto collect = [&](Heap heap) {
+        std::unordered_map<size_t, int> duplicates;
+        for (const auto& [key, g] : groups) {
+            duplicates[g.row] = g.members - 1;
+            if (heap.size() < keep) heap.emplace(g.score, g.row);
+            else if (g.score > heap.top().first) { heap.pop(); heap.emplace(g.score, g.row); }
+        }
+        if (coarse) {
+            STAGE_TIMER("search.rescore");
+            std::vector<Entry> shortlist;
+            shortlist.reserve(heap.size());
+            for (; !heap.empty(); heap.pop()) {
+                size_t row = heap.top().second;
+                float dot = VectorMath::dot(vectors_.data() + row * dim_, query.data(), dim_);
+                shortlist.emplace_back((norms_[row] == 0.0f) ? 0.0f : dot / (norms_[row] * qnorm), row);
+            }
+            for (const auto& e : shortlist) {
+                if (heap.size() < k) heap.push(e);
+                else if (e.first > heap.top().first) { heap.pop(); heap.push(e); }
+            }
+        }
+        std::vector<SearchResult> out(heap.size());
+        for (size_t i = out.size(); i-- > 0; heap.pop()) {
+            size_t row = heap.top().second;
+            out[i] = {files_.path(row), files_.name(row), files_.extension(row), heap.top().first};
+            if (!duplicates.empty()) {
+                auto it = duplicates.find(row);
+                if (it != duplicates.end()) out[i].duplicates = it->second;
+            }
+        }
+        return out;
+    };
+
+    size_t matching = 0;
+    for (uint64_t word : bits) matching += static_cast<size_t>(__builtin_popcountll(word));
+    auto share = [&] { return matching ? double(scored) / double(matching) : 1.0; };
+
+    if (!options.hasDeadline() && !options.onProgress) {
+        for (size_t w = 0; w < bits.size(); ++w) {
+            // one relaxed load per 4096 rows is noise next to the dot products
+            if ((w & 63) == 0 && options.isCancelled()) break;
+            uint64_t word = bits[w];
+            while (word) {
+                consider(first + w * 64 + static_cast<size_t>(__builtin_ctzll(word)));
+                word &= word - 1;
+            }
+        }
+    } else {
+        // runs outside [first, last) and rows off the bitmap are skipped without scoring.
+        // 16 runs are a few hundred microseconds of dot products; the clock is read between them
+        auto lastReport = std::chrono::steady_clock::now();
+        for (size_t at = 0; at < newestSegments_.size(); ++at) {
+            if (at > 0 && at % 16 == 0) {
+                if (options.isCancelled() || options.pastDeadline()) break;
+                if (options.onProgress) {
+                    const auto now = std::chrono::steady_clock::now();
+                    if (now - lastReport >= options.progressEvery) {
+                        options.onProgress(collect(best), share());
+                        lastReport = now;
+                    }
+                }
+            }
+            const size_t lo = std::max<size_t>(first, newestSegments_[at]);
+            const size_t hi = std::min<size_t>(last, newestSegments_[at] + kSegmentRows);
+            for (size_t row = lo; row < hi; ++row) {
+                const size_t bit = row - first;
+                if (bits[bit / 64] & (uint64_t(1) << (bit % 64))) consider(row);
+            }
+        }
+    }
+    options.reportCompleteness(share());
+    if (scored < matching) Metrics::instance().counter("search.partial").add(1);
+
+    return collect(std::move(best));
+}
+
+std::vector<float> VectorIndex::vectorOf(const std::string& path) const{
+    std::shared_lock<std::shared_mutex> lock(mutex_);
+    const size_t row = files_.lowerBound(path);
+    if (row == files_.size() || files_.path(row) != path) return {};
+    return std::vector<float>(vectors_.begin() + static_cast<long>(row * dim_),
+                              vectors_.begin() + static_cast<long>((row + 1) * dim_));
+}
+
+std::vector<Neighbours> VectorIndex::allNeighbours(size_t topK, unsigned threads) const{
+    STAGE_TIMER("index.neighbours");
+    std::shared_lock<std::shared_mutex> lock(mutex_);
+    const size_t n = files_.size();
+    std::vector<Neighbours> out(n);
+    if (n == 0 || topK == 0) return out;
+    if (threads == 0) threads = std::max(1u, std::thread::hardware_concurrency());
+
+    // a tile of query rows is scored against each candidate row while that row is in
+    // cache, so the whole block is streamed once per tile instead of once per row
+    const size_t tile = 32;
+    std::atomic<size_t> nextTile{0};
+    auto worker = [&] {
+        using Entry = std::pair<float, size_t>;
+        std::vector<std::vector<Entry>> heaps(tile);   // min-heaps on score
+        for (size_t q0 = nextTile.fetch_add(tile); q0 < n; q0 = nextTile.fetch_add(tile)) {
+            const size_t q1 = std::min(n, q0 + tile);
+            for (auto& h : heaps) h.clear();
+
+            for (size_t c = 0; c < n; ++c) {
+                const float* candidate = vectors_.data() + c * dim_;
+                for (size_t q = q0; q < q1; ++q) {
+                    if (q == c) continue;
+                    const float denom = norms_[q] * norms_[c];
+                    const float score = denom == 0.0f ? 0.0f
+                        : VectorMath::dot(candidate, vectors_.data() + q * dim_, dim_) / denom;
+                    auto& h = heaps[q - q0];
+                    if (h.size() < topK) {
+                        h.emplace_back(score, c);
+                        std::push_heap(h.begin(), h.end(), std::greater<Entry>());
+                    } else if (score > h.front().first) {
+                        std::pop_heap(h.begin(), h.end(), std::greater<Entry>());
+                        h.back() = {score, c};
+                        std::push_heap(h.begin(), h.end(), std::greater<Entry>());
+                    }
+                }
+            }
+
+            for (size_t q = q0; q < q1; ++q) {
+                auto& h = heaps[q - q0];
+                std::sort(h.begin(), h.end(), std::greater<Entry>());
+                out[q].path = files_.path(q);
+                out[q].similar.reserve(h.size());
+                for (const auto& [score, c] : h)
+                    out[q].similar.push_back({files_.path(c), files_.name(c), files_.extension(c), score});
+            }
+        }
+    };
+
+    std::vector<std::thread> pool;
+    for (unsigned t = 1; t < threads; ++t) pool.emplace_back(worker);
+    worker();
+    for (auto& t : pool) t.join();
+    return out;
+}
@@ -0,0 +1,564 @@
+// src/cortex_bench.cpp
+// Microbenchmarks for every hot path: tokenizer, embedding, pooling, the
+// similarity kernel, in-memory search (exact and PCA coarse + rescore), query
+// latency under indexing load, sqlite inserts and the file scanner.
+// Results go to a JSON file so runs from different commits can be compared
+// (--baseline prints the p50 ratio against an earlier file).
+//
+//   ./cortex_bench [--out bench.json] [--fake] [--quick] [--sizes 10000,100000]
+//                  [--label <commit>] [--baseline old.json]
+//
+// Without model files (or with --fake) the embedding benchmarks use the
+// deterministic FakeEmbedder, so the suite runs anywhere.
+//
+// Global operator new is counted, so hot paths that must not allocate report
+// "allocs_per_call" next to their timings.
+
+#include "DatabaseManager.hpp"
+#include "EmbeddingEngine.hpp"
+#include "FakeEmbedder.hpp"
+#include "FileScanner.hpp"
+#include "PcaProjection.hpp"
+#include "TaskScheduler.hpp"
+#include "TokenizerClient.hpp"
+#include "VectorIndex.hpp"
+#include "VectorMath.hpp"
+
+#include <nlohmann/json.hpp>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <ctime>
+#include <filesystem>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <new>
+#include <random>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+#include <unistd.h>
+
+using nlohmann::json;
+namespace fs = std::filesystem;
+using Clock = std::chrono::steady_clock;
+
+// ---------- allocation counting ----------
+static std::atomic<uint64_t> g_allocs{0};
+
+void* operator new(std::size_t n) {
+    g_allocs.fetch_add(1, std::memory_order_relaxed);
+    if (void* p = std::malloc(n ? n : 1)) return p;
+    throw std::bad_alloc();
+}
+void operator delete(void* p) noexcept { std::free(p); }
+void operator delete(void* p, std::size_t) noexcept { std::free(p); }
+
+// Heap allocations per call of f() over `iters` calls (after one warm-up call).
+template <class F>
+static double allocsPerCall(size_t iters, F&& f) {
+    f(0);
+    uint64_t before = g_allocs.load(std::memory_order_relaxed);
+    for (size_t i = 0; i < iters; ++i) f(i);
+    return static_cast<double>(g_allocs.load(std::memory_order_relaxed) - before) / static_cast<double>(iters);
+}
+
+// ---------- config ----------
+struct BenchConfig {
+    std::string out      = "bench_results.json";
+    std::string label;
+    std::string baseline;
+    bool fake  = false;
+    bool quick = false;
+    std::vector<size_t> searchSizes{10000, 100000, 1000000};
+
+    std::string onnxModelPath   = "models/model.onnx";
+    std::string pythonExe       = "./.venv/bin/python";
+    std::string tokenizerScript = "tools/tokenize.py";
+    std::string tokenizerJson   = "models/tokenizer.json";
+};
+
+// ---------- measurement helpers ----------
+static double nsSince(Clock::time_point t0) {
+    return std::chrono::duration<double, std::nano>(Clock::now() - t0).count();
+}
+
+// Runs f() `iters` times and returns one sample (ns) per call.
+template <class F>
+static std::vector<double> sample(size_t iters, F&& f) {
+    std::vector<double> ns;
+    ns.reserve(iters);
+    for (size_t i = 0; i < iters; ++i) {
+        auto t0 = Clock::now();
+        f(i);
+        ns.push_back(nsSince(t0));
+    }
+    return ns;
+}
+
+static double percentile(std::vector<double> v, double p) {
+    if (v.empty()) return 0.0;
+    std::sort(v.begin(), v.end());
+    size_t idx = static_cast<size_t>(p * static_cast<double>(v.size() - 1) + 0.5);
+    return v[std::min(idx, v.size() - 1)];
+}
+
+// One JSON record per benchmark. `opsPerSample` > 1 when a sample times a batch.
+static json record(const std::string& name, const json& params,
+                   const std::vector<double>& ns, double opsPerSample = 1.0) {
+    double total = 0.0;
+    for (double x : ns) total += x;
+    double mean = ns.empty() ? 0.0 : total / static_cast<double>(ns.size());
+
+    json r;
+    r["name"]        = name;
+    r["params"]      = params;
+    r["samples"]     = ns.size();
+    r["mean_ns"]     = mean / opsPerSample;
+    r["p50_ns"]      = percentile(ns, 0.50) / opsPerSample;
+    r["p95_ns"]      = percentile(ns, 0.95) / opsPerSample;
+    r["p99_ns"]      = percentile(ns, 0.99) / opsPerSample;
+    r["ops_per_sec"] = mean > 0.0 ? 1e9 * opsPerSample / mean : 0.0;
+
+    std::cout << std::left << std::setw(22) << name << " " << std::setw(34) << params.dump()
+              << " p50 " << std::setw(12) << r["p50_ns"].get<double>() << " ns"
+              << "  " << r["ops_per_sec"].get<double>() << " ops/s\n";
+    return r;
+}
+
+static json skipped(const std::string& name, const std::string& why) {
+    std::cout << std::left << std::setw(22) << name << " skipped: " << why << "\n";
+    return {{"name", name}, {"skipped", why}};
+}
+
+static std::string wordsText(size_t words, std::mt19937& rng) {
+    static const char* vocab[] = {"project", "budget", "solar", "report", "draft", "meeting",
+                                  "invoice", "resume", "internship", "quarter", "design", "notes",
+                                  "analysis", "summary", "contract", "schedule"};
+    std::uniform_int_distribution<size_t> pick(0, sizeof(vocab) / sizeof(vocab[0]) - 1);
+    std::string s;
+    for (size_t i = 0; i < words; ++i) {
+        if (i) s += ' ';
+        s += vocab[pick(rng)];
+    }
+    return s;
+}
+
+static std::vector<float> randomUnitVector(size_t dim, std::mt19937& rng) {
+    std::normal_distribution<float> nd(0.0f, 1.0f);
+    std::vector<float> v(dim);
+    for (auto& x : v) x = nd(rng);
+    VectorMath::l2Normalize(v.data(), v.size());
+    return v;
+}
+
+// ---------- benchmarks ----------
+static void benchTokenizer(const BenchConfig& cfg, json& out) {
+    if (cfg.fake || !fs::exists(cfg.pythonExe) || !fs::exists(cfg.tokenizerJson)) {
+        out.push_back(skipped("tokenizer_encode", "python venv or tokenizer.json not found"));
+        return;
+    }
+    TokenizerClient tok(cfg.pythonExe, cfg.tokenizerScript, cfg.tokenizerJson, 256);
+    std::mt19937 rng(1);
+    for (size_t words : {16, 256}) {
+        std::string text = wordsText(words, rng);
+        auto ns = sample(cfg.quick ? 3 : 10, [&](size_t) { tok.encode(text); });
+        out.push_back(record("tokenizer_encode", {{"words", words}}, ns));
+    }
+}
+
+static void benchEmbedding(const BenchConfig& cfg, json& out) {
+    std::unique_ptr<Embedder> embedder;
+    std::string backend = "fake";
+    if (!cfg.fake && fs::exists(cfg.onnxModelPath) && fs::exists(cfg.pythonExe)) {
+        embedder = std::make_unique<EmbeddingEngine>(cfg.onnxModelPath, cfg.pythonExe,
+                                                     cfg.tokenizerScript, cfg.tokenizerJson, 256);
+        backend = "onnx";
+    } else {
+        embedder = std::make_unique<FakeEmbedder>();
+    }
+
+    auto t0 = Clock::now();
+    bool ok = embedder->warmUp();
+    out.push_back(record("embedding_warmup", {{"backend", backend}}, {nsSince(t0)}));
+    if (!ok) return;
+
+    std::mt19937 rng(2);
+    const size_t iters = backend == "onnx" ? (cfg.quick ? 3 : 20) : (cfg.quick ? 200 : 2000);
+    for (size_t words : {16, 64, 256, 1024}) {
+        std::string text = wordsText(words, rng);
+        auto ns = sample(iters, [&](size_t) { embedder->createEmbedding(text); });
+        out.push_back(record("embedding", {{"backend", backend}, {"words", words}}, ns));
+    }
+
+    // model only (tokenized once up front): should not touch the heap at all
+    auto* engine = dynamic_cast<EmbeddingEngine*>(embedder.get());
+    if (!engine) {
+        out.push_back(skipped("embedding_infer", "needs the onnx backend"));
+        return;
+    }
+    TokenizerClient tok(cfg.pythonExe, cfg.tokenizerScript, cfg.tokenizerJson, 256);
+    for (size_t words : {16, 256}) {
+        auto T = tok.encode(wordsText(words, rng));
+        if (!T) continue;
+        std::vector<float> pooled(engine->dimension());
+        auto call = [&](size_t) {
+            engine->embedTokens(T->input_ids.data(), T->attention_mask.data(), T->input_ids.size(), pooled.data());
+        };
+        json r = record("embedding_infer", {{"words", words}}, sample(iters, call));
+        r["allocs_per_call"] = allocsPerCall(iters, call);
+        std::cout << "  allocs/call " << r["allocs_per_call"].get<double>() << "\n";
+        out.push_back(r);
+    }
+}
+
+static void benchPooling(const BenchConfig& cfg, json& out) {
+    const size_t hidden = 384;
+    std::mt19937 rng(3);
+    std::uniform_real_distribution<float> ud(-1.0f, 1.0f);
+    for (size_t seq : {32, 128, 256}) {
+        std::vector<float> H(seq * hidden);
+        for (auto& x : H) x = ud(rng);
+        std::vector<int64_t> mask(seq, 0);
+        std::fill(mask.begin(), mask.begin() + static_cast<long>(seq * 3 / 4), 1);
+        std::vector<float> pooled(hidden);
+
+        auto ns = sample(cfg.quick ? 500 : 5000, [&](size_t) {
+            VectorMath::maskedMeanPool(H.data(), mask.data(), seq, hidden, pooled.data());
+            VectorMath::l2Normalize(pooled.data(), hidden);
+        });
+        out.push_back(record("pooling", {{"seq", seq}, {"hidden", hidden}}, ns));
+
+        auto fused = [&](size_t) {
+            VectorMath::maskedMeanPoolNormalize(H.data(), mask.data(), seq, hidden, pooled.data());
+        };
+        json r = record("pooling_fused", {{"seq", seq}, {"hidden", hidden}}, sample(cfg.quick ? 500 : 5000, fused));
+        r["allocs_per_call"] = allocsPerCall(100, fused);
+        out.push_back(r);
+    }
+}
+
+static void benchSimilarity(const BenchConfig& cfg, json& out) {
+    const size_t dim = 384, batch = 10000;
+    std::mt19937 rng(4);
+    std::vector<float> a = randomUnitVector(dim, rng), b = randomUnitVector(dim, rng);
+    volatile float sink = 0.0f;
+
+    auto dotNs = sample(cfg.quick ? 20 : 100, [&](size_t) {
+        float s = 0.0f;
+        for (size_t i = 0; i < batch; ++i) s += VectorMath::dot(a.data(), b.data(), dim);
+        sink = s;
+    });
+    out.push_back(record("similarity_dot", {{"dim", dim}}, dotNs, batch));
+
+    auto cosNs = sample(cfg.quick ? 20 : 100, [&](size_t) {
+        float s = 0.0f;
+        for (size_t i = 0; i < batch; ++i) s += VectorMath::cosineSimilarity(a.data(), b.data(), dim);
+        sink = s;
+    });
+    out.push_back(record("similarity_cosine", {{"dim", dim}}, cosNs, batch));
+    (void)sink;
+}
+
+static void benchSearch(const BenchConfig& cfg, json& out) {
+    const size_t dim = 384;
+    for (size_t n : cfg.searchSizes) {
+        std::mt19937 rng(static_cast<unsigned>(5 + n));
+        VectorIndex index;
+
+        // 10 groups of 100-file directories, zero-padded so generation order is path order
+        auto t0 = Clock::now();
+        index.load([&](const VectorIndex::RowVisitor& visit) {
+            FileRow row;
+            char buf[64];
+            std::vector<float> v;
+            for (size_t i = 0; i < n; ++i) {
+                std::snprintf(buf, sizeof(buf), "/bench/g%02zu/d%06zu/f%09zu", i * 10 / n, i / 100, i);
+                row.id = static_cast<long long>(i);
+                row.path = std::string(buf) + ((i % 2) ? ".pdf" : ".txt");
+                row.name = row.path.substr(row.path.rfind('/') + 1);
+                row.extension = (i % 2) ? ".pdf" : ".txt";
+                row.last_modified = static_cast<long long>(i);
+                v = randomUnitVector(dim, rng);
+                visit(row, v.data(), dim);
+            }
+        });
+        json build = record("search_build", {{"vectors", n}}, {nsSince(t0)}, static_cast<double>(n));
+        build["metadata_bytes_per_file"] = static_cast<double>(index.metadataBytes()) / static_cast<double>(n);
+        out.push_back(build);
+
+        std::vector<std::vector<float>> queries;
+        for (int q = 0; q < 20; ++q) queries.push_back(randomUnitVector(dim, rng));
+
+        SearchOptions opts;
+        opts.topK = 10;
+        size_t iters = cfg.quick ? 5 : (n >= 1000000 ? 20 : 50);
+        auto ns = sample(iters, [&](size_t i) { index.search(queries[i % queries.size()], opts); });
+        out.push_back(record("search_exact", {{"vectors", n}, {"k", 10}}, ns));
+
+        // one group (~10% of the rows) plus an extension filter that halves it again
+        SearchOptions filtered = opts;
+        filtered.filter.underPath  = "/bench/g03";
+        filtered.filter.extensions = {".pdf"};
+        auto fns = sample(iters, [&](size_t i) { index.search(queries[i % queries.size()], filtered); });
+        out.push_back(record("search_filtered", {{"vectors", n}, {"k", 10}}, fns));
+    }
+}
+
+// Real embeddings sit near a low-dimensional subspace (random vectors don't, and PCA
+// would have nothing to find): rows are a 48-d latent mixed up to 384-d plus noise.
+static void benchSearchCoarse(const BenchConfig& cfg, json& out) {
+    const size_t dim = 384, latent = 48;
+    std::mt19937 rng(11);
+    std::normal_distribution<float> nd(0.0f, 1.0f);
+    std::vector<float> mix(dim * latent);
+    for (auto& x : mix) x = nd(rng);
+    auto structured = [&]() {
+        std::vector<float> z(latent), v(dim);
+        for (auto& x : z) x = nd(rng);
+        for (size_t d = 0; d < dim; ++d) v[d] = VectorMath::dot(mix.data() + d * latent, z.data(), latent) + 2.0f * nd(rng);
+        VectorMath::l2Normalize(v.data(), dim);
+        return v;
+    };
+
+    for (size_t n : cfg.searchSizes) {
+        VectorIndex index;
+        index.load([&](const VectorIndex::RowVisitor& visit) {
+            FileRow row;
+            char buf[64];
+            for (size_t i = 0; i < n; ++i) {
+                std::snprintf(buf, sizeof(buf), "/bench/c%09zu.txt", i);
+                row.path = buf;
+                row.name = row.path.substr(7);
+                row.extension = ".txt";
+                std::vector<float> v = structured();
+                visit(row, v.data(), dim);
+            }
+        });
+        std::vector<std::vector<float>> queries;
+        for (int q = 0; q < 20; ++q) queries.push_back(structured());
+        SearchOptions exact;
+        exact.topK = 10;
+        size_t iters = cfg.quick ? 5 : (n >= 1000000 ? 20 : 50);
+
+        for (size_t reduced : {64, 128}) {
+            auto t0 = Clock::now();
+            index.setProjection(PcaProjection::train(index, reduced));
+            out.push_back(record("pca_train_project", {{"vectors", n}, {"dims", reduced}}, {nsSince(t0)}));
+
+            SearchOptions coarse = exact;
+            coarse.coarse = true;
+            auto ns = sample(iters, [&](size_t i) { index.search(queries[i % queries.size()], coarse); });
+            json rec = record("search_coarse", {{"vectors", n}, {"k", 10}, {"dims", reduced}}, ns);
+
+            // recall@10 of the coarse + rescore path against the exact scan
+            size_t hits = 0;
+            for (const auto& q : queries) {
+                auto want = index.search(q, exact), got = index.search(q, coarse);
+                for (const auto& w : want)
+                    for (const auto& g : got) hits += (w.path == g.path);
+            }
+            rec["recall_at_10"] = static_cast<double>(hits) / static_cast<double>(queries.size() * 10);
+            out.push_back(rec);
+        }
+        index.setProjection(nullptr);
+        auto ns = sample(iters, [&](size_t i) { index.search(queries[i % queries.size()], exact); });
+        out.push_back(record("search_exact_structured", {{"vectors", n}, {"k", 10}}, ns));
+    }
+}
+
+// Query latency while "indexing" saturates the cores the way an embedding run does
+// (each background step fans out to every core, like ORT's intra-op threads).
+// Unscheduled, queries fight for CPU; with the TaskScheduler the background steps
+// stop while a query is queued, so loaded p99 should stay close to idle.
+static void benchScheduler(const BenchConfig& cfg, json& out) {
+    const size_t dim = 384, n = 20000;
+    std::mt19937 rng(13);
+    VectorIndex index;
+    index.load([&](const VectorIndex::RowVisitor& visit) {
+        FileRow row;
+        for (size_t i = 0; i < n; ++i) {
+            row.path = "/bench/s" + std::to_string(1000000 + i);
+            std::vector<float> v = randomUnitVector(dim, rng);
+            visit(row, v.data(), dim);
+        }
+    });
+    std::vector<float> query = randomUnitVector(dim, rng);
+    SearchOptions opts;
+    opts.topK = 10;
+
+    const unsigned cores = std::max(1u, std::thread::hardware_concurrency());
+    auto busyStep = [&] {
+        std::vector<std::thread> team;
+        for (unsigned t = 0; t < cores; ++t)
+            team.emplace_back([] {
+                auto until = Clock::now() + std::chrono::milliseconds(2);
+                volatile float sink = 0.0f;
+                while (Clock::now() < until) sink = sink + 1.0f;
+            });
+        for (auto& t : team) t.join();
+    };
+
+    TaskScheduler scheduler(1);
+    const size_t iters = cfg.quick ? 30 : 200;
+    auto queries = [&](bool scheduled) {
+        std::vector<double> ns;
+        for (size_t i = 0; i < iters; ++i) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));   // think time, not timed
+            auto t0 = Clock::now();
+            TaskScheduler::Slot slot;
+            if (scheduled) slot = scheduler.acquire(TaskScheduler::Priority::Interactive);
+            index.search(query, opts);
+            ns.push_back(nsSince(t0));
+        }
+        return ns;
+    };
+
+    auto idle = queries(false);
+    json idleRec = record("sched_query_idle", {{"vectors", n}}, idle);
+    out.push_back(idleRec);
+
+    for (bool scheduled : {false, true}) {
+        std::atomic<bool> stop{false};
+        std::thread indexing([&] {
+            while (!stop) {
+                TaskScheduler::Slot slot;
+                if (scheduled) slot = scheduler.acquire(TaskScheduler::Priority::Background);
+                busyStep();
+                if (scheduled) scheduler.yield(slot);
+                busyStep();
+            }
+        });
+        auto loaded = queries(scheduled);
+        stop = true;
+        indexing.join();
+
+        json rec = record(scheduled ? "sched_query_loaded" : "sched_query_loaded_unscheduled",
+                          {{"vectors", n}, {"cores", cores}}, loaded);
+        rec["p99_vs_idle"] = rec["p99_ns"].get<double>() / std::max(1.0, idleRec["p99_ns"].get<double>());
+        out.push_back(rec);
+    }
+}
+
+static void benchDatabase(const BenchConfig& cfg, const fs::path& scratch, json& out) {
+    const size_t n = cfg.quick ? 200 : 2000;
+    fs::path dbPath = scratch / "bench.db";
+    std::mt19937 rng(6);
+
+    DatabaseManager db(dbPath.string());
+    std::vector<float> v = randomUnitVector(384, rng);
+    auto ns = sample(n, [&](size_t i) {
+        std::string path = "/bench/db/file" + std::to_string(i) + ".txt";
+        db.insertFile(path, "file" + std::to_string(i) + ".txt", ".txt", v, static_cast<long>(i));
+    });
+    out.push_back(record("db_insert", {{"rows", n}}, ns));
+
+    auto loadNs = sample(cfg.quick ? 2 : 5, [&](size_t) { db.getAllFiles(); });
+    out.push_back(record("db_get_all", {{"rows", n}}, loadNs));
+}
+
+static void benchScanner(const BenchConfig& cfg, const fs::path& scratch, json& out) {
+    const size_t dirs = cfg.quick ? 10 : 40, perDir = 100;
+    fs::path root = scratch / "tree";
+    for (size_t d = 0; d < dirs; ++d) {
+        fs::path dir = root / ("dir" + std::to_string(d)) / "nested";
+        fs::create_directories(dir);
+        for (size_t f = 0; f < perDir; ++f)
+            std::ofstream(dir / ("file" + std::to_string(f) + ".txt")) << "x";
+    }
+
+    FileScanner scanner;
+    auto ns = sample(cfg.quick ? 3 : 10, [&](size_t) { scanner.scanDirectory(root.string()); });
+    out.push_back(record("file_scanner", {{"files", dirs * perDir}}, ns));
+}
+
+// ---------- baseline comparison ----------
+static void compareWithBaseline(const json& current, const std::string& baselinePath) {
+    std::ifstream in(baselinePath);
+    json base = json::parse(in, nullptr, false);
+    if (base.is_discarded() || !base.contains("benchmarks")) {
+        std::cerr << "Could not read baseline " << baselinePath << "\n";
+        return;
+    }
+
+    std::cout << "\nvs baseline " << base.value("label", baselinePath) << " (p50, <1 is faster):\n";
+    for (const auto& cur : current["benchmarks"]) {
+        if (!cur.contains("p50_ns")) continue;
+        for (const auto& old : base["benchmarks"]) {
+            if (old.value("name", "") != cur["name"] || old.value("params", json()) != cur["params"]) continue;
+            if (!old.contains("p50_ns") || old["p50_ns"].get<double>() <= 0.0) break;
+            double ratio = cur["p50_ns"].get<double>() / old["p50_ns"].get<double>();
+            std::cout << "  " << std::left << std::setw(22) << cur["name"].get<std::string>() << " "
+                      << std::setw(34) << cur["params"].dump() << " x" << std::fixed
+                      << std::setprecision(3) << ratio << std::defaultfloat << "\n";
+            break;
+        }
+    }
+}
+
+static bool parseArgs(int argc, char* argv[], BenchConfig& cfg) {
+    for (int i = 1; i < argc; ++i) {
+        std::string a = argv[i];
+        auto next = [&]() -> std::string { return (i + 1 < argc) ? argv[++i] : ""; };
+        if (a == "--out") cfg.out = next();
+        else if (a == "--label") cfg.label = next();
+        else if (a == "--baseline") cfg.baseline = next();
+        else if (a == "--fake") cfg.fake = true;
+        else if (a == "--quick") { cfg.quick = true; cfg.searchSizes = {10000}; }
+        else if (a == "--sizes") {
+            cfg.searchSizes.clear();
+            std::stringstream list(next());
+            std::string item;
+            while (std::getline(list, item, ','))
+                if (!item.empty()) cfg.searchSizes.push_back(std::stoul(item));
+        } else {
+            std::cerr << "Unknown option: " << a << "\n";
+            return false;
+        }
+    }
+    return true;
+}
+
+int main(int argc, char* argv[]) {
+    BenchConfig cfg;
+    if (!parseArgs(argc, argv, cfg)) {
+        std::cerr << "Usage: " << argv[0]
+                  << " [--out file.json] [--label name] [--baseline old.json] [--fake] [--quick] [--sizes a,b,c]\n";
+        return 1;
+    }
+
+    fs::path scratch = fs::temp_directory_path() / ("cortex_bench_" + std::to_string(::getpid()));
+    fs::create_directories(scratch);
+
+    json benchmarks = json::array();
+    benchTokenizer(cfg, benchmarks);
+    benchEmbedding(cfg, benchmarks);
+    benchPooling(cfg, benchmarks);
+    benchSimilarity(cfg, benchmarks);
+    benchSearch(cfg, benchmarks);
+    benchSearchCoarse(cfg, benchmarks);
+    benchScheduler(cfg, benchmarks);
+    benchDatabase(cfg, scratch, benchmarks);
+    benchScanner(cfg, scratch, benchmarks);
+
+    std::error_code ec;
+    fs::remove_all(scratch, ec);
+
+    json result;
+    result["label"]      = cfg.label;
+    result["timestamp"]  = static_cast<long long>(std::time(nullptr));
+    result["quick"]      = cfg.quick;
+    result["benchmarks"] = benchmarks;
+
+    std::ofstream(cfg.out) << result.dump(2) << "\n";
+    std::cout << "\nWrote " << cfg.out << "\n";
+
+    if (!cfg.baseline.empty()) compareWithBaseline(result, cfg.baseline);
+    return 0;
+}
@@ -0,0 +1,311 @@
+// src/cortex_drift.cpp
+// Checks how far the quantized model exports (int8 / fp16, see tools/quantize.py)
+// drift from the fp32 model before they are used for indexing.
+// Embeds testData/ plus a seeded synthetic corpus with every variant and reports,
+// against fp32:
+//   - cosine drift per document (1 - cos(fp32, variant)): mean / p50 / p95 / max
+//   - top-K overlap: for each query, |topK(fp32) ∩ topK(variant)| / K
+//   - throughput of the model run (docs/sec), the reason to quantize at all
+// Every text is tokenized once and the same ids are fed to each engine.
+// "static" (the token table from tools/export_static.py) is a different model, not a
+// rounding of fp32: it gets top-K overlap and docs/sec only, and its rate includes its
+// own in-process tokenization, which the ONNX rates leave out.
+//
+//   ./cortex_drift [--data testData] [--synthetic 300] [--queries 60] [--k 10]
+//                  [--variants int8,fp16,static] [--seed 7] [--out drift.json]
+
+#include "ContextExtractor.hpp"
+#include "EmbeddingEngine.hpp"
+#include "FileScanner.hpp"
+#include "Indexer.hpp"
+#include "TokenizerClient.hpp"
+#include "VectorMath.hpp"
+
+#include <nlohmann/json.hpp>
+
+#include <algorithm>
+#include <chrono>
+#include <filesystem>
+#include <fstream>
+#include <iomanip>
+#include <iterator>
+#include <iostream>
+#include <memory>
+#include <random>
+#include <sstream>
+#include <string>
+#include <vector>
+
+using nlohmann::json;
+namespace fs = std::filesystem;
+using Clock = std::chrono::steady_clock;
+
+struct DriftConfig {
+    std::string data = "testData";
+    size_t synthetic = 300;
+    size_t queries   = 60;
+    size_t k         = 10;
+    unsigned seed    = 7;
+    std::vector<std::string> variants{"int8", "fp16"};
+    std::string out  = "drift_results.json";
+
+    std::string onnxModelPath   = "models/model.onnx";
+    std::string pythonExe       = "./.venv/bin/python";
+    std::string tokenizerScript = "tools/tokenize.py";
+    std::string tokenizerJson   = "models/tokenizer.json";
+    size_t maxSeqLen = 256;
+};
+
+// ---------- corpus ----------
+// Topical word pools so the synthetic corpus has real neighbours to rank.
+static const std::vector<std::vector<std::string>> kTopics = {
+    {"budget", "invoice", "quarter", "revenue", "expenses", "forecast", "tax", "payroll"},
+    {"solar", "panel", "battery", "inverter", "grid", "energy", "roof", "installation"},
+    {"resume", "internship", "experience", "skills", "education", "interview", "offer", "manager"},
+    {"meeting", "agenda", "notes", "action", "items", "deadline", "schedule", "team"},
+    {"recipe", "flour", "oven", "sugar", "butter", "bake", "minutes", "dough"},
+    {"contract", "clause", "party", "agreement", "liability", "term", "signature", "law"},
+};
+
+static std::string sentence(std::mt19937& rng, size_t words, size_t topic) {
+    const auto& pool = kTopics[topic % kTopics.size()];
+    const auto& noise = kTopics[(topic + 1 + rng() % (kTopics.size() - 1)) % kTopics.size()];
+    std::uniform_int_distribution<size_t> pick(0, pool.size() - 1);
+    std::bernoulli_distribution offTopic(0.15);
+    std::string s;
+    for (size_t i = 0; i < words; ++i) {
+        if (i) s += ' ';
+        s += offTopic(rng) ? noise[pick(rng)] : pool[pick(rng)];
+    }
+    return s;
+}
+
+static std::vector<std::string> loadTestData(const std::string& dir) {
+    std::vector<std::string> texts;
+    if (!fs::exists(dir)) return texts;
+    FileScanner scanner;
+    ContextExtractor extractor;
+    for (const auto& file : scanner.scanDirectory(dir)) {
+        if (!Indexer::isCorrectFileType(file.extension)) continue;
+        std::string text = extractor.extractText(file.path);
+        if (!text.empty()) texts.push_back(std::move(text));
+    }
+    return texts;
+}
+
+// ---------- stats ----------
+static double percentile(std::vector<double> v, double p) {
+    if (v.empty()) return 0.0;
+    std::sort(v.begin(), v.end());
+    size_t idx = static_cast<size_t>(p * static_cast<double>(v.size() - 1) + 0.5);
+    return v[std::min(idx, v.size() - 1)];
+}
+
+static std::vector<size_t> topK(const std::vector<float>& query, const std::vector<float>& docs,
+                                size_t dim, size_t k) {
+    const size_t n = docs.size() / dim;
+    std::vector<std::pair<float, size_t>> scored(n);
+    for (size_t i = 0; i < n; ++i)
+        scored[i] = {VectorMath::dot(query.data(), docs.data() + i * dim, dim), i};
+    k = std::min(k, n);
+    std::partial_sort(scored.begin(), scored.begin() + static_cast<long>(k), scored.end(),
+                      [](const auto& a, const auto& b) { return a.first > b.first; });
+    std::vector<size_t> ids(k);
+    for (size_t i = 0; i < k; ++i) ids[i] = scored[i].second;
+    std::sort(ids.begin(), ids.end());
+    return ids;
+}
+
+// ---------- embedding ----------
+struct Encoded { std::vector<TokenizerResults> tokens; };
+
+// rows of `dim` floats (vectors are unit length, so dot == cosine); docs/sec in `rate`
+static bool embedAll(EmbeddingEngine& engine, const Encoded& in, std::vector<float>& out, double& rate) {
+    if (!engine.warmUp()) return false;
+    const size_t dim = engine.dimension();
+    out.assign(in.tokens.size() * dim, 0.0f);
+    auto t0 = Clock::now();
+    for (size_t i = 0; i < in.tokens.size(); ++i) {
+        const auto& t = in.tokens[i];
+        if (!engine.embedTokens(t.input_ids.data(), t.attention_mask.data(), t.input_ids.size(),
+                                out.data() + i * dim))
+            return false;
+    }
+    double secs = std::chrono::duration<double>(Clock::now() - t0).count();
+    rate = secs > 0.0 ? static_cast<double>(in.tokens.size()) / secs : 0.0;
+    return true;
+}
+
+// the static table embeds raw text; same layout and rate as embedAll
+static bool embedTexts(EmbeddingEngine& engine, const std::vector<std::string>& texts,
+                       std::vector<float>& out, double& rate) {
+    if (!engine.warmUp()) return false;
+    const size_t dim = engine.dimension();
+    out.assign(texts.size() * dim, 0.0f);
+    auto t0 = Clock::now();
+    for (size_t i = 0; i < texts.size(); ++i) {
+        auto v = engine.createEmbedding(texts[i]);
+        // a text with no known token stays a zero row, it ranks last for every query
+        if (v.size() == dim) std::copy(v.begin(), v.end(), out.begin() + static_cast<long>(i * dim));
+    }
+    double secs = std::chrono::duration<double>(Clock::now() - t0).count();
+    rate = secs > 0.0 ? static_cast<double>(texts.size()) / secs : 0.0;
+    return true;
+}
+
+static bool parseArgs(int argc, char* argv[], DriftConfig& cfg) {
+    for (int i = 1; i < argc; ++i) {
+        std::string a = argv[i];
+        if (i + 1 >= argc) return false;
+        std::string v = argv[++i];
+        if (a == "--data") cfg.data = v;
+        else if (a == "--synthetic") cfg.synthetic = std::stoul(v);
+        else if (a == "--queries") cfg.queries = std::stoul(v);
+        else if (a == "--k") cfg.k = std::max<size_t>(1, std::stoul(v));
+        else if (a == "--seed") cfg.seed = static_cast<unsigned>(std::stoul(v));
+        else if (a == "--out") cfg.out = v;
+        else if (a == "--variants") {
+            cfg.variants.clear();
+            std::stringstream list(v);
+            std::string item;
+            while (std::getline(list, item, ','))
+                if (!item.empty()) cfg.variants.push_back(item);
+        } else {
+            std::cerr << "Unknown option: " << a << "\n";
+            return false;
+        }
+    }
+    return true;
+}
+
+int main(int argc, char* argv[]) {
+    DriftConfig cfg;
+    if (!parseArgs(argc, argv, cfg)) {
+        std::cerr << "Usage: " << argv[0] << " [--data dir] [--synthetic n] [--queries n] [--k n]"
+                  << " [--variants int8,fp16,static] [--seed n] [--out file.json]\n";
+        return 1;
+    }
+
+    // corpus: real files first, then the synthetic documents; queries are short
+    // synthetic sentences plus the opening words of each real file
+    std::mt19937 rng(cfg.seed);
+    std::vector<std::string> docs = loadTestData(cfg.data);
+    const size_t realDocs = docs.size();
+    for (size_t i = 0; i < cfg.synthetic; ++i) docs.push_back(sentence(rng, 40 + rng() % 160, i));
+
+    std::vector<std::string> queries;
+    for (size_t i = 0; i < cfg.queries; ++i) queries.push_back(sentence(rng, 3 + rng() % 5, rng()));
+    for (size_t i = 0; i < realDocs; ++i) {
+        std::istringstream words(docs[i]);
+        std::string w, q;
+        for (int n = 0; n < 8 && words >> w; ++n) q += (n ? " " : "") + w;
+        if (!q.empty()) queries.push_back(q);
+    }
+
+    TokenizerClient tok(cfg.pythonExe, cfg.tokenizerScript, cfg.tokenizerJson, static_cast<int>(cfg.maxSeqLen));
+    Encoded docTokens, queryTokens;
+    for (const auto* list : {&docs, &queries}) {
+        Encoded& dst = (list == &docs) ? docTokens : queryTokens;
+        for (const auto& text : *list) {
+            auto t = tok.encode(text);
+            if (!t) {
+                std::cerr << "Tokenizer failed; is the python venv set up?\n";
+                return 1;
+            }
+            dst.tokens.push_back(std::move(*t));
+        }
+    }
+    std::cout << "corpus: " << realDocs << " files from " << cfg.data << " + " << cfg.synthetic
+              << " synthetic docs, " << queries.size() << " queries, k=" << cfg.k << "\n";
+
+    EmbeddingEngine reference(cfg.onnxModelPath, cfg.pythonExe, cfg.tokenizerScript,
+                              cfg.tokenizerJson, cfg.maxSeqLen, "fp32");
+    std::vector<float> refDocs, refQueries;
+    double refRate = 0.0, unused = 0.0;
+    if (!embedAll(reference, docTokens, refDocs, refRate) || !embedAll(reference, queryTokens, refQueries, unused)) {
+        std::cerr << "fp32 model failed to load from " << cfg.onnxModelPath << "\n";
+        return 1;
+    }
+    const size_t dim = reference.dimension();
+
+    json report;
+    report["seed"]      = cfg.seed;
+    report["documents"] = docs.size();
+    report["queries"]   = queries.size();
+    report["k"]         = cfg.k;
+    report["fp32_docs_per_sec"] = refRate;
+    report["variants"]  = json::array();
+
+    for (const auto& variant : cfg.variants) {
+        std::string path = EmbeddingEngine::variantModelPath(cfg.onnxModelPath, variant);
+        if (!EmbeddingEngine::isKnownVariant(variant) || !fs::exists(path)) {
+            std::cout << std::left << std::setw(6) << variant << " skipped: " << path
+                      << " not found (tools/" << (variant == "static" ? "export_static" : "quantize") << ".py)\n";
+            report["variants"].push_back({{"variant", variant}, {"skipped", path + " not found"}});
+            continue;
+        }
+
+        EmbeddingEngine engine(cfg.onnxModelPath, cfg.pythonExe, cfg.tokenizerScript,
+                               cfg.tokenizerJson, cfg.maxSeqLen, variant);
+        const bool isStatic = variant == "static";
+        std::vector<float> vDocs, vQueries;
+        double rate = 0.0;
+        const bool embedded = isStatic
+            ? embedTexts(engine, docs, vDocs, rate) && embedTexts(engine, queries, vQueries, unused)
+            : embedAll(engine, docTokens, vDocs, rate) && embedAll(engine, queryTokens, vQueries, unused) &&
+              engine.dimension() == dim;
+        if (!embedded) {
+            report["variants"].push_back({{"variant", variant}, {"skipped", "failed to embed"}});
+            continue;
+        }
+        const size_t vDim = engine.dimension();
+
+        // cosine drift only means something between two exports of the same model
+        std::vector<double> drift;
+        for (size_t i = 0; !isStatic && i < docs.size(); ++i)
+            drift.push_back(1.0 - VectorMath::dot(refDocs.data() + i * dim, vDocs.data() + i * dim, dim));
+
+        std::vector<double> overlap(queries.size());
+        for (size_t q = 0; q < queries.size(); ++q) {
+            std::vector<float> rq(refQueries.begin() + static_cast<long>(q * dim),
+                                  refQueries.begin() + static_cast<long>((q + 1) * dim));
+            std::vector<float> vq(vQueries.begin() + static_cast<long>(q * vDim),
+                                  vQueries.begin() + static_cast<long>((q + 1) * vDim));
+            auto a = topK(rq, refDocs, dim, cfg.k);
+            auto b = topK(vq, vDocs, vDim, cfg.k);
+            std::vector<size_t> both;
+            std::set_intersection(a.begin(), a.end(), b.begin(), b.end(), std::back_inserter(both));
+            overlap[q] = a.empty() ? 1.0 : static_cast<double>(both.size()) / static_cast<double>(a.size());
+        }
+
+        double meanDrift = 0.0, meanOverlap = 0.0;
+        for (double d : drift) meanDrift += d;
+        for (double o : overlap) meanOverlap += o;
+        meanDrift   /= static_cast<double>(std::max<size_t>(1, drift.size()));
+        meanOverlap /= static_cast<double>(std::max<size_t>(1, overlap.size()));
+
+        json r = {
+            {"variant", variant},
+            {"dimension", vDim},
+            {"topk_overlap", {{"mean", meanOverlap}, {"min", percentile(overlap, 0.0)}}},
+            {"docs_per_sec", rate},
+            {"speedup_vs_fp32", refRate > 0.0 ? rate / refRate : 0.0},
+        };
+        std::cout << std::left << std::setw(6) << variant;
+        if (!isStatic) {
+            r["cosine_drift"] = {{"mean", meanDrift}, {"p50", percentile(drift, 0.50)},
+                                 {"p95", percentile(drift, 0.95)}, {"max", percentile(drift, 1.0)}};
+            std::cout << " drift mean " << meanDrift << " p95 " << percentile(drift, 0.95)
+                      << " max " << percentile(drift, 1.0) << " |";
+        } else {
+            std::cout << " " << vDim << " dims |";
+        }
+        std::cout << " top-" << cfg.k << " overlap mean " << meanOverlap << " min " << percentile(overlap, 0.0)
+                  << " | " << rate << " docs/s (x" << r["speedup_vs_fp32"].get<double>() << ")\n";
+        report["variants"].push_back(r);
+    }
+
+    std::ofstream(cfg.out) << report.dump(2) << "\n";
+    std::cout << "Wrote " << cfg.out << "\n";
+    return 0;
+}
@@ -0,0 +1,591 @@
+// src/cortex_load.cpp
+// End-to-end load generator. Builds a seeded synthetic corpus (file count, size range,
+// txt/pdf mix), indexes it, then replays a query log against the in-process engine or
+// a running search daemon and reports QPS, p50/p95/p99/p999 latency and peak RSS.
+// The same seed gives the same corpus and the same queries, so two builds can be
+// compared run for run (--baseline; --tolerance turns a regression into exit code 2).
+//
+//   ./cortex_load [--files 2000] [--size 1k-64k] [--mix txt:0.9,pdf:0.1] [--seed 7]
+//                 [--corpus dir] [--db load.db] [--queries log.jsonl] [--requests 2000]
+//                 [--concurrency 4 | --rate 200] [--k 10] [--socket cortex.sock]
+//                 [--fake] [--out load.json] [--label name] [--baseline old.json]
+//                 [--tolerance 0.1]
+//
+// Query log: one JSON object per line in the daemon's search format
+//   {"query":"budget forecast","k":5,"ext":[".pdf"],"under":"/dir","coarse":true}
+// lines without a "query" string are skipped. Without --queries a seeded log is
+// generated from the corpus topics.
+//
+// --concurrency runs a closed loop (each worker sends its next query as soon as the
+// last one returns). --rate sends on a fixed schedule instead and measures latency from
+// the scheduled send time, so a stall shows up in the percentiles instead of lowering
+// the offered load.
+//
+// Without model files (or with --fake) the deterministic FakeEmbedder is used. With
+// --socket the daemon indexes the corpus and answers the queries with its own model;
+// "peak_rss_kb" is then the daemon's (from its stats), not this process's.
+
+#include "ContextExtractor.hpp"
+#include "DatabaseManager.hpp"
+#include "EmbeddingEngine.hpp"
+#include "FakeEmbedder.hpp"
+#include "Indexer.hpp"
+#include "SearchEngine.hpp"
+#include "SearchServer.hpp"
+#include "VectorIndex.hpp"
+
+#include <nlohmann/json.hpp>
+
+#include <algorithm>
+#include <atomic>
+#include <cctype>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <ctime>
+#include <filesystem>
+#include <fstream>
+#include <functional>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <random>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+#include <sys/resource.h>
+#include <unistd.h>
+
+using nlohmann::json;
+namespace fs = std::filesystem;
+using Clock = std::chrono::steady_clock;
+
+struct LoadConfig {
+    // corpus
+    size_t files    = 2000;
+    size_t minBytes = 1024;
+    size_t maxBytes = 64 * 1024;
+    std::vector<std::pair<std::string, double>> mix{{".txt", 0.9}, {".pdf", 0.1}};
+    unsigned seed   = 7;
+    std::string corpus;   // empty: a scratch directory removed afterwards
+    std::string db;       // empty: a fresh scratch database
+
+    // replay
+    std::string queryLog;
+    size_t requests = 0;  // 0: one pass over the log
+    int concurrency = 0;  // 0: 4 workers closed loop, up to 64 in flight open loop
+    double rate     = 0;  // > 0: open loop at this many requests per second
+    int k           = 10;
+    std::string socketPath;
+
+    std::string out = "load_results.json";
+    std::string label;
+    std::string baseline;
+    double tolerance = 0;
+
+    bool fake = false;
+    std::string onnxModelPath   = "models/model.onnx";
+    std::string pythonExe       = "./.venv/bin/python";
+    std::string tokenizerScript = "tools/tokenize.py";
+    std::string tokenizerJson   = "models/tokenizer.json";
+};
+
+// ---------- corpus ----------
+// Topical word pools so queries have real neighbours to find.
+static const std::vector<std::vector<std::string>> kTopics = {
+    {"budget", "invoice", "quarter", "revenue", "expenses", "forecast", "tax", "payroll"},
+    {"solar", "panel", "battery", "inverter", "grid", "energy", "roof", "installation"},
+    {"resume", "internship", "experience", "skills", "education", "interview", "offer", "manager"},
+    {"meeting", "agenda", "notes", "action", "items", "deadline", "schedule", "team"},
+    {"recipe", "flour", "oven", "sugar", "butter", "bake", "minutes", "dough"},
+    {"contract", "clause", "party", "agreement", "liability", "term", "signature", "law"},
+    {"trip", "flight", "hotel", "itinerary", "booking", "passport", "luggage", "airport"},
+    {"patient", "dose", "clinic", "symptoms", "prescription", "allergy", "visit", "lab"},
+};
+
+static std::string sentence(std::mt19937& rng, size_t words, size_t topic) {
+    const auto& pool = kTopics[topic % kTopics.size()];
+    const auto& noise = kTopics[(topic + 1 + rng() % (kTopics.size() - 1)) % kTopics.size()];
+    std::uniform_int_distribution<size_t> pick(0, pool.size() - 1);
+    std::bernoulli_distribution offTopic(0.15);
+    std::string s;
+    for (size_t i = 0; i < words; ++i) {
+        if (i) s += ' ';
+        s += offTopic(rng) ? noise[pick(rng)] : pool[pick(rng)];
+    }
+    return s;
+}
+
+// lines of about 80 characters until `bytes` of text
+static std::vector<std::string> body(std::mt19937& rng, size_t bytes, size_t topic) {
+    std::vector<std::string> lines;
+    size_t total = 0;
+    while (total < bytes) {
+        lines.push_back(sentence(rng, 12, topic));
+        total += lines.back().size() + 1;
+    }
+    return lines;
+}
+
+static std::string pdfEscape(const std::string& s) {
+    std::string out;
+    for (char c : s) {
+        if (c == '(' || c == ')' || c == '\\') out += '\\';
+        out += c;
+    }
+    return out;
+}
+
+// Smallest PDF pdftotext reads: Helvetica text, 60 lines per page, real xref offsets.
+static void writePdf(const fs::path& path, const std::vector<std::string>& lines) {
+    const size_t perPage = 60;
+    const size_t pages = std::max<size_t>(1, (lines.size() + perPage - 1) / perPage);
+
+    // 1 catalog, 2 page tree, 3 font, then a page + content stream pair per page
+    std::vector<std::string> objects(3 + 2 * pages);
+    std::string kids;
+    for (size_t p = 0; p < pages; ++p) {
+        const size_t pageObj = 4 + 2 * p;
+        kids += std::to_string(pageObj) + " 0 R ";
+
+        std::string stream = "BT /F1 10 Tf 12 TL 40 760 Td\n";
+        for (size_t l = p * perPage; l < std::min(lines.size(), (p + 1) * perPage); ++l)
+            stream += "(" + pdfEscape(lines[l]) + ") Tj T*\n";
+        stream += "ET";
+
+        objects[pageObj - 1] = "<< /Type /Page /Parent 2 0 R /MediaBox [0 0 612 792] /Resources << /Font << /F1 3 0 R >> >> /Contents " +
+                               std::to_string(pageObj + 1) + " 0 R >>";
+        objects[pageObj] = "<< /Length " + std::to_string(stream.size()) + " >>\nstream\n" + stream + "\nendstream";
+    }
+    objects[0] = "<< /Type /Catalog /Pages 2 0 R >>";
+    objects[1] = "<< /Type /Pages /Kids [" + kids + "] /Count " + std::to_string(pages) + " >>";
+    objects[2] = "<< /Type /Font /Subtype /Type1 /BaseFont /Helvetica >>";
+
+    std::string pdf = "%PDF-1.4\n";
+    std::vector<size_t> offsets;
+    for (size_t i = 0; i < objects.size(); ++i) {
+        offsets.push_back(pdf.size());
+        pdf += std::to_string(i + 1) + " 0 obj\n" + objects[i] + "\nendobj\n";
+    }
+    const size_t xref = pdf.size();
+    pdf += "xref\n0 " + std::to_string(objects.size() + 1) + "\n0000000000 65535 f \n";
+    char entry[32];
+    for (size_t off : offsets) {
+        std::snprintf(entry, sizeof(entry), "%010zu 00000 n \n", off);
+        pdf += entry;
+    }
+    pdf += "trailer\n<< /Size " + std::to_string(objects.size() + 1) + " /Root 1 0 R >>\nstartxref\n" +
+           std::to_string(xref) + "\n%%EOF\n";
+    std::ofstream(path, std::ios::binary) << pdf;
+}
+
+static json corpusStamp(const LoadConfig& cfg) {
+    json mix = json::object();
+    for (const auto& [ext, share] : cfg.mix) mix[ext] = share;
+    return {{"seed", cfg.seed}, {"files", cfg.files}, {"min_bytes", cfg.minBytes},
+            {"max_bytes", cfg.maxBytes}, {"mix", mix}};
+}
+
+// Writes <dir>/t<topic>/d<nnn>/f<nnnnnn>.<ext>. A directory already holding the same
+// stamp (seed, counts, sizes, mix) is reused as is, so large corpora are written once.
+// Returns the bytes of text generated.
+static size_t generateCorpus(const LoadConfig& cfg, const fs::path& dir, bool& reused) {
+    const fs::path stampPath = dir / ".cortex_load.json";
+    const json stamp = corpusStamp(cfg);
+    {
+        std::ifstream in(stampPath);
+        json old = json::parse(in, nullptr, false);
+        if (!old.is_discarded() && old.value("config", json()) == stamp) {
+            reused = true;
+            return old.value("bytes", size_t(0));
+        }
+    }
+    reused = false;
+    std::error_code ec;
+    fs::remove_all(dir, ec);
+    fs::create_directories(dir);
+
+    std::mt19937 rng(cfg.seed);
+    std::uniform_real_distribution<double> logSize(std::log(static_cast<double>(cfg.minBytes)),
+                                                   std::log(static_cast<double>(cfg.maxBytes)));
+    std::vector<double> weights;
+    for (const auto& m : cfg.mix) weights.push_back(m.second);
+    std::discrete_distribution<size_t> pickType(weights.begin(), weights.end());
+
+    size_t bytes = 0;
+    char name[64];
+    for (size_t i = 0; i < cfg.files; ++i) {
+        const size_t topic = rng() % kTopics.size();
+        const std::string& ext = cfg.mix[pickType(rng)].first;
+        const size_t size = static_cast<size_t>(std::exp(logSize(rng)));
+
+        fs::path sub = dir / ("t" + std::to_string(topic)) / ("d" + std::to_string(i / 100));
+        fs::create_directories(sub);
+        std::snprintf(name, sizeof(name), "f%06zu", i);
+        fs::path file = sub / (name + ext);
+
+        std::vector<std::string> lines = body(rng, size, topic);
+        for (const auto& l : lines) bytes += l.size() + 1;
+        if (ext == ".pdf") {
+            writePdf(file, lines);
+        } else {
+            std::ofstream out(file);
+            for (const auto& l : lines) out << l << '\n';
+        }
+    }
+    std::ofstream(stampPath) << json{{"config", stamp}, {"bytes", bytes}}.dump(2) << "\n";
+    return bytes;
+}
+
+// ---------- queries ----------
+static std::vector<json> loadQueryLog(const std::string& path) {
+    std::vector<json> queries;
+    std::ifstream in(path);
+    if (!in) {
+        std::cerr << "Could not open query log " << path << "\n";
+        return queries;
+    }
+    std::string line;
+    size_t skipped = 0;
+    while (std::getline(in, line)) {
+        if (line.empty()) continue;
+        json q = json::parse(line, nullptr, false);
+        if (q.is_discarded() || !q.is_object() || !q.contains("query") || !q["query"].is_string()) {
+            ++skipped;
+            continue;
+        }
+        queries.push_back(std::move(q));
+    }
+    if (skipped) std::cerr << "Skipped " << skipped << " query log lines without a \"query\"\n";
+    return queries;
+}
+
+// 2-6 topic words; a tenth restricted to one topic's directory, a tenth to one type
+static std::vector<json> syntheticQueries(const LoadConfig& cfg, const fs::path& corpus, size_t count) {
+    std::mt19937 rng(cfg.seed + 1);
+    std::uniform_int_distribution<size_t> words(2, 6);
+    std::uniform_real_distribution<double> u(0.0, 1.0);
+    std::vector<json> queries;
+    for (size_t i = 0; i < count; ++i) {
+        const size_t topic = rng() % kTopics.size();
+        json q = {{"query", sentence(rng, words(rng), topic)}, {"k", cfg.k}};
+        double r = u(rng);
+        if (r < 0.1) q["under"] = (corpus / ("t" + std::to_string(topic))).string();
+        else if (r < 0.2) q["ext"] = json::array({cfg.mix[rng() % cfg.mix.size()].first});
+        queries.push_back(std::move(q));
+    }
+    return queries;
+}
+
+// ---------- replay ----------
+// One search; false when it failed (the daemon unreachable or answering ok:false).
+using Target = std::function<bool(const json& query)>;
+
+struct ReplayResult {
+    std::vector<double> latencyNs;
+    size_t errors = 0;
+    double seconds = 0;
+};
+
+static ReplayResult replay(const std::vector<json>& queries, size_t requests, const LoadConfig& cfg,
+                           const Target& target) {
+    const int workers = std::max(1, cfg.concurrency);
+    std::atomic<size_t> next{0};
+    std::atomic<size_t> errors{0};
+    std::vector<std::vector<double>> perWorker(static_cast<size_t>(workers));
+
+    const auto t0 = Clock::now();
+    std::vector<std::thread> pool;
+    for (int w = 0; w < workers; ++w)
+        pool.emplace_back([&, w] {
+            auto& lat = perWorker[static_cast<size_t>(w)];
+            for (size_t i = next++; i < requests; i = next++) {
+                auto start = Clock::now();
+                if (cfg.rate > 0) {
+                    // open loop: latency counts from the scheduled send, queueing included
+                    start = t0 + std::chrono::duration_cast<Clock::duration>(
+                                     std::chrono::duration<double>(static_cast<double>(i) / cfg.rate));
+                    std::this_thread::sleep_until(start);
+                }
+                if (!target(queries[i % queries.size()])) ++errors;
+                lat.push_back(std::chrono::duration<double, std::nano>(Clock::now() - start).count());
+            }
+        });
+    for (auto& t : pool) t.join();
+
+    ReplayResult r;
+    r.seconds = std::chrono::duration<double>(Clock::now() - t0).count();
+    r.errors = errors.load();
+    for (auto& lat : perWorker) r.latencyNs.insert(r.latencyNs.end(), lat.begin(), lat.end());
+    return r;
+}
+
+// ---------- stats ----------
+static double percentile(std::vector<double> v, double p) {
+    if (v.empty()) return 0.0;
+    std::sort(v.begin(), v.end());
+    size_t idx = static_cast<size_t>(p * static_cast<double>(v.size() - 1) + 0.5);
+    return v[std::min(idx, v.size() - 1)];
+}
+
+// ru_maxrss is bytes on macOS, KB elsewhere
+static long long peakRssKb() {
+    rusage usage{};
+    if (::getrusage(RUSAGE_SELF, &usage) != 0) return 0;
+#ifdef __APPLE__
+    return static_cast<long long>(usage.ru_maxrss) / 1024;
+#else
+    return static_cast<long long>(usage.ru_maxrss);
+#endif
+}
+
+// qps and p99 against an earlier run; false when either regressed past the tolerance
+static bool compareWithBaseline(const json& current, const std::string& baselinePath, double tolerance) {
+    std::ifstream in(baselinePath);
+    json base = json::parse(in, nullptr, false);
+    if (base.is_discarded() || !base.contains("replay")) {
+        std::cerr << "Could not read baseline " << baselinePath << "\n";
+        return true;
+    }
+    if (base.value("corpus", json()).value("config", json()) != current["corpus"]["config"])
+        std::cerr << "Baseline used another corpus (seed/files/sizes/mix); ratios are not comparable\n";
+
+    const json& now = current["replay"];
+    const json& old = base["replay"];
+    // open loop offers a fixed rate, so only latency says anything about the build
+    const bool sameLoad = now.value("mode", "") == old.value("mode", "") &&
+                          now.value("rate", 0.0) == old.value("rate", 0.0) &&
+                          now.value("concurrency", 0) == old.value("concurrency", 0);
+    if (!sameLoad) std::cerr << "Baseline ran another load shape (mode/rate/concurrency); qps not compared\n";
+    const double qps = sameLoad && old.value("qps", 0.0) > 0 ? now.value("qps", 0.0) / old["qps"].get<double>() : 0.0;
+    const double p99 = old.value("p99_ms", 0.0) > 0 ? now.value("p99_ms", 0.0) / old["p99_ms"].get<double>() : 0.0;
+    std::cout << "\nvs baseline " << base.value("label", baselinePath) << std::fixed << std::setprecision(3)
+              << ": qps x" << qps << " (>1 is better), p99 x" << p99 << " (<1 is better)\n" << std::defaultfloat;
+
+    if (tolerance <= 0) return true;
+    bool ok = true;
+    if (qps > 0 && qps < 1.0 - tolerance) { std::cerr << "REGRESSION: qps\n"; ok = false; }
+    if (p99 > 1.0 + tolerance)            { std::cerr << "REGRESSION: p99 latency\n"; ok = false; }
+    return ok;
+}
+
+// ---------- options ----------
+// "64k", "2m", "512"
+static bool parseBytes(const std::string& s, size_t& out) {
+    size_t digits = 0;
+    while (digits < s.size() && std::isdigit(static_cast<unsigned char>(s[digits]))) ++digits;
+    if (digits == 0) return false;
+    out = std::stoull(s.substr(0, digits));
+    std::string unit = s.substr(digits);
+    if (unit == "k" || unit == "K") out *= 1024;
+    else if (unit == "m" || unit == "M") out *= 1024 * 1024;
+    else if (!unit.empty() && unit != "b") return false;
+    return out > 0;
+}
+
+static bool parseArgs(int argc, char* argv[], LoadConfig& cfg) {
+    for (int i = 1; i < argc; ++i) {
+        std::string a = argv[i];
+        if (a == "--fake") { cfg.fake = true; continue; }
+        if (i + 1 >= argc) return false;
+        std::string v = argv[++i];
+        if (a == "--files") cfg.files = std::stoul(v);
+        else if (a == "--size") {
+            size_t dash = v.find('-');
+            std::string lo = v.substr(0, dash), hi = dash == std::string::npos ? lo : v.substr(dash + 1);
+            if (!parseBytes(lo, cfg.minBytes) || !parseBytes(hi, cfg.maxBytes) || cfg.minBytes > cfg.maxBytes) {
+                std::cerr << "Bad --size " << v << " (expected e.g. 1k-64k)\n";
+                return false;
+            }
+        } else if (a == "--mix") {
+            cfg.mix.clear();
+            std::stringstream list(v);
+            std::string item;
+            while (std::getline(list, item, ',')) {
+                size_t colon = item.find(':');
+                std::string ext = "." + item.substr(0, colon);
+                double share = colon == std::string::npos ? 1.0 : std::stod(item.substr(colon + 1));
+                if (ext != ".txt" && ext != ".pdf") {
+                    std::cerr << "--mix supports txt and pdf, not " << ext << "\n";
+                    return false;
+                }
+                cfg.mix.push_back({ext, share});
+            }
+            if (cfg.mix.empty()) return false;
+        }
+        else if (a == "--seed") cfg.seed = static_cast<unsigned>(std::stoul(v));
+        else if (a == "--corpus") cfg.corpus = v;
+        else if (a == "--db") cfg.db = v;
+        else if (a == "--queries") cfg.queryLog = v;
+        else if (a == "--requests") cfg.requests = std::stoul(v);
+        else if (a == "--concurrency") cfg.concurrency = std::stoi(v);
+        else if (a == "--rate") cfg.rate = std::stod(v);
+        else if (a == "--k") cfg.k = std::stoi(v);
+        else if (a == "--socket") cfg.socketPath = v;
+        else if (a == "--out") cfg.out = v;
+        else if (a == "--label") cfg.label = v;
+        else if (a == "--baseline") cfg.baseline = v;
+        else if (a == "--tolerance") cfg.tolerance = std::stod(v);
+        else {
+            std::cerr << "Unknown option: " << a << "\n";
+            return false;
+        }
+    }
+    return cfg.files > 0;
+}
+
+int main(int argc, char* argv[]) {
+    LoadConfig cfg;
+    if (!parseArgs(argc, argv, cfg)) {
+        std::cerr << "Usage: " << argv[0]
+                  << " [--files n] [--size 1k-64k] [--mix txt:0.9,pdf:0.1] [--seed n] [--corpus dir] [--db file]\n"
+                  << "       [--queries log.jsonl] [--requests n] [--concurrency n | --rate qps] [--k n]\n"
+                  << "       [--socket path] [--fake] [--out file.json] [--label name] [--baseline old.json]"
+                  << " [--tolerance 0.1]\n";
+        return 1;
+    }
+    // in open-loop mode the workers only bound how many requests can be in flight
+    if (cfg.concurrency <= 0) cfg.concurrency = cfg.rate > 0 ? 64 : 4;
+
+    const fs::path scratch = fs::temp_directory_path() / ("cortex_load_" + std::to_string(::getpid()));
+    const fs::path corpus = fs::absolute(cfg.corpus.empty() ? scratch / "corpus" : fs::path(cfg.corpus));
+    std::error_code ec;
+
+    // ---- corpus ----
+    auto t0 = Clock::now();
+    bool reused = false;
+    const size_t corpusBytes = generateCorpus(cfg, corpus, reused);
+    const double generateSecs = std::chrono::duration<double>(Clock::now() - t0).count();
+    std::cout << (reused ? "Reusing " : "Generated ") << cfg.files << " files (" << corpusBytes / 1024
+              << " KB of text) in " << corpus.string() << "\n";
+
+    std::vector<json> queries = cfg.queryLog.empty()
+        ? syntheticQueries(cfg, corpus, cfg.requests ? cfg.requests : 1000)
+        : loadQueryLog(cfg.queryLog);
+    if (queries.empty()) {
+        std::cerr << "No queries to replay\n";
+        return 1;
+    }
+    const size_t requests = cfg.requests ? cfg.requests : queries.size();
+
+    // ---- index + target ----
+    json indexInfo;
+    Target target;
+    std::unique_ptr<Embedder> embedder;
+    std::unique_ptr<DatabaseManager> db;
+    VectorIndex index;
+    std::unique_ptr<SearchClient> client;
+    ContextExtractor extractor;
+
+    t0 = Clock::now();
+    if (!cfg.socketPath.empty()) {
+        client = std::make_unique<SearchClient>(cfg.socketPath);
+        if (!client->available()) {
+            std::cerr << "No daemon running on " << cfg.socketPath << "\n";
+            return 1;
+        }
+        auto reply = client->request({{"op", "index"}, {"path", corpus.string()}});
+        if (!reply || !reply->value("ok", false)) {
+            std::cerr << "Daemon could not index " << corpus.string() << "\n";
+            return 1;
+        }
+        indexInfo = {{"target", "daemon"}, {"indexed", reply->value("indexed", 0)}};
+        target = [&](const json& q) {
+            json request = q;
+            request["op"] = "search";
+            auto r = client->request(request);
+            return r && r->value("ok", false);
+        };
+    } else {
+        std::string backend = "fake";
+        if (!cfg.fake && fs::exists(cfg.onnxModelPath) && fs::exists(cfg.pythonExe)) {
+            embedder = std::make_unique<EmbeddingEngine>(cfg.onnxModelPath, cfg.pythonExe,
+                                                         cfg.tokenizerScript, cfg.tokenizerJson, 256);
+            backend = "onnx";
+        } else {
+            embedder = std::make_unique<FakeEmbedder>();
+        }
+        if (!embedder->warmUp()) {
+            std::cerr << "Embedding backend failed to load\n";
+            return 1;
+        }
+
+        const fs::path dbPath = cfg.db.empty() ? scratch / "load.db" : fs::path(cfg.db);
+        if (cfg.db.empty()) {
+            fs::create_directories(scratch);
+            fs::remove(dbPath, ec);
+        }
+        db = std::make_unique<DatabaseManager>(dbPath.string());
+        Indexer indexer(*db, extractor, *embedder);
+        int indexed = indexer.indexDirectory(corpus.string());
+        index.load(*db);
+        indexInfo = {{"target", "library"}, {"backend", backend}, {"indexed", indexed}};
+
+        target = [&](const json& q) {
+            SearchOptions options;
+            options.topK   = q.value("k", cfg.k);
+            options.filter = filterFromJson(q);
+            options.coarse = q.value("coarse", false);
+            SearchEngine searcher(*db, *embedder, index);
+            searcher.search(q.value("query", ""), options);
+            return true;
+        };
+    }
+    const double indexSecs = std::chrono::duration<double>(Clock::now() - t0).count();
+    indexInfo["seconds"] = indexSecs;
+    indexInfo["files_per_sec"] = indexSecs > 0 ? static_cast<double>(cfg.files) / indexSecs : 0.0;
+    std::cout << "Indexed " << indexInfo["indexed"] << " files in " << std::fixed << std::setprecision(2)
+              << indexSecs << " s\n" << std::defaultfloat;
+
+    // ---- replay ----
+    for (size_t i = 0; i < std::min<size_t>(10, queries.size()); ++i) target(queries[i]);   // warm caches
+    ReplayResult r = replay(queries, requests, cfg, target);
+
+    json replayInfo = {{"mode", cfg.rate > 0 ? "open" : "closed"},
+                       {"rate", cfg.rate},
+                       {"concurrency", cfg.concurrency},
+                       {"requests", requests},
+                       {"errors", r.errors},
+                       {"seconds", r.seconds},
+                       {"qps", r.seconds > 0 ? static_cast<double>(requests) / r.seconds : 0.0},
+                       {"p50_ms", percentile(r.latencyNs, 0.50) / 1e6},
+                       {"p95_ms", percentile(r.latencyNs, 0.95) / 1e6},
+                       {"p99_ms", percentile(r.latencyNs, 0.99) / 1e6},
+                       {"p999_ms", percentile(r.latencyNs, 0.999) / 1e6},
+                       {"max_ms", percentile(r.latencyNs, 1.0) / 1e6}};
+
+    long long rss = peakRssKb();
+    if (client) {
+        auto stats = client->request({{"op", "stats"}});
+        rss = stats ? stats->value("peak_rss_kb", 0LL) : 0;
+    }
+
+    json result;
+    result["label"]       = cfg.label;
+    result["timestamp"]   = static_cast<long long>(std::time(nullptr));
+    result["corpus"]      = {{"config", corpusStamp(cfg)}, {"bytes", corpusBytes},
+                             {"reused", reused}, {"generate_s", generateSecs}};
+    result["index"]       = indexInfo;
+    result["queries"]     = cfg.queryLog.empty() ? "synthetic" : cfg.queryLog;
+    result["replay"]      = replayInfo;
+    result["peak_rss_kb"] = rss;
+
+    std::cout << std::fixed << std::setprecision(2)
+              << replayInfo["mode"].get<std::string>() << " loop, " << requests << " requests, "
+              << r.errors << " errors\n"
+              << "  qps   " << replayInfo["qps"].get<double>() << "\n"
+              << "  p50   " << replayInfo["p50_ms"].get<double>() << " ms\n"
+              << "  p95   " << replayInfo["p95_ms"].get<double>() << " ms\n"
+              << "  p99   " << replayInfo["p99_ms"].get<double>() << " ms\n"
+              << "  p999  " << replayInfo["p999_ms"].get<double>() << " ms\n"
+              << "  peak rss " << rss / 1024 << " MB" << (client ? " (daemon)" : "") << "\n"
+              << std::defaultfloat;
+
+    std::ofstream(cfg.out) << result.dump(2) << "\n";
+    std::cout << "Wrote " << cfg.out << "\n";
+
+    fs::remove_all(scratch, ec);
+    if (!cfg.baseline.empty() && !compareWithBaseline(result, cfg.baseline, cfg.tolerance)) return 2;
+    return 0;
+}
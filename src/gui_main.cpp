@@ -4,6 +4,11 @@
 #include "EmbeddingEngine.hpp"
 #include "DatabaseManager.hpp"
 #include "SearchEngine.hpp"
+#include "Indexer.hpp"
+#include "QueryExecutor.hpp"
+#include "FileListView.hpp"
+#include "VectorIndex.hpp"
+#include "TaskScheduler.hpp"
 
 #include "imgui.h"
 #include "backends/imgui_impl_glfw.h"
@@ -20,21 +25,6 @@
 #include <thread>
 #include <vector>
 
-// ---------- helpers copied from CLI semantics ----------
-static bool isCorrectFileType(const std::string& extension) {
-    return (extension == ".txt" || extension == ".pdf" || extension == ".png" ||
-            extension == ".jpg" || extension == ".jpeg");
-}
-
-static std::time_t getLastModified(std::string& filePath) {
-    auto ftime = std::filesystem::last_write_time(filePath);
-    auto sctp = std::chrono::time_point_cast<std::chrono::system_clock::duration>(
-        ftime - std::filesystem::file_time_type::clock::now()
-        + std::chrono::system_clock::now()
-    );
-    return std::chrono::system_clock::to_time_t(sctp);
-}
-
 // tiny macOS opener
 static void openFileNative(const std::string& path) {
 #ifdef __APPLE__
@@ -79,16 +69,25 @@ int main() {
     const size_t      maxSeqLen       = 256;
 
     ContextExtractor extractor;
-    EmbeddingEngine  embedder(onnxModelPath, pythonExe, tokenizerScript, tokenizerJson, maxSeqLen);
     DatabaseManager  db("cortex.db");
-    SearchEngine     searcher(db, embedder);
-    FileScanner      scanner;
+    // embed with the same model export the index was built with
+    EmbeddingEngine  embedder(onnxModelPath, pythonExe, tokenizerScript, tokenizerJson, maxSeqLen,
+                              db.getMetadata("model_variant", "fp32"));
+    // warm index so a keystroke never goes back to sqlite; reloaded after indexing
+    VectorIndex      vectorIndex;
+    vectorIndex.load(db);
+    // queries and the indexing thread share the engine; queries always go first
+    TaskScheduler    scheduler(1);
+    SearchEngine     searcher(db, embedder, vectorIndex);
+    searcher.scheduler = &scheduler;
+    // searches run here, the render loop only reads the latest snapshot
+    QueryExecutor    queries(searcher);
 
     // ------------- UI state -------------
-    std::vector<FileRow> indexedFiles;   // <— now FileRow, not tuples
+    FileListView indexedFiles(db);       // pages rows in from sqlite as they scroll into view
     std::string fileFilter;
     std::string queryText;
-    std::vector<SearchResult> searchResults;
+    SearchOptions searchOptions;
 
     std::string indexDirPath;
     std::atomic<bool> isIndexing{false};
@@ -96,18 +95,7 @@ int main() {
     std::atomic<int> filesDiscovered{0};
     std::string indexStatus;
 
-    // show currently indexed files (simple and robust):
-    // reuse your existing heavy reader for now (loads blobs but works).
-    // If you add a light listFiles() later, swap it in here.
-    auto loadIndexedFiles = [&]() {
-        // returns tuples: (path, name, extension, vector<float>)
-        return db.listFiles(200);
-    };
-    indexedFiles = loadIndexedFiles();
-
-    auto refreshIndexedFiles = [&]() {
-        indexedFiles = loadIndexedFiles();
-    };
+    std::atomic<bool> indexChanged{false};   // set by the indexing thread, consumed per frame
 
     auto startIndexing = [&]() {
         if (isIndexing.load()) return;
@@ -120,35 +108,21 @@ int main() {
 
         std::thread([&, dir = indexDirPath](){
             try {
-                // 1) discover files exactly like CLI
-                std::vector<FileInfo> files = scanner.scanDirectory(dir);
-                filesDiscovered = static_cast<int>(files.size());
-
-                // 2) process each file (same flow as CLI indexFiles)
-                int localCount = 0;
-                for (const auto& file : files) {
-                    if (!isCorrectFileType(file.extension)) continue;
-
-                    std::string filePath = file.path;
-                    std::time_t lastModified = getLastModified(filePath);
-
-                    std::string context = extractor.extractText(file.path);
-                    if (context.empty()) continue;
-
-                    std::vector<float> embeddingVector = embedder.createEmbedding(context);
-                    if (embeddingVector.empty()) continue;
-
-                    if (db.insertFile(file.path, file.name, file.extension, embeddingVector, lastModified)) {
-                        ++localCount;
-                        filesIndexed = localCount;
-                    }
-                }
+                // same pipeline as the CLI; counters feed the progress bar
+                Indexer indexer(db, extractor, embedder);
+                indexer.scheduler = &scheduler;
+                indexer.onDiscovered = [&](int total) { filesDiscovered = total; };
+                indexer.onFile = [&](const FileInfo&, IndexOutcome outcome) {
+                    if (outcome == IndexOutcome::Indexed) ++filesIndexed;
+                };
+                indexer.indexDirectory(dir);
+                vectorIndex.load(db);
                 indexStatus = "Index complete.";
             } catch (const std::exception& e) {
                 indexStatus = std::string("Index error: ") + e.what();
             }
             isIndexing = false;
-            refreshIndexedFiles();
+            indexChanged = true;
         }).detach();
     };
 
@@ -161,34 +135,43 @@ int main() {
 
         // Left pane: Indexed Files
         ImGui::Begin("Indexed Files");
-        if (ImGui::Button("Refresh")) {
-            refreshIndexedFiles();
+        if (ImGui::Button("Refresh") || indexChanged.exchange(false)) {
+            indexedFiles.refresh();
         }
         ImGui::SameLine();
-        ImGui::TextDisabled("%zu files", indexedFiles.size());
+        ImGui::TextDisabled("%lld files", indexedFiles.size());
 
-        ImGui::InputTextWithHint("##filter", "Filter by name/path…", &fileFilter);
+        // matching happens in sqlite (trigram index), not per frame over every row
+        if (ImGui::InputTextWithHint("##filter", "Filter by name/path…", &fileFilter)) {
+            indexedFiles.setFilter(fileFilter);
+        }
 
-        if (ImGui::BeginTable("filesTable", 2, ImGuiTableFlags_RowBg|ImGuiTableFlags_BordersV|ImGuiTableFlags_SizingStretchProp)) {
+        if (ImGui::BeginTable("filesTable", 2, ImGuiTableFlags_RowBg|ImGuiTableFlags_BordersV|ImGuiTableFlags_SizingStretchProp|ImGuiTableFlags_ScrollY)) {
+            ImGui::TableSetupScrollFreeze(0, 1);
             ImGui::TableSetupColumn("Name", ImGuiTableColumnFlags_WidthStretch, 0.5f);
             ImGui::TableSetupColumn("Path", ImGuiTableColumnFlags_WidthStretch, 1.5f);
             ImGui::TableHeadersRow();
 
-            for (const auto& f : indexedFiles) {
-                if (!fileFilter.empty()) {
-                    std::string hay = f.name + " " + f.path;
-                    if (hay.find(fileFilter) == std::string::npos) continue;
-                }
-                ImGui::TableNextRow();
-                ImGui::TableSetColumnIndex(0);
-                if (ImGui::Selectable(f.name.c_str(), false)) {}
-                if (ImGui::IsItemHovered() && ImGui::IsMouseDoubleClicked(0)) {
-                    openFileNative(f.path);
+            // only the visible rows are submitted (and fetched)
+            ImGuiListClipper clipper;
+            clipper.Begin(static_cast<int>(indexedFiles.size()));
+            while (clipper.Step()) {
+                for (int i = clipper.DisplayStart; i < clipper.DisplayEnd; ++i) {
+                    const FileRow* f = indexedFiles.row(i);
+                    ImGui::TableNextRow();
+                    if (!f) continue;
+                    ImGui::PushID(i);
+                    ImGui::TableSetColumnIndex(0);
+                    if (ImGui::Selectable(f->name.c_str(), false)) {}
+                    if (ImGui::IsItemHovered() && ImGui::IsMouseDoubleClicked(0)) {
+                        openFileNative(f->path);
+                    }
+                    ImGui::TableSetColumnIndex(1);
+                    ImGui::TextUnformatted(f->path.c_str());
+                    ImGui::PopID();
                 }
-                ImGui::TableSetColumnIndex(1);
-                ImGui::TextUnformatted(f.path.c_str());
-                        }
-                        ImGui::EndTable();
+            }
+            ImGui::EndTable();
         }
         ImGui::End();
 
@@ -196,18 +179,29 @@ int main() {
         ImGui::Begin("Search & Index");
 
         ImGui::SeparatorText("Search");
-        bool doSearch = false;
-        if (ImGui::InputTextWithHint("##query", "Type your query… (Enter to search)", &queryText,
-                                     ImGuiInputTextFlags_EnterReturnsTrue)) {
-            doSearch = true;
-        }
+        // every edit is submitted; the executor debounces and cancels the stale ones
+        bool edited = ImGui::InputTextWithHint("##query", "Type your query…", &queryText);
+        bool submitNow = ImGui::IsItemDeactivated() && ImGui::IsKeyPressed(ImGuiKey_Enter);
         ImGui::SameLine();
-        if (ImGui::Button("Search")) doSearch = true;
+        if (ImGui::Button("Search")) submitNow = true;
 
-        if (doSearch) {
-            // Use your CLI's exact path: SearchEngine::search(query)
-            searchResults = searcher.search(queryText);
-        }
+        ImGui::SameLine();
+        // revised drafts and copies share one row; re-run the query when toggled
+        if (ImGui::Checkbox("Collapse duplicates", &searchOptions.collapseDuplicates) && !queryText.empty())
+            submitNow = true;
+
+        if (submitNow)   queries.submit(queryText, searchOptions, /*immediate=*/true);
+        else if (edited) queries.submit(queryText, searchOptions);
+
+        std::shared_ptr<const QuerySnapshot> snapshot = queries.latest();
+        // early results of a long scan are drawn right away and refined in place
+        if (queries.busy() && snapshot->completeness < 1.0)
+            ImGui::TextDisabled("refining… %d%% scored, %zu results so far",
+                                static_cast<int>(snapshot->completeness * 100.0), snapshot->results.size());
+        else if (queries.busy()) ImGui::TextDisabled("searching…");
+        else if (!snapshot->query.empty())
+            ImGui::TextDisabled("%zu results in %.1f ms", snapshot->results.size(), snapshot->latencyMs);
+        else ImGui::TextDisabled(" ");
 
         if (ImGui::BeginTable("resultsTable", 3, ImGuiTableFlags_RowBg|ImGuiTableFlags_BordersV|ImGuiTableFlags_SizingStretchProp)) {
             ImGui::TableSetupColumn("Score", ImGuiTableColumnFlags_WidthFixed, 80.f);
@@ -215,7 +209,7 @@ int main() {
             ImGui::TableSetupColumn("Path",  ImGuiTableColumnFlags_WidthStretch, 1.4f);
             ImGui::TableHeadersRow();
 
-            for (const auto& r : searchResults) {
+            for (const auto& r : snapshot->results) {
                 ImGui::TableNextRow();
                 ImGui::TableSetColumnIndex(0);
                 ImGui::Text("%.3f", r.score);
@@ -228,6 +222,10 @@ int main() {
 
                 ImGui::TableSetColumnIndex(2);
                 ImGui::TextUnformatted(r.path.c_str());
+                if (r.duplicates > 0) {
+                    ImGui::SameLine();
+                    ImGui::TextDisabled("(+%d near-duplicates)", r.duplicates);
+                }
             }
             ImGui::EndTable();
         }
@@ -0,0 +1,217 @@
+// src/index_smoke.cpp
+// Indexing behaviour that needs no model files (FakeEmbedder):
+//   - --extract-budget parsing
+//   - a journaled run that dies mid-way resumes where it stopped
+//   - near-duplicate followers stay findable when their representative changes
+#include "Indexer.hpp"
+#include "FakeEmbedder.hpp"
+#include "VectorIndex.hpp"
+#include <chrono>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <random>
+#include <stdexcept>
+
+namespace fs = std::filesystem;
+
+static int failures = 0;
+
+#define CHECK(cond)                                                              \
+  do {                                                                           \
+    if (!(cond)) {                                                               \
+      std::cerr << __FILE__ << ":" << __LINE__ << ": check failed: " #cond "\n"; \
+      ++failures;                                                                \
+    }                                                                            \
+  } while (0)
+
+// counts model runs; throws on a text containing "poison" while armed
+struct TestEmbedder : FakeEmbedder {
+  int calls = 0;
+  bool poisoned = false;
+  std::vector<float> createEmbedding(const std::string& text) override {
+    if (poisoned && text.find("poison") != std::string::npos) throw std::runtime_error("embedder died");
+    ++calls;
+    return FakeEmbedder::createEmbedding(text);
+  }
+};
+
+// a few hundred random words, deterministic for a seed
+static std::string randomText(unsigned seed) {
+  std::mt19937 rng(seed);
+  std::string out;
+  for (int i = 0; i < 400; ++i) {
+    if (i) out += (i % 12 == 0) ? ".\n" : " ";
+    const int letters = 3 + static_cast<int>(rng() % 6);
+    for (int j = 0; j < letters; ++j) out += static_cast<char>('a' + rng() % 26);
+  }
+  return out;
+}
+
+static void writeFile(const fs::path& path, const std::string& text) {
+  std::ofstream(path) << text;
+}
+
+static std::string absolutePath(const fs::path& path) {
+  return fs::absolute(path).lexically_normal().string();
+}
+
+static void budgetParsing() {
+  ExtractionBudget b;
+  CHECK(b.parse("64k") && b.maxBytes == 64 * 1024);
+  CHECK(b.parse("2m") && b.maxBytes == 2 * 1024 * 1024);
+  CHECK(b.parse("4096") && b.maxBytes == 4096);
+  CHECK(b.parse("512t") && b.maxBytes == 512 * ExtractionBudget::kBytesPerToken);
+  CHECK(b.parse("5p") && b.maxPages == 5);
+  CHECK(b.parse("3PAGES") && b.maxPages == 3);
+
+  // rejected without touching the budget
+  const ExtractionBudget before = b;
+  for (const char* bad : {"", "k", "xd", "0", "-5k", "12q", "99999999999999999999",
+                          "17592186044416m", "2147483648p"}) {
+    CHECK(!b.parse(bad));
+  }
+  CHECK(b.maxBytes == before.maxBytes && b.maxPages == before.maxPages);
+}
+
+static void journalResume(const fs::path& dir) {
+  const fs::path corpus = dir / "resume";
+  fs::create_directories(corpus);
+  const int files = 12;
+  for (int i = 0; i < files; ++i)
+    writeFile(corpus / ("doc" + std::to_string(i) + ".txt"), randomText(100 + static_cast<unsigned>(i)));
+  // the run dies at this file's batch; the batches scanned before it are committed
+  writeFile(corpus / "doc6.txt", randomText(106) + " poison");
+
+  DatabaseManager db((dir / "resume.db").string());
+  ContextExtractor extractor;
+  TestEmbedder embedder;
+
+  embedder.poisoned = true;
+  bool threw = false;
+  try {
+    Indexer indexer(db, extractor, embedder);
+    indexer.batchSize = 4;
+    indexer.duplicateDistance = -1;
+    indexer.indexDirectory(corpus.string());
+  } catch (const std::exception&) {
+    threw = true;
+  }
+  CHECK(threw);
+  const long long storedBefore = db.countFiles();
+  // whole batches or nothing: the failed batch left no rows behind
+  CHECK(storedBefore < files);
+  CHECK(storedBefore % 4 == 0);
+  CHECK(!db.isUpToDate(absolutePath(corpus / "doc6.txt"), 1));
+
+  embedder.poisoned = false;
+  embedder.calls = 0;
+  Indexer indexer(db, extractor, embedder);
+  indexer.batchSize = 4;
+  indexer.duplicateDistance = -1;
+  indexer.resume = true;
+  const int indexed = indexer.indexDirectory(corpus.string());
+  CHECK(db.countFiles() == files);
+  // only what the failed run had not committed is embedded again
+  CHECK(indexed == files - storedBefore);
+  CHECK(embedder.calls == files - storedBefore);
+}
+
+static void representativeChange(const fs::path& dir) {
+  const fs::path corpus = dir / "groups";
+  fs::create_directories(corpus);
+  const std::string original = randomText(7);
+  writeFile(corpus / "a.txt", original);
+  for (int i = 0; i < 5; ++i)
+    writeFile(corpus / ("other" + std::to_string(i) + ".txt"), randomText(200 + static_cast<unsigned>(i)));
+
+  const std::string dbPath = (dir / "groups.db").string();
+  ContextExtractor extractor;
+  const std::vector<float> query = FakeEmbedder().createEmbedding(original);
+  SearchOptions options;
+  options.topK = 10;
+  SearchOptions collapsed = options;
+  collapsed.collapseDuplicates = true;
+
+  // a.txt is indexed first, so it represents the group its copies join
+  {
+    DatabaseManager db(dbPath);
+    TestEmbedder embedder;
+    Indexer indexer(db, extractor, embedder);
+    CHECK(indexer.indexDirectory(corpus.string()) == 6);
+  }
+  writeFile(corpus / "b_copy.txt", original);
+  writeFile(corpus / "c_copy.txt", original);
+  {
+    DatabaseManager db(dbPath);
+    TestEmbedder embedder;
+    Indexer indexer(db, extractor, embedder);
+    CHECK(indexer.indexDirectory(corpus.string()) == 2);
+    CHECK(embedder.calls == 0);   // the copies reuse a.txt's vector
+
+    VectorIndex index;
+    index.load(db);
+    auto results = index.search(query, collapsed);
+    CHECK(!results.empty() && results[0].duplicates == 2);
+  }
+
+  // a.txt becomes something else and is re-indexed: it leaves the group, and the
+  // copies must still be found under their (unchanged) text
+  writeFile(corpus / "a.txt", randomText(8));
+  fs::last_write_time(corpus / "a.txt", fs::file_time_type::clock::now() + std::chrono::hours(1));
+  {
+    DatabaseManager db(dbPath);
+    TestEmbedder embedder;
+    Indexer indexer(db, extractor, embedder);
+    CHECK(indexer.indexDirectory(corpus.string()) == 1);
+
+    VectorIndex index;
+    index.load(db);
+    CHECK(index.vectorOf(absolutePath(corpus / "b_copy.txt")) == query);
+    CHECK(index.vectorOf(absolutePath(corpus / "c_copy.txt")) == query);
+
+    int copiesFound = 0;
+    for (const auto& r : index.search(query, options)) {
+      if (r.name == "b_copy.txt" || r.name == "c_copy.txt") ++copiesFound;
+      if (r.name == "a.txt") CHECK(r.score < 0.9f);
+    }
+    CHECK(copiesFound == 2);
+
+    auto results = index.search(query, collapsed);
+    CHECK(!results.empty() && results[0].name != "a.txt" && results[0].duplicates == 1);
+  }
+
+  // one of the copies now represents the group, so a new copy still finds it and
+  // reuses the vector instead of running the model
+  writeFile(corpus / "d_copy.txt", original);
+  {
+    DatabaseManager db(dbPath);
+    TestEmbedder embedder;
+    Indexer indexer(db, extractor, embedder);
+    CHECK(indexer.indexDirectory(corpus.string()) == 1);
+    CHECK(embedder.calls == 0);
+
+    VectorIndex index;
+    index.load(db);
+    auto results = index.search(query, collapsed);
+    CHECK(!results.empty() && results[0].duplicates == 2);
+  }
+}
+
+int main() {
+  const fs::path dir = fs::temp_directory_path() / "cortex_index_test";
+  fs::remove_all(dir);
+  fs::create_directories(dir);
+
+  budgetParsing();
+  journalResume(dir);
+  representativeChange(dir);
+
+  fs::remove_all(dir);
+  if (failures) {
+    std::cerr << failures << " check(s) failed\n";
+    return 1;
+  }
+  std::cout << "index_test: ok\n";
+  return 0;
+}
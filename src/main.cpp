@@ -3,34 +3,188 @@
 #include "EmbeddingEngine.hpp"
 #include "DatabaseManager.hpp"
 #include "SearchEngine.hpp"
+#include "Indexer.hpp"
+#include "SearchServer.hpp"
+#include "ShardSet.hpp"
+#include "Metrics.hpp"
+#include "PcaProjection.hpp"
+#include "IndexGovernor.hpp"
 
+#include <algorithm>
 #include <iostream>
 #include <cstdlib>
+#include <charconv>
 #include <chrono>
 #include <ctime>
 #include <filesystem>
+#include <iomanip>
+#include <sstream>
 #include <string>
 #include <vector>
 
+// Options that follow the mode/input pair
+struct CliOptions {
+    SearchOptions search;
+    ServerConfig  server;
+    bool local = false;   // never hand off to a running daemon
+    std::string statsPath;  // per-stage latency/throughput JSON written on exit
+    std::string tracePath;  // chrome trace-event JSON for this run
+    std::string modelVariant;  // fp32 | int8 | fp16; empty = whatever the index was built with
+    std::string shardDir;      // sharded index directory; empty = the single cortex.db
+    std::string shardName;     // --attach: name of the new shard (default: the root's folder name)
+    bool resume = false;       // --index continues the directory's interrupted run
+    ExtractionBudget budget;   // how much text is read from each file
+    int ocrJobs = 0;           // images OCR'd at once; 0 = the extractor's default
+    bool ocrTriage = true;     // skip images the pre-OCR check finds no text in
+    float minScore = 0.0f;     // --similar-all: only report neighbours at least this close
+    GovernorLimits governor;   // how much of the machine indexing may take
+    int budgetMs = 0;          // --search: return the best found within this many ms; 0 = scan it all
+};
+
+static bool isQuarantineMode(const std::string& mode) {
+    return mode == "--quarantined" || mode == "--release";
+}
+
+static bool isShardMode(const std::string& mode) {
+    return mode == "--attach" || mode == "--detach" || mode == "--rebuild" || mode == "--list-shards";
+}
+
+// --attach without --shard names the shard after the root's folder
+static std::string attachName(const std::string& root, const CliOptions& options) {
+    if (!options.shardName.empty()) return options.shardName;
+    std::filesystem::path p = std::filesystem::absolute(root).lexically_normal();
+    if (!p.has_filename()) p = p.parent_path();
+    return p.filename().string();
+}
+
 // Forward decls
-void indexFiles(const std::string& path, DatabaseManager& dbManager, ContextExtractor& extractor, EmbeddingEngine& embedder);
-void searchFiles(const std::string& query, DatabaseManager& dbManager, EmbeddingEngine& embedder);
-std::time_t getLastModified(std::string& filePath);
-bool isCorrectFileType(const std::string& extension);
+void indexFiles(const std::string& path, DatabaseManager& dbManager, ContextExtractor& extractor, EmbeddingEngine& embedder,
+                bool resume, const GovernorLimits& limits);
+int quarantineMode(const std::string& mode, const std::string& input, DatabaseManager& dbManager);
+void refreshProjection(DatabaseManager& dbManager, size_t dims);
+void searchFiles(const std::string& query, DatabaseManager& dbManager, EmbeddingEngine& embedder, const SearchOptions& options,
+                 int budgetMs);
+int similarFiles(const std::string& path, DatabaseManager& dbManager, EmbeddingEngine& embedder, const SearchOptions& options,
+                 int budgetMs);
+int similarReport(DatabaseManager& dbManager, const CliOptions& options);
+int runShardMode(const std::string& mode, const std::string& input, const CliOptions& options,
+                 ContextExtractor& extractor, EmbeddingEngine& embedder);
+void printResults(const std::vector<SearchResult>& results);
+bool parseFlags(int argc, char* argv[], int first, CliOptions& options);
+// "Images: ..." line for the end of an indexing run; nothing when no image was seen
+static void printOcrSummary(const ContextExtractor& extractor) {
+    const OcrStats ocr = extractor.ocrStats();
+    if (ocr.ocred + ocr.skipped == 0) return;
+    std::cout << "Images: " << ocr.ocred << " OCR'd (" << static_cast<int>(ocr.ocrSeconds) << " s), "
+              << ocr.skipped << " skipped as text-free";
+    if (ocr.savedSeconds > 0) std::cout << ", ~" << static_cast<int>(ocr.savedSeconds + 0.5) << " s of OCR saved";
+    std::cout << " (triage " << static_cast<int>(ocr.triageSeconds + 0.5) << " s)" << std::endl;
+}
+
+// note under the results when a --budget-ms search ran out of time
+static void printCompleteness(double share) {
+    if (share >= 1.0) return;
+    std::cout << "(search budget ran out: " << static_cast<int>(share * 100.0)
+              << "% of matching files scored, newest first)\n";
+}
+
+// "Governor: ..." line when the limits held indexing back at some point
+static void printGovernorSummary(const IndexGovernor& governor) {
+    const GovernorStats g = governor.stats();
+    if (g.adjustments == 0 && g.pausedSeconds < 1.0 && g.throttledSeconds < 1.0) return;
+    std::cout << "Governor: " << g.allowed << " of " << g.workers << " extraction workers at the end, "
+              << g.adjustments << " adjustments, paused " << static_cast<int>(g.pausedSeconds + 0.5)
+              << " s for system load, throttled " << static_cast<int>(g.throttledSeconds + 0.5) << " s" << std::endl;
+}
+
+int forwardToDaemon(const std::string& mode, const std::string& input, const CliOptions& options);
+int runMode(const std::string& mode, const std::string& input, const CliOptions& options, const char* argv0);
 
 // Usage helper
 static void printUsage(const char* argv0) {
     std::cout << "Usage:\n"
-              << "  " << argv0 << " --index  <directory_path>\n"
-              << "  " << argv0 << " --search \"<query>\"\n";
+              << "  " << argv0 << " --index  <directory_path> [--resume]\n"
+              << "  " << argv0 << " --search \"<query>\" [--ext pdf,txt] [--under <dir>] [--since <YYYY-MM-DD|epoch>] [--coarse]\n"
+              << "                     [--budget-ms <n>]   (best found within n ms, newest files scored first)\n"
+              << "                     [--collapse]        (one result per group of near-duplicate files)\n"
+              << "  " << argv0 << " --similar <file> [--k <n>] [search options]   (more like this, from the stored vector)\n"
+              << "  " << argv0 << " --similar-all [--k <n>] [--min-score 0.95]    (neighbours of every file: duplicates, clusters)\n"
+              << "  " << argv0 << " --serve  [--socket <path>] [--workers <n>] [--batch-max <n>] [--batch-window-us <us>]\n"
+              << "  " << argv0 << " --status\n"
+              << "  " << argv0 << " --quarantined | --release <path>   (files indexing skips after crashes/stalls)\n"
+              << "  " << argv0 << " --attach <root> [--shard <name>] | --detach <name> | --rebuild <name> | --list-shards\n"
+              << "Common options: --socket <path> (default cortex.sock), --local (skip the daemon),\n"
+              << "                --stats <file.json> (per-stage timings), --trace <file.json> (chrome trace),\n"
+              << "                --model-variant fp32|int8|fp16|static (quantized exports from tools/quantize.py,\n"
+              << "                                 static token table from tools/export_static.py)\n"
+              << "                --shards <dir> (sharded index: one db per attached root, queries fan out)\n"
+              << "                --pca-dims <n> (64 default, 0 = off: size of the reduced vectors --coarse ranks on)\n"
+              << "                --extract-budget <64k|10p|512t> (text read per file: bytes, pdf pages or tokens;\n"
+              << "                                 repeat to set both a size and a page limit)\n"
+              << "                --ocr-jobs <n> (images OCR'd at once), --no-ocr-triage (OCR every image,\n"
+              << "                               even ones the pre-OCR check finds no text in)\n"
+              << "Indexing limits: --index-threads <n> (extraction workers, half the cores by default),\n"
+              << "                --cpu-share <0.5|50%> (of all cores), --io-mbps <n> (file bytes read per second),\n"
+              << "                --max-rss-mb <n>, --pause-load <x> (pause while other processes' load per core\n"
+              << "                is above x, 1.0 default, 0 = never), --no-low-priority (keep normal nice/ioprio)\n";
 }
 
 int main(int argc, char* argv[]) {
-    if (argc < 3) {
+    if (argc < 2) {
         printUsage(argv[0]);
         return 1;
     }
 
+    // CLI
+    const std::string mode = argv[1];
+    const bool takesInput  = (mode == "--index" || mode == "--search" || mode == "--similar" || mode == "--release" ||
+                              (isShardMode(mode) && mode != "--list-shards"));
+    if (takesInput && argc < 3) {
+        printUsage(argv[0]);
+        return 1;
+    }
+    const std::string input = takesInput ? argv[2] : "";
+
+    CliOptions options;
+    if (!parseFlags(argc, argv, takesInput ? 3 : 2, options)) {
+        printUsage(argv[0]);
+        return 1;
+    }
+    // the daemon indexes under the same limits
+    options.server.indexLimits = options.governor;
+    if (!options.tracePath.empty()) Metrics::instance().enableTrace(true);
+
+    int rc = runMode(mode, input, options, argv[0]);
+
+    if (!options.statsPath.empty() && !Metrics::instance().writeJson(options.statsPath))
+        std::cerr << "Could not write stats to " << options.statsPath << "\n";
+    if (!options.tracePath.empty() && !Metrics::instance().writeTrace(options.tracePath))
+        std::cerr << "Could not write trace to " << options.tracePath << "\n";
+    return rc;
+}
+
+int runMode(const std::string& mode, const std::string& input, const CliOptions& options, const char* argv0) {
+    const bool takesInput = (mode == "--index" || mode == "--search" || mode == "--similar" || mode == "--similar-all");
+
+    // Thin client: a running daemon already has the model, db and vectors warm.
+    if (mode != "--serve" && !options.local) {
+        int rc = forwardToDaemon(mode, input, options);
+        if (rc >= 0) return rc;
+    }
+    if (mode == "--status") {
+        std::cout << "No daemon running on " << options.server.socketPath << "\n";
+        return 1;
+    }
+    if (isShardMode(mode) && options.shardDir.empty()) {
+        std::cout << mode << " needs --shards <dir> (or a daemon started with it)\n";
+        return 1;
+    }
+    if (!takesInput && mode != "--serve" && !isShardMode(mode) && !isQuarantineMode(mode)) {
+        std::cout << "Unknown mode: " << mode << "\n";
+        printUsage(argv0);
+        return 1;
+    }
+
     // --- NEW: paths for the embedding stack ---
     // These are relative to the working dir when you run the binary.
     // Use absolute paths if you prefer.
@@ -41,7 +195,34 @@ int main(int argc, char* argv[]) {
     const size_t      maxSeqLen       = 256;
 
     // Classes
-    ContextExtractor extractor;
+    ContextExtractor extractor(options.budget);
+    extractor.ocrTriage = options.ocrTriage;
+    if (options.ocrJobs > 0) extractor.setOcrConcurrency(options.ocrJobs);
+    extractor.commandPrefix = IndexGovernor::commandPrefix(options.governor);
+
+    if (!options.shardDir.empty()) {
+        // like the single database: default to the variant the shards were embedded with,
+        // and refuse an explicit one that doesn't match (a shard would be skipped otherwise)
+        std::string stored;
+        if (!ShardSet::storedModelVariant(options.shardDir, stored)) return 1;
+        if (!options.modelVariant.empty() && !stored.empty() && options.modelVariant != stored) {
+            std::cerr << "These shards were embedded with the " << stored << " model; refusing to use them with "
+                      << options.modelVariant << ". Rebuild them or run with --model-variant " << stored << ".\n";
+            return 1;
+        }
+        const std::string variant = !options.modelVariant.empty() ? options.modelVariant
+                                  : stored.empty() ? "fp32" : stored;
+        EmbeddingEngine embedding(onnxModelPath, pythonExe, tokenizerScript, tokenizerJson, maxSeqLen, variant);
+        return runShardMode(mode, input, options, extractor, embedding);
+    }
+
+    DatabaseManager manager("cortex.db");
+    if (isQuarantineMode(mode)) return quarantineMode(mode, input, manager);
+
+    // vectors from different exports don't mix: default to the variant the index
+    // was built with, and refuse an explicit one that doesn't match
+    const std::string variant = options.modelVariant.empty()
+        ? manager.getMetadata("model_variant", "fp32") : options.modelVariant;
 
     // --- CHANGED: EmbeddingEngine now needs model + python + tokenizer paths ---
     EmbeddingEngine embedding(
@@ -49,66 +230,327 @@ int main(int argc, char* argv[]) {
         pythonExe,
         tokenizerScript,
         tokenizerJson,
-        maxSeqLen
+        maxSeqLen,
+        variant
     );
+    if (!manager.useModelVariant(variant, embedding.modelName(), embedding.modelDimension())) return 1;
+
+    if (mode == "--index") {
+        indexFiles(input, manager, extractor, embedding, options.resume, options.governor);
+        refreshProjection(manager, options.server.pcaDims);
+    } else if (mode == "--search") {
+        searchFiles(input, manager, embedding, options.search, options.budgetMs);
+    } else if (mode == "--similar") {
+        return similarFiles(input, manager, embedding, options.search, options.budgetMs);
+    } else if (mode == "--similar-all") {
+        return similarReport(manager, options);
+    } else if (mode == "--serve") {
+        SearchServer server(manager, extractor, embedding, options.server);
+        return server.run();
+    }
 
-    DatabaseManager manager("cortex.db"); 
+    return 0;
+}
 
-    // CLI
-    const std::string mode  = argv[1];
-    const std::string input = argv[2];
+int runShardMode(const std::string& mode, const std::string& input, const CliOptions& options,
+                 ContextExtractor& extractor, EmbeddingEngine& embedder) {
+    ShardSet shards(options.shardDir, embedder.variant(), embedder.modelName(), embedder.modelDimension());
 
+    if (mode == "--serve") {
+        SearchServer server(shards, extractor, embedder, options.server);
+        return server.run();
+    }
     if (mode == "--index") {
-        indexFiles(input, manager, extractor, embedding);
-    } else if (mode == "--search") {
-        searchFiles(input, manager, embedding);
-    } else {
-        std::cout << "Unknown mode: " << mode << "\n";
-        printUsage(argv[0]);
+        IndexGovernor governor(options.governor);
+        int indexed = shards.indexDirectory(input, extractor, embedder, nullptr, &governor);
+        std::cout << "Indexing Completed. Indexed " << indexed << " new files." << std::endl;
+        printOcrSummary(extractor);
+        printGovernorSummary(governor);
+        return 0;
+    }
+    if (mode == "--search") {
+        SearchOptions search = options.search;
+        double completeness = 1.0;
+        search.completeness = &completeness;
+        if (options.budgetMs > 0)
+            search.deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(options.budgetMs);
+        printResults(shards.search(embedder.createEmbedding(input), search));
+        printCompleteness(completeness);
+        return 0;
+    }
+    if (mode == "--similar") {
+        const std::string path = std::filesystem::absolute(input).lexically_normal().string();
+        std::vector<float> stored = shards.vectorOf(path);
+        if (stored.empty()) {
+            std::cout << "Not indexed: " << path << "\n";
+            return 1;
+        }
+        SearchOptions withSelf = options.search;
+        withSelf.topK = options.search.topK + 1;
+        std::vector<SearchResult> results;
+        for (auto& r : shards.search(stored, withSelf))
+            if (r.path != path && results.size() < static_cast<size_t>(options.search.topK)) results.push_back(std::move(r));
+        printResults(results);
+        return 0;
+    }
+    if (mode == "--similar-all") {
+        std::cout << "--similar-all works on a single index; run it without --shards\n";
         return 1;
     }
+    if (mode == "--attach") {
+        const std::string name = attachName(input, options);
+        if (!shards.attach(name, input)) return 1;
+        std::cout << "Attached shard " << name << "; run --index on it to fill it\n";
+        return 0;
+    }
+    if (mode == "--detach") {
+        if (!shards.detach(input)) {
+            std::cout << "No shard named " << input << "\n";
+            return 1;
+        }
+        return 0;
+    }
+    if (mode == "--rebuild") {
+        IndexGovernor governor(options.governor);
+        int indexed = shards.rebuild(input, extractor, embedder, nullptr, &governor);
+        if (indexed < 0) {
+            std::cout << "Could not rebuild shard " << input << " (unknown shard, or see the error above)\n";
+            return 1;
+        }
+        std::cout << "Rebuilt shard " << input << " with " << indexed << " files.\n";
+        printOcrSummary(extractor);
+        return 0;
+    }
 
+    for (const auto& s : shards.list())
+        std::cout << s.name << "  " << s.root << "  (" << s.files << " files)\n";
     return 0;
 }
 
-void indexFiles(const std::string& path, DatabaseManager& dbManager, ContextExtractor& extractor, EmbeddingEngine& embedder) {
-    FileScanner scanner;
-    std::vector<FileInfo> files = scanner.scanDirectory(path);
+// Returns the exit code when the daemon handled the command, -1 when it should run locally.
+int forwardToDaemon(const std::string& mode, const std::string& input, const CliOptions& options) {
+    SearchClient client(options.server.socketPath);
+    if (!client.available()) return -1;
+
+    nlohmann::json request;
+    if (mode == "--search" || mode == "--similar") {
+        // both read the same options on the daemon side (optionsFromJson)
+        request = filterToJson(options.search.filter);
+        request["k"] = options.search.topK;
+        if (options.search.coarse) request["coarse"] = true;
+        if (options.budgetMs > 0) request["budget_ms"] = options.budgetMs;
+        if (options.search.collapseDuplicates) request["collapse"] = true;
+        if (mode == "--search") {
+            request["op"]    = "search";
+            request["query"] = input;
+        } else {
+            request["op"]   = "similar";
+            request["path"] = std::filesystem::absolute(input).lexically_normal().string();
+        }
+    } else if (mode == "--index") {
+        // the daemon's extractor and model serve every request; settings for them can only
+        // apply to an index run of our own
+        const ExtractionBudget defaultBudget;
+        if (options.budget.maxBytes != defaultBudget.maxBytes || options.budget.maxPages != defaultBudget.maxPages ||
+            options.ocrJobs > 0 || !options.ocrTriage || !options.modelVariant.empty()) {
+            std::cout << "Indexing in this process: a running daemon keeps its own --extract-budget, --ocr-jobs,"
+                         " --no-ocr-triage and --model-variant (it sees the new files after a restart)\n";
+            return -1;
+        }
+        // the daemon's working dir may differ from ours; governor limits apply per run
+        request = {{"op", "index"},
+                   {"path", std::filesystem::absolute(input).lexically_normal().string()},
+                   {"resume", options.resume}};
+        const nlohmann::json limits = limitsToJson(options.governor);
+        if (!limits.empty()) request["limits"] = limits;
+    } else if (mode == "--status") {
+        request = {{"op", "stats"}};
+    } else if (mode == "--attach") {
+        request = {{"op", "attach"}, {"name", attachName(input, options)},
+                   {"root", std::filesystem::absolute(input).lexically_normal().string()}};
+    } else if (mode == "--detach" || mode == "--rebuild") {
+        request = {{"op", mode.substr(2)}, {"name", input}};
+    } else if (mode == "--list-shards") {
+        request = {{"op", "shards"}};
+    } else {
+        return -1;
+    }
 
-    int indexCount = 0;
-    for (const auto& file : files) {
-        if (!isCorrectFileType(file.extension)) continue;
+    auto reply = client.request(request);
+    if (!reply) return -1;
+    if (!reply->value("ok", false)) {
+        std::cout << "Daemon error: " << reply->value("error", std::string("unknown")) << "\n";
+        return 1;
+    }
 
-        std::string filePath = file.path;
-        std::time_t lastModified = getLastModified(filePath);
+    if (mode == "--search" || mode == "--similar") {
+        std::vector<SearchResult> results;
+        for (const auto& r : (*reply)["results"])
+            results.push_back({r.value("path", ""), r.value("name", ""),
+                               r.value("extension", ""), r.value("score", 0.0f), r.value("duplicates", 0)});
+        printResults(results);
+        printCompleteness(reply->value("completeness", 1.0));
+    } else if (mode == "--index") {
+        std::cout << "Indexing Completed. Indexed " << reply->value("indexed", 0) << " new files." << std::endl;
+    } else {
+        std::cout << reply->dump(2) << "\n";
+    }
+    return 0;
+}
 
-        std::string context = extractor.extractText(file.path);
-        if (context.empty()) {
-            std::cout << "No text extracted from: " << file.name << std::endl;
-            continue;
+void indexFiles(const std::string& path, DatabaseManager& dbManager, ContextExtractor& extractor, EmbeddingEngine& embedder,
+                bool resume, const GovernorLimits& limits) {
+    IndexGovernor governor(limits);
+    Indexer indexer(dbManager, extractor, embedder);
+    indexer.resume = resume;
+    indexer.governor = &governor;
+    indexer.onFile = [](const FileInfo& file, IndexOutcome outcome) {
+        switch (outcome) {
+            case IndexOutcome::Indexed:
+                std::cout << "Inserted/Updated " << file.path << std::endl;
+                break;
+            case IndexOutcome::NoText:
+                std::cout << "No text extracted from: " << file.name << std::endl;
+                break;
+            case IndexOutcome::EmbeddingFailed:
+                std::cout << "Embedding failed for: " << file.name << std::endl;
+                break;
+            case IndexOutcome::Quarantined:
+                std::cout << "Quarantined, skipped: " << file.path << std::endl;
+                break;
+            case IndexOutcome::Unchanged:
+                break;
         }
+    };
 
-        std::vector<float> embeddingVector = embedder.createEmbedding(context);
-        if (embeddingVector.empty()) {
-            std::cout << "Embedding failed for: " << file.name << std::endl;
-            continue;
-        }
+    int indexCount = indexer.indexDirectory(path);
+    std::cout << "Indexing Completed. Indexed " << indexCount << " new files." << std::endl;
+    printOcrSummary(extractor);
+    printGovernorSummary(governor);
+}
 
-        // NOTE: this call must match your DatabaseManager signature.
-        // If your insertFile has different params, adjust accordingly.
-        if (dbManager.insertFile(file.path, file.name, file.extension, embeddingVector, lastModified)) {
-            std::cout << "Inserted/Updated " << file.path << std::endl;
-            ++indexCount;
+int quarantineMode(const std::string& mode, const std::string& input, DatabaseManager& dbManager) {
+    if (mode == "--release") {
+        const std::string path = std::filesystem::absolute(input).lexically_normal().string();
+        if (!dbManager.releaseQuarantine(path)) {
+            std::cout << "Not quarantined: " << path << "\n";
+            return 1;
         }
+        std::cout << "Released " << path << "; the next --index will try it again\n";
+        return 0;
     }
 
-    std::cout << "Indexing Completed. Indexed " << indexCount << " new files." << std::endl;
+    std::vector<QuarantineEntry> entries = dbManager.listQuarantine();
+    if (entries.empty()) std::cout << "Nothing is quarantined.\n";
+    for (const auto& q : entries)
+        std::cout << q.path << "  (" << q.strikes << " strikes: " << q.reason << ")\n";
+    return 0;
+}
+
+// Retrains the stored PCA projection when the corpus has drifted from it; --search --coarse
+// and the daemon pick it up from the metadata table.
+void refreshProjection(DatabaseManager& dbManager, size_t dims) {
+    if (dims == 0) return;
+    VectorIndex index;
+    index.load(dbManager);
+    if (index.size() < 4 * dims) return;   // small enough that the full scan is the fast path
+
+    std::shared_ptr<PcaProjection> stored = PcaProjection::load(dbManager);
+    if (stored && stored->outputDim() == dims && !stored->stale(index)) return;
+
+    std::shared_ptr<PcaProjection> pca = PcaProjection::train(index, dims);
+    if (pca && pca->save(dbManager))
+        std::cout << "PCA projection retrained: " << pca->inputDim() << " -> " << dims << " dims, "
+                  << static_cast<int>(pca->trainedVariance() * 100.0f) << "% variance kept\n";
+}
+
+// --coarse needs the vectors in memory next to their projection, --budget-ms needs them
+// for the newest-first order and --collapse for the groups; anything else scans sqlite
+static bool needsWarmIndex(const SearchOptions& options, int budgetMs) {
+    return options.coarse || budgetMs > 0 || options.collapseDuplicates;
+}
+
+static void loadWarmIndex(VectorIndex& index, DatabaseManager& dbManager, bool coarse) {
+    index.load(dbManager);
+    if (!coarse) return;
+    std::shared_ptr<PcaProjection> pca = PcaProjection::load(dbManager);
+    if (pca) index.setProjection(pca);
+    else std::cout << "No PCA projection stored yet (run --index); scoring the full vectors.\n";
+}
+
+// the budget starts once the index is loaded, as it would be in the daemon or the GUI
+static SearchOptions withBudget(const SearchOptions& options, int budgetMs, double* completeness) {
+    SearchOptions search = options;
+    search.completeness = completeness;
+    if (budgetMs > 0) search.deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(budgetMs);
+    return search;
+}
+
+void searchFiles(const std::string& query, DatabaseManager& dbManager, EmbeddingEngine& embedder, const SearchOptions& options,
+                 int budgetMs) {
+    if (!needsWarmIndex(options, budgetMs)) {
+        SearchEngine searcher(dbManager, embedder);
+        printResults(searcher.search(query, options));
+        return;
+    }
+
+    VectorIndex index;
+    loadWarmIndex(index, dbManager, options.coarse);
+    SearchEngine searcher(dbManager, embedder, index);
+    double completeness = 1.0;
+    printResults(searcher.search(query, withBudget(options, budgetMs, &completeness)));
+    printCompleteness(completeness);
+}
+
+int similarFiles(const std::string& path, DatabaseManager& dbManager, EmbeddingEngine& embedder, const SearchOptions& options,
+                 int budgetMs) {
+    const std::string file = std::filesystem::absolute(path).lexically_normal().string();
+    if (dbManager.getEmbedding(file).empty()) {
+        std::cout << "Not indexed: " << file << " (run --index on its folder first)\n";
+        return 1;
+    }
+    if (!needsWarmIndex(options, budgetMs)) {
+        SearchEngine searcher(dbManager, embedder);
+        printResults(searcher.searchByFile(file, options));
+        return 0;
+    }
+
+    // same index and options as --search, so the result matches the daemon's "similar"
+    VectorIndex index;
+    loadWarmIndex(index, dbManager, options.coarse);
+    SearchEngine searcher(dbManager, embedder, index);
+    double completeness = 1.0;
+    printResults(searcher.searchByFile(file, withBudget(options, budgetMs, &completeness)));
+    printCompleteness(completeness);
+    return 0;
 }
 
-void searchFiles(const std::string& query, DatabaseManager& dbManager, EmbeddingEngine& embedder) {
-    SearchEngine searcher(dbManager, embedder);
+// Every file with its closest neighbours. With --min-score only the pairs at least that
+// close are listed, which makes it a near-duplicate report.
+int similarReport(DatabaseManager& dbManager, const CliOptions& options) {
+    VectorIndex index;
+    index.load(dbManager);
+    std::vector<Neighbours> all = index.allNeighbours(static_cast<size_t>(std::max(1, options.search.topK)));
 
-    std::vector<SearchResult> results = searcher.search(query);
+    size_t listed = 0;
+    std::cout << std::fixed << std::setprecision(4);
+    for (const auto& file : all) {
+        bool first = true;
+        for (const auto& r : file.similar) {
+            if (r.score < options.minScore) break;   // best first
+            if (first) {
+                std::cout << file.path << "\n";
+                first = false;
+                ++listed;
+            }
+            std::cout << "    " << r.score << "  " << r.path << "\n";
+        }
+    }
+    std::cout << std::defaultfloat << listed << " of " << all.size() << " files listed\n";
+    return 0;
+}
+
+void printResults(const std::vector<SearchResult>& results) {
     if (results.empty()) {
         std::cout << "No Matching File Found." << std::endl;
         return;
@@ -116,22 +558,138 @@ void searchFiles(const std::string& query, DatabaseManager& dbManager, Embedding
 
     std::cout << "\nTop matches:\n";
     for (const auto& result : results) {
-        std::cout << "File: " << result.name << " (Score: " << result.score << ")\n";
+        std::cout << "File: " << result.name << " (Score: " << result.score << ")";
+        if (result.duplicates > 0) std::cout << "  +" << result.duplicates << " near-duplicate(s)";
+        std::cout << "\n";
         std::cout << "Path: " << result.path << "\n";
         std::cout << "--------------------------------------\n";
     }
 }
 
-bool isCorrectFileType(const std::string& extension) {
-    return (extension == ".txt" || extension == ".pdf" || extension == ".png" ||
-            extension == ".jpg" || extension == ".jpeg");
+// --since accepts a calendar date (local midnight) or raw unix seconds
+static bool parseSince(const std::string& value, long long& out) {
+    if (!value.empty() && value.find_first_not_of("0123456789") == std::string::npos) {
+        // more digits than fit in 64 bits is a bad value, not an exception
+        const auto [end, ec] = std::from_chars(value.data(), value.data() + value.size(), out);
+        return ec == std::errc() && end == value.data() + value.size();
+    }
+    std::tm tm{};
+    std::istringstream in(value);
+    in >> std::get_time(&tm, "%Y-%m-%d");
+    if (in.fail() || in.peek() != std::char_traits<char>::eof()) return false;
+    tm.tm_isdst = -1;
+    std::time_t t = std::mktime(&tm);
+    if (t == -1) return false;
+    out = static_cast<long long>(t);
+    return true;
 }
 
-std::time_t getLastModified(std::string& filePath) {
-    auto ftime = std::filesystem::last_write_time(filePath);
-    auto sctp = std::chrono::time_point_cast<std::chrono::system_clock::duration>(
-        ftime - std::filesystem::file_time_type::clock::now()
-        + std::chrono::system_clock::now()
-    );
-    return std::chrono::system_clock::to_time_t(sctp);
+// Parses the optional flags that follow the mode (and its input).
+bool parseFlags(int argc, char* argv[], int first, CliOptions& options) {
+    for (int i = first; i < argc; ++i) {
+        const std::string flag = argv[i];
+        if (flag == "--local") {
+            options.local = true;
+            continue;
+        }
+        if (flag == "--coarse") {
+            options.search.coarse = true;
+            continue;
+        }
+        if (flag == "--collapse") {
+            options.search.collapseDuplicates = true;
+            continue;
+        }
+        if (flag == "--resume") {
+            options.resume = true;
+            continue;
+        }
+        if (flag == "--no-ocr-triage") {
+            options.ocrTriage = false;
+            continue;
+        }
+        if (flag == "--no-low-priority") {
+            options.governor.lowPriority = false;
+            continue;
+        }
+        if (i + 1 >= argc) {
+            std::cout << "Missing value for " << flag << "\n";
+            return false;
+        }
+        const std::string value = argv[++i];
+
+        if (flag == "--ext") {
+            // comma separated, with or without the leading dot
+            std::stringstream list(value);
+            std::string ext;
+            while (std::getline(list, ext, ',')) {
+                if (ext.empty()) continue;
+                if (ext[0] != '.') ext = "." + ext;
+                options.search.filter.extensions.push_back(ext);
+            }
+        } else if (flag == "--under") {
+            // match the absolute, normalized form FileScanner stores
+            options.search.filter.underPath =
+                std::filesystem::absolute(value).lexically_normal().string();
+        } else if (flag == "--since") {
+            if (!parseSince(value, options.search.filter.modifiedSince)) {
+                std::cout << "Bad --since value: " << value << " (YYYY-MM-DD or unix seconds)\n";
+                return false;
+            }
+        } else if (flag == "--socket") {
+            options.server.socketPath = value;
+        } else if (flag == "--stats") {
+            options.statsPath = value;
+        } else if (flag == "--trace") {
+            options.tracePath = value;
+        } else if (flag == "--model-variant") {
+            if (!EmbeddingEngine::isKnownVariant(value)) {
+                std::cout << "Unknown model variant: " << value << " (fp32, int8, fp16, static)\n";
+                return false;
+            }
+            options.modelVariant = value;
+        } else if (flag == "--shards") {
+            options.shardDir = value;
+        } else if (flag == "--shard") {
+            options.shardName = value;
+        } else if (flag == "--extract-budget") {
+            if (!options.budget.parse(value)) {
+                std::cout << "Bad --extract-budget value: " << value << " (e.g. 64k, 10p, 512t)\n";
+                return false;
+            }
+        } else if (flag == "--budget-ms") {
+            options.budgetMs = std::max(0, std::atoi(value.c_str()));
+        } else if (flag == "--k") {
+            options.search.topK = std::max(1, std::atoi(value.c_str()));
+        } else if (flag == "--min-score") {
+            options.minScore = std::strtof(value.c_str(), nullptr);
+        } else if (flag == "--ocr-jobs") {
+            options.ocrJobs = std::max(1, std::atoi(value.c_str()));
+        } else if (flag == "--pca-dims") {
+            options.server.pcaDims = static_cast<size_t>(std::max(0, std::atoi(value.c_str())));
+        } else if (flag == "--workers") {
+            options.server.workers = std::max(1, std::atoi(value.c_str()));
+        } else if (flag == "--index-threads") {
+            options.governor.maxWorkers = std::max(1, std::atoi(value.c_str()));
+        } else if (flag == "--cpu-share") {
+            // 0.5 or 50%
+            double share = std::strtod(value.c_str(), nullptr);
+            if (!value.empty() && value.back() == '%') share /= 100.0;
+            options.governor.cpuShare = std::clamp(share, 0.0, 1.0);
+        } else if (flag == "--io-mbps") {
+            options.governor.ioMBps = std::max(0.0, std::strtod(value.c_str(), nullptr));
+        } else if (flag == "--max-rss-mb") {
+            options.governor.maxRssMb = static_cast<size_t>(std::max(0, std::atoi(value.c_str())));
+        } else if (flag == "--pause-load") {
+            options.governor.pauseLoad = std::max(0.0, std::strtod(value.c_str(), nullptr));
+        } else if (flag == "--batch-max") {
+            options.server.batchMax = static_cast<size_t>(std::max(1, std::atoi(value.c_str())));
+        } else if (flag == "--batch-window-us") {
+            options.server.batchWindowUs = std::max(0, std::atoi(value.c_str()));
+        } else {
+            std::cout << "Unknown option: " << flag << "\n";
+            return false;
+        }
+    }
+    return true;
 }
@@ -0,0 +1,114 @@
+// src/shard_smoke.cpp
+// Sharded index behaviour that needs no model files (FakeEmbedder): attaching and
+// detaching shards moves stored rows to the shard they route to now, so no file is
+// stored twice and moved files are not embedded again
+#include "ShardSet.hpp"
+#include "FakeEmbedder.hpp"
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <map>
+
+namespace fs = std::filesystem;
+
+static int failures = 0;
+
+#define CHECK(cond)                                                              \
+  do {                                                                           \
+    if (!(cond)) {                                                               \
+      std::cerr << __FILE__ << ":" << __LINE__ << ": check failed: " #cond "\n"; \
+      ++failures;                                                                \
+    }                                                                            \
+  } while (0)
+
+struct CountingEmbedder : FakeEmbedder {
+  int calls = 0;
+  std::vector<float> createEmbedding(const std::string& text) override {
+    ++calls;
+    return FakeEmbedder::createEmbedding(text);
+  }
+};
+
+static const int kFiles = 30;      // 10 of them under sub/
+static const int kSubFiles = 10;
+
+static size_t filesIn(const ShardSet& shards, const std::string& name) {
+  for (const auto& s : shards.list())
+    if (s.name == name) return s.files;
+  return 0;
+}
+
+// every stored path once, over all shards
+static bool noDuplicates(const ShardSet& shards) {
+  SearchOptions options;
+  options.topK = kFiles * 2;
+  std::map<std::string, int> seen;
+  for (const auto& r : shards.search(FakeEmbedder().createEmbedding("alpha"), options))
+    if (seen[r.path]++) return false;
+  return true;
+}
+
+int main() {
+  const fs::path dir = fs::temp_directory_path() / "cortex_shard_test";
+  fs::remove_all(dir);
+  const fs::path corpus = dir / "corpus";
+  fs::create_directories(corpus / "sub");
+  for (int i = 0; i < kFiles; ++i) {
+    const fs::path path = (i < kSubFiles ? corpus / "sub" : corpus) / ("f" + std::to_string(i) + ".txt");
+    std::ofstream(path) << "alpha file " << i << " word" << i * 7 << " other" << i % 5;
+  }
+  const std::string root = corpus.string();
+  const std::string shardDir = (dir / "shards").string();
+
+  ContextExtractor extractor;
+  CountingEmbedder embedder;
+  {
+    ShardSet shards(shardDir);
+    CHECK(shards.attach("a", root));
+    CHECK(shards.indexDirectory(root, extractor, embedder) == kFiles);
+    CHECK(embedder.calls == kFiles);
+
+    // a same-root sibling takes over part of the hash split
+    CHECK(shards.attach("b", root));
+    CHECK(shards.size() == static_cast<size_t>(kFiles));
+    CHECK(filesIn(shards, "a") > 0 && filesIn(shards, "b") > 0);
+    CHECK(noDuplicates(shards));
+    CHECK(shards.indexDirectory(root, extractor, embedder) == 0);
+    CHECK(embedder.calls == kFiles);
+
+    // a deeper root takes over sub/
+    CHECK(shards.attach("deep", (corpus / "sub").string()));
+    CHECK(filesIn(shards, "deep") == static_cast<size_t>(kSubFiles));
+    CHECK(shards.size() == static_cast<size_t>(kFiles));
+    CHECK(noDuplicates(shards));
+    CHECK(shards.indexDirectory(root, extractor, embedder) == 0);
+
+    // after detaching b, a covers the whole split again; b's rows stay in b.db, so
+    // its files are embedded again by the next run (and only those)
+    const int bFiles = static_cast<int>(filesIn(shards, "b"));
+    CHECK(shards.detach("b"));
+    CHECK(noDuplicates(shards));
+    CHECK(shards.indexDirectory(root, extractor, embedder) == bFiles);
+    CHECK(shards.size() == static_cast<size_t>(kFiles));
+    CHECK(embedder.calls == kFiles + bFiles);
+
+    // b.db still holds its old rows; attaching it again must not store them twice
+    CHECK(shards.attach("b", root));
+    CHECK(noDuplicates(shards));
+    CHECK(shards.size() == static_cast<size_t>(kFiles));
+    CHECK(shards.indexDirectory(root, extractor, embedder) == 0);
+  }
+  {
+    ShardSet reopened(shardDir);
+    CHECK(reopened.size() == static_cast<size_t>(kFiles));
+    CHECK(noDuplicates(reopened));
+  }
+
+  fs::remove_all(dir);
+  if (failures) {
+    std::cerr << failures << " check(s) failed\n";
+    return 1;
+  }
+  std::cout << "shard_test: ok\n";
+  return 0;
+}
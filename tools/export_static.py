@@ -0,0 +1,75 @@
+#!/usr/bin/env python3
+"""Writes the static token table EmbeddingEngine loads with --model-variant static.
+
+  model2vec model (local dir or hub id) -> models/model.static.bin
+
+The source needs model.safetensors ("embeddings", optional per-token "weights") and a
+WordPiece tokenizer.json, which is what model2vec distills from BERT-style models.
+Layout (little endian), read by src/StaticEmbedding.cpp:
+
+  "CXSTATIC" | u32 version=1 | u32 vocab | u32 dim | u32 unk id | u32 flags (1 = f16 rows)
+  | vocab x (u16 length, token bytes) | vocab x f32 weight | vocab x dim rows
+
+Check the result with ./cortex_drift --variants static before indexing with it.
+"""
+import argparse
+import json
+import struct
+from pathlib import Path
+
+
+def variant_path(model: Path) -> Path:
+    # same naming as EmbeddingEngine::variantModelPath
+    return model.with_name(f"{model.stem}.static.bin")
+
+
+def source_dir(source: str) -> Path:
+    if Path(source).is_dir():
+        return Path(source)
+    from huggingface_hub import snapshot_download
+    return Path(snapshot_download(source))
+
+
+def read_vocab(tokenizer_json: Path):
+    spec = json.loads(tokenizer_json.read_text())
+    model = spec["model"]
+    if model.get("type") != "WordPiece":
+        raise SystemExit(f"{tokenizer_json}: {model.get('type')} tokenizer, only WordPiece is supported")
+    vocab = sorted(model["vocab"].items(), key=lambda kv: kv[1])
+    tokens = [token for token, _ in vocab]
+    unk = model.get("unk_token", "[UNK]")
+    return tokens, tokens.index(unk) if unk in tokens else 0xFFFFFFFF
+
+
+def main():
+    ap = argparse.ArgumentParser()
+    ap.add_argument("--source", default="minishlab/potion-base-8M")
+    ap.add_argument("--model", default="models/model.onnx")
+    ap.add_argument("--fp16", action="store_true", help="store rows as f16 (half the file)")
+    args = ap.parse_args()
+
+    import numpy as np
+    from safetensors.numpy import load_file
+
+    src = source_dir(args.source)
+    tensors = load_file(str(src / "model.safetensors"))
+    rows = tensors["embeddings"].astype(np.float32)
+    tokens, unk = read_vocab(src / "tokenizer.json")
+    if rows.shape[0] != len(tokens):
+        raise SystemExit(f"{len(tokens)} tokens but {rows.shape[0]} embedding rows")
+    weights = tensors.get("weights", np.ones(len(tokens))).astype(np.float32)
+
+    out = variant_path(Path(args.model))
+    with open(out, "wb") as f:
+        f.write(b"CXSTATIC")
+        f.write(struct.pack("<5I", 1, len(tokens), rows.shape[1], unk, 1 if args.fp16 else 0))
+        for token in tokens:
+            data = token.encode("utf-8")
+            f.write(struct.pack("<H", len(data)) + data)
+        f.write(weights.astype("<f4").tobytes())
+        f.write(rows.astype("<f2" if args.fp16 else "<f4").tobytes())
+    print(f"static: {out} ({len(tokens)} tokens x {rows.shape[1]} dims, {out.stat().st_size / 1e6:.1f} MB)")
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,49 @@
+#!/usr/bin/env python3
+"""Writes the reduced-precision exports EmbeddingEngine can load with --model-variant.
+
+  models/model.onnx -> models/model.int8.onnx  (dynamic int8 weight quantization)
+                    -> models/model.fp16.onnx  (fp16 weights, float32 inputs/outputs)
+
+Check the result with ./cortex_drift before indexing with it.
+"""
+import argparse
+from pathlib import Path
+
+
+def variant_path(model: Path, variant: str) -> Path:
+    # same naming as EmbeddingEngine::variantModelPath
+    return model.with_name(f"{model.stem}.{variant}{model.suffix}")
+
+
+def export_int8(model: Path, out: Path):
+    from onnxruntime.quantization import QuantType, quantize_dynamic
+    quantize_dynamic(str(model), str(out), weight_type=QuantType.QInt8, per_channel=True)
+
+
+def export_fp16(model: Path, out: Path):
+    import onnx
+    from onnxconverter_common import float16
+    m = onnx.load(str(model))
+    # keep_io_types: the engine binds float32 buffers for every variant
+    m16 = float16.convert_float_to_float16(m, keep_io_types=True)
+    onnx.save(m16, str(out))
+
+
+def main():
+    ap = argparse.ArgumentParser()
+    ap.add_argument("--model", default="models/model.onnx")
+    ap.add_argument("--variants", default="int8,fp16")
+    args = ap.parse_args()
+
+    model = Path(args.model)
+    exporters = {"int8": export_int8, "fp16": export_fp16}
+    for variant in filter(None, args.variants.split(",")):
+        if variant not in exporters:
+            raise SystemExit(f"unknown variant {variant} (int8, fp16)")
+        out = variant_path(model, variant)
+        exporters[variant](model, out)
+        print(f"{variant}: {out} ({out.stat().st_size / 1e6:.1f} MB)")
+
+
+if __name__ == "__main__":
+    main()
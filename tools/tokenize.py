@@ -5,7 +5,7 @@ from tokenizers import Tokenizer
 def main():
     ap = argparse.ArgumentParser()
     ap.add_argument("--tokenizer-json", required=True)
-    ap.add_argument("--text")
+    ap.add_argument("--text", action="append")   # repeat for a batch, one JSON line each
     ap.add_argument("--max-len", type=int, default=256)
     args = ap.parse_args()
 
@@ -37,7 +37,8 @@ def main():
         print(json.dumps({"input_ids": ids, "attention_mask": mask}))
 
     if args.text is not None:
-        encode_one(args.text)
+        for text in args.text:
+            encode_one(text)
     else:
         for line in sys.stdin:
             encode_one(line.rstrip("\n"))